@@ -0,0 +1,294 @@
+#include <stdlib.h>
+#include <string.h>
+#include "bus_line_set.h"
+
+#define INITIAL_BLOCKS_CAPACITY 4
+#define GROWTH_FACTOR 2
+
+/**
+ * Compares two BusLine elements by the given key, then by line number.
+ * @return negative if first is smaller, positive if bigger, 0 if equal.
+ */
+static int compare_lines (SortKey key, const BusLine *first,
+                          const BusLine *second)
+{
+  int first_val = (key == BY_DISTANCE) ? first->distance : first->duration;
+  int second_val = (key == BY_DISTANCE) ? second->distance : second->duration;
+  if (first_val != second_val)
+  {
+    return (first_val < second_val) ? -1 : 1;
+  }
+  if (first->line_number != second->line_number)
+  {
+    return (first->line_number < second->line_number) ? -1 : 1;
+  }
+  return 0;
+}
+
+/**
+ * Finds the block a BusLine belongs to: the last block whose first element
+ * isn't bigger than the given line (or the first block).
+ */
+static int find_block (const BusLineSet *set, const BusLine *line)
+{
+  int low = 0;
+  int high = set->num_of_blocks - 1;
+  while (low < high)
+  {
+    int mid = low + (high - low + 1) / 2;
+    if (compare_lines (set->key, &set->blocks[mid]->lines[0], line) <= 0)
+    {
+      low = mid;
+    }
+    else
+    {
+      high = mid - 1;
+    }
+  }
+  return low;
+}
+
+/**
+ * Finds the first position in the block which isn't smaller than line.
+ */
+static int lower_bound (SortKey key, const BusLineBlock *block,
+                        const BusLine *line)
+{
+  int low = 0;
+  int high = block->size;
+  while (low < high)
+  {
+    int mid = low + (high - low) / 2;
+    if (compare_lines (key, &block->lines[mid], line) < 0)
+    {
+      low = mid + 1;
+    }
+    else
+    {
+      high = mid;
+    }
+  }
+  return low;
+}
+
+/**
+ * Makes room for one more block in the directory.
+ * @return EXIT_SUCCESS upon success, EXIT_FAILURE on allocation error.
+ */
+static int reserve_block (BusLineSet *set)
+{
+  if (set->num_of_blocks < set->blocks_capacity)
+  {
+    return EXIT_SUCCESS;
+  }
+  int new_capacity = set->blocks_capacity * GROWTH_FACTOR;
+  BusLineBlock **temp = realloc (set->blocks,
+                                 sizeof (BusLineBlock *) * new_capacity);
+  if (temp == NULL)
+  {
+    return EXIT_FAILURE;
+  }
+  set->blocks = temp;
+  set->blocks_capacity = new_capacity;
+  return EXIT_SUCCESS;
+}
+
+/**
+ * Inserts a new empty block to the directory at the given index.
+ * @return pointer to the new block: upon success, NULL: otherwise
+ */
+static BusLineBlock *insert_block (BusLineSet *set, int ind)
+{
+  if (reserve_block (set) == EXIT_FAILURE)
+  {
+    return NULL;
+  }
+  BusLineBlock *block = malloc (sizeof (BusLineBlock));
+  if (block == NULL)
+  {
+    return NULL;
+  }
+  block->size = 0;
+  memmove (&set->blocks[ind + 1], &set->blocks[ind],
+           sizeof (BusLineBlock *) * (set->num_of_blocks - ind));
+  set->blocks[ind] = block;
+  set->num_of_blocks++;
+  return block;
+}
+
+BusLineSet *bus_line_set_create (SortKey key)
+{
+  BusLineSet *set = malloc (sizeof (BusLineSet));
+  BusLineBlock **blocks = malloc (sizeof (BusLineBlock *)
+                                  * INITIAL_BLOCKS_CAPACITY);
+  if (set == NULL || blocks == NULL)
+  {
+    free (set);
+    free (blocks);
+    return NULL;
+  }
+  *set = (BusLineSet) {key, blocks, 0, INITIAL_BLOCKS_CAPACITY, 0};
+  return set;
+}
+
+void bus_line_set_free (BusLineSet **set)
+{
+  if (*set == NULL)
+  {
+    return;
+  }
+  for (int i = 0; i < (*set)->num_of_blocks; i++)
+  {
+    free ((*set)->blocks[i]);
+  }
+  free ((*set)->blocks);
+  free (*set);
+  *set = NULL;
+}
+
+int bus_line_set_insert (BusLineSet *set, const BusLine *line)
+{
+  if (set->num_of_blocks == 0 && insert_block (set, 0) == NULL)
+  {
+    return EXIT_FAILURE;
+  }
+  int block_ind = find_block (set, line);
+  BusLineBlock *block = set->blocks[block_ind];
+  if (block->size == BUS_LINE_BLOCK_CAPACITY) // full: split it in half
+  {
+    BusLineBlock *upper = insert_block (set, block_ind + 1);
+    if (upper == NULL)
+    {
+      return EXIT_FAILURE;
+    }
+    int half = BUS_LINE_BLOCK_CAPACITY / 2;
+    memcpy (upper->lines, &block->lines[half],
+            sizeof (BusLine) * (BUS_LINE_BLOCK_CAPACITY - half));
+    upper->size = BUS_LINE_BLOCK_CAPACITY - half;
+    block->size = half;
+    if (compare_lines (set->key, &upper->lines[0], line) <= 0)
+    {
+      block = upper;
+    }
+  }
+  int ind = lower_bound (set->key, block, line);
+  memmove (&block->lines[ind + 1], &block->lines[ind],
+           sizeof (BusLine) * (block->size - ind));
+  block->lines[ind] = *line;
+  block->size++;
+  set->size++;
+  return EXIT_SUCCESS;
+}
+
+int bus_line_set_remove (BusLineSet *set, const BusLine *line)
+{
+  if (set->num_of_blocks == 0)
+  {
+    return EXIT_FAILURE;
+  }
+  int block_ind = find_block (set, line);
+  BusLineBlock *block = set->blocks[block_ind];
+  int ind = lower_bound (set->key, block, line);
+  if (ind == block->size
+      || compare_lines (set->key, &block->lines[ind], line) != 0)
+  {
+    return EXIT_FAILURE;
+  }
+  memmove (&block->lines[ind], &block->lines[ind + 1],
+           sizeof (BusLine) * (block->size - ind - 1));
+  block->size--;
+  set->size--;
+  if (block->size == 0) // drop empty blocks from the directory
+  {
+    free (block);
+    memmove (&set->blocks[block_ind], &set->blocks[block_ind + 1],
+             sizeof (BusLineBlock *) * (set->num_of_blocks - block_ind - 1));
+    set->num_of_blocks--;
+  }
+  return EXIT_SUCCESS;
+}
+
+int bus_line_set_merge_sorted (BusLineSet *set, const BusLine *start,
+                               const BusLine *end)
+{
+  long total = set->size + (end - start + 1);
+  int new_capacity = (int) (total / MERGE_FILL) + 1;
+  BusLineBlock **blocks = malloc (sizeof (BusLineBlock *) * new_capacity);
+  if (blocks == NULL)
+  {
+    return EXIT_FAILURE;
+  }
+  int num_of_blocks = 0;
+  BusLineIter iter = bus_line_set_begin (set);
+  const BusLine *cur = bus_line_set_next (&iter);
+  BusLineBlock *block = NULL;
+  while (cur != NULL || start <= end)
+  {
+    if (block == NULL || block->size == MERGE_FILL)
+    {
+      block = malloc (sizeof (BusLineBlock));
+      if (block == NULL)
+      {
+        for (int i = 0; i < num_of_blocks; i++)
+        {
+          free (blocks[i]);
+        }
+        free (blocks);
+        return EXIT_FAILURE;
+      }
+      block->size = 0;
+      blocks[num_of_blocks++] = block;
+    }
+    if (start > end
+        || (cur != NULL && compare_lines (set->key, cur, start) <= 0))
+    {
+      block->lines[block->size++] = *cur;
+      cur = bus_line_set_next (&iter);
+    }
+    else
+    {
+      block->lines[block->size++] = *start;
+      start++;
+    }
+  }
+  for (int i = 0; i < set->num_of_blocks; i++)
+  {
+    free (set->blocks[i]);
+  }
+  free (set->blocks);
+  set->blocks = blocks;
+  set->num_of_blocks = num_of_blocks;
+  set->blocks_capacity = new_capacity;
+  set->size = total;
+  return EXIT_SUCCESS;
+}
+
+void bus_line_set_to_array (const BusLineSet *set, BusLine *out)
+{
+  for (int i = 0; i < set->num_of_blocks; i++)
+  {
+    memcpy (out, set->blocks[i]->lines,
+            sizeof (BusLine) * set->blocks[i]->size);
+    out += set->blocks[i]->size;
+  }
+}
+
+BusLineIter bus_line_set_begin (const BusLineSet *set)
+{
+  return (BusLineIter) {set, 0, 0};
+}
+
+const BusLine *bus_line_set_next (BusLineIter *iter)
+{
+  while (iter->block < iter->set->num_of_blocks
+         && iter->ind == iter->set->blocks[iter->block]->size)
+  {
+    iter->block++;
+    iter->ind = 0;
+  }
+  if (iter->block == iter->set->num_of_blocks)
+  {
+    return NULL;
+  }
+  return &iter->set->blocks[iter->block]->lines[iter->ind++];
+}
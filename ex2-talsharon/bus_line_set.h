@@ -0,0 +1,115 @@
+#ifndef EX2_REPO_BUSLINESET_H
+#define EX2_REPO_BUSLINESET_H
+#include <stddef.h>
+#include "sort_bus_lines.h"
+
+/**
+ * Number of BusLine elements held by a single block of the set.
+ * 64 elements * 12 bytes = 12 cache lines, small enough that shifting
+ * elements inside a block is cheaper than chasing tree pointers.
+ */
+#define BUS_LINE_BLOCK_CAPACITY 64
+
+/**
+ * Number of elements of each block built by a merge (but the last one).
+ * Blocks are left partly empty, so following inserts don't split them
+ * right away.
+ */
+#define MERGE_FILL ((BUS_LINE_BLOCK_CAPACITY * 3) / 4)
+
+/**
+ * The key a BusLineSet keeps its elements ordered by.
+ * Ties are broken by line number so every element has a unique position.
+ */
+typedef enum SortKey
+{
+    BY_DISTANCE,
+    BY_DURATION
+} SortKey;
+
+/**
+ * A block of consecutive elements of the set, kept sorted.
+ */
+typedef struct BusLineBlock
+{
+    int size;
+    BusLine lines[BUS_LINE_BLOCK_CAPACITY];
+} BusLineBlock;
+
+/**
+ * A sorted array of blocks holding BusLine elements.
+ * Keeps the elements sorted by the given key under inserts and removes,
+ * a block is found by binary search on the block directory and updated
+ * in place, so there is no need to re-sort the whole array after a batch.
+ */
+typedef struct BusLineSet
+{
+    SortKey key;
+    BusLineBlock **blocks;
+    int num_of_blocks;
+    int blocks_capacity;
+    long size;
+} BusLineSet;
+
+/**
+ * An in-order iterator over a BusLineSet.
+ */
+typedef struct BusLineIter
+{
+    const BusLineSet *set;
+    int block;
+    int ind;
+} BusLineIter;
+
+/**
+ * Creates an empty set ordered by the given key.
+ * @return pointer to the new BusLineSet: upon success, NULL: otherwise
+ */
+BusLineSet *bus_line_set_create (SortKey key);
+
+/**
+ * Frees the set and all of it's blocks, sets the pointer to NULL.
+ */
+void bus_line_set_free (BusLineSet **set);
+
+/**
+ * Inserts a BusLine into it's sorted position.
+ * @return EXIT_SUCCESS upon success, EXIT_FAILURE on allocation error.
+ */
+int bus_line_set_insert (BusLineSet *set, const BusLine *line);
+
+/**
+ * Removes the element equal to the given BusLine (same key and line number).
+ * @return EXIT_SUCCESS if removed, EXIT_FAILURE if not in the set.
+ */
+int bus_line_set_remove (BusLineSet *set, const BusLine *line);
+
+/**
+ * Merges a batch already sorted by the set's key into the set, in one
+ * linear pass over the set and the batch.
+ * @param start pointer to the first element of the batch
+ * @param end pointer to the last element of the batch
+ * @return EXIT_SUCCESS upon success, EXIT_FAILURE on allocation error, in
+ * which case the set is left unchanged.
+ */
+int bus_line_set_merge_sorted (BusLineSet *set, const BusLine *start,
+                               const BusLine *end);
+
+/**
+ * Copies the elements of the set in order to the given array.
+ * @param out array of at least set->size elements
+ */
+void bus_line_set_to_array (const BusLineSet *set, BusLine *out);
+
+/**
+ * @return An iterator pointing to the smallest element of the set.
+ */
+BusLineIter bus_line_set_begin (const BusLineSet *set);
+
+/**
+ * Advances the iterator.
+ * @return pointer to the current element, NULL when the iteration is over.
+ */
+const BusLine *bus_line_set_next (BusLineIter *iter);
+
+#endif //EX2_REPO_BUSLINESET_H
@@ -0,0 +1,120 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "bus_lines_file.h"
+
+#define TEMP_SUFFIX ".tmp"
+#define KNOWN_FLAGS (SORTED_BY_DISTANCE | SORTED_BY_DURATION)
+
+_Static_assert (sizeof (BusLine) == 3 * sizeof (int),
+                "BusLine records must be packed");
+_Static_assert (sizeof (BusLinesHeader) % sizeof (int) == 0,
+                "records following the header must stay aligned");
+
+int save_bus_lines (const char *path, const BusLine *lines, long count,
+                    uint16_t flags)
+{
+  char *temp_path = malloc (strlen (path) + sizeof (TEMP_SUFFIX));
+  if (temp_path == NULL)
+  {
+    return EXIT_FAILURE;
+  }
+  strcpy (temp_path, path);
+  strcat (temp_path, TEMP_SUFFIX);
+  FILE *fp = fopen (temp_path, "wb");
+  if (fp == NULL)
+  {
+    free (temp_path);
+    return EXIT_FAILURE;
+  }
+  BusLinesHeader header = {BUS_LINES_MAGIC, BUS_LINES_VERSION, flags,
+                           (uint64_t) count};
+  int failed = fwrite (&header, sizeof (header), 1, fp) != 1
+               || fwrite (lines, sizeof (BusLine), count, fp)
+                  != (size_t) count;
+  failed = (fclose (fp) != 0) || failed;
+  if (failed || rename (temp_path, path) != 0)
+  {
+    remove (temp_path);
+    free (temp_path);
+    return EXIT_FAILURE;
+  }
+  free (temp_path);
+  return EXIT_SUCCESS;
+}
+
+/**
+ * Checks a line is within the bounds a line entered by the user is.
+ * @return EXIT_SUCCESS if it is, EXIT_FAILURE otherwise.
+ */
+static int bus_line_validity (const BusLine *line)
+{
+  if (line->line_number <= INPUT_LOWER_BOUND
+      || line->line_number >= INPUT_UPPER_BOUND
+      || line->distance < INPUT_LOWER_BOUND
+      || line->distance > INPUT_UPPER_BOUND
+      || line->duration < DURATION_LOWER_BOUND
+      || line->duration > DURATION_UPPER_BOUND)
+  {
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+BusLinesFile *load_bus_lines (const char *path)
+{
+  int fd = open (path, O_RDONLY);
+  if (fd == -1)
+  {
+    return NULL;
+  }
+  struct stat st;
+  if (fstat (fd, &st) != 0 || (size_t) st.st_size < sizeof (BusLinesHeader))
+  {
+    close (fd);
+    return NULL;
+  }
+  size_t map_size = (size_t) st.st_size;
+  void *map = mmap (NULL, map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                    fd, 0);
+  close (fd); // the mapping keeps the file referenced
+  if (map == MAP_FAILED)
+  {
+    return NULL;
+  }
+  const BusLinesHeader *header = map;
+  BusLine *lines = (BusLine *) ((char *) map + sizeof (BusLinesHeader));
+  int invalid = header->magic != BUS_LINES_MAGIC
+                || header->version != BUS_LINES_VERSION
+                || (header->flags & ~KNOWN_FLAGS) != 0
+                || header->count > (map_size - sizeof (BusLinesHeader))
+                                   / sizeof (BusLine);
+  for (uint64_t i = 0; !invalid && i < header->count; i++)
+  {
+    invalid = bus_line_validity (&lines[i]) != EXIT_SUCCESS;
+  }
+  BusLinesFile *file = invalid ? NULL : malloc (sizeof (BusLinesFile));
+  if (file == NULL)
+  {
+    munmap (map, map_size);
+    return NULL;
+  }
+  *file = (BusLinesFile) {map, map_size, header->flags, (long) header->count,
+                          lines};
+  return file;
+}
+
+void close_bus_lines (BusLinesFile **file)
+{
+  if (*file == NULL)
+  {
+    return;
+  }
+  munmap ((*file)->map, (*file)->map_size);
+  free (*file);
+  *file = NULL;
+}
@@ -0,0 +1,75 @@
+#ifndef EX2_REPO_BUSLINESFILE_H
+#define EX2_REPO_BUSLINESFILE_H
+#include <stddef.h>
+#include <stdint.h>
+#include "sort_bus_lines.h"
+
+/**
+ * Binary dataset format of a BusLine array:
+ * a BusLinesHeader followed by header.count packed BusLine records
+ * (3 native ints each), so a mapped file is used as a BusLine array as is.
+ */
+#define BUS_LINES_MAGIC 0x4C535542u // "BUSL"
+#define BUS_LINES_VERSION 1
+
+/**
+ * Sort-state flags of the dataset, telling which keys the records are
+ * already ordered by.
+ */
+#define SORTED_BY_DISTANCE 0x1u
+#define SORTED_BY_DURATION 0x2u
+
+/**
+ * Bounds of a BusLine's fields, the lines read from the user and from a
+ * dataset are both checked against them.
+ */
+#define INPUT_UPPER_BOUND 1000
+#define INPUT_LOWER_BOUND 0
+#define DURATION_LOWER_BOUND 10
+#define DURATION_UPPER_BOUND 100
+
+typedef struct BusLinesHeader
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t flags;
+    uint64_t count;
+} BusLinesHeader;
+
+/**
+ * A dataset file mapped to memory.
+ * lines points right into the mapping, the mapping is private so sorting
+ * the lines in place never changes the file.
+ */
+typedef struct BusLinesFile
+{
+    void *map;
+    size_t map_size;
+    uint16_t flags;
+    long count;
+    BusLine *lines;
+} BusLinesFile;
+
+/**
+ * Writes the given lines to a dataset file with the given sort flags.
+ * The file is written aside and renamed, so existing mappings of it stay
+ * valid.
+ * @return EXIT_SUCCESS upon success, EXIT_FAILURE otherwise.
+ */
+int save_bus_lines (const char *path, const BusLine *lines, long count,
+                    uint16_t flags);
+
+/**
+ * Maps a dataset file to memory, no parsing is done: the records are only
+ * checked to be within the bounds the user's lines are, in one pass.
+ * @return pointer to the BusLinesFile: upon success, NULL if the file can't
+ * be opened or isn't a valid dataset.
+ */
+BusLinesFile *load_bus_lines (const char *path);
+
+/**
+ * Unmaps the dataset file and sets the pointer to NULL.
+ */
+void close_bus_lines (BusLinesFile **file);
+
+#endif //EX2_REPO_BUSLINESFILE_H
@@ -1,18 +1,18 @@
 #include "sort_bus_lines.h"
 #include "test_bus_lines.h"
+#include "bus_lines_file.h"
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include <stdbool.h>
 #include <ctype.h>
+#include <unistd.h>
 #define ARG_LEN 2
+#define DATASET_ARG_LEN 3
 #define COMMAND_ARG 1
+#define DATASET_ARG 2
 #define MAX_LINE_LEN 60
 #define INT_BASE 10
-#define INPUT_UPPER_BOUND 1000
-#define INPUT_LOWER_BOUND 0
-#define DURATION_LOWER_BOUND 10
-#define DURATION_UPPER_BOUND 100
 
 
 /**
@@ -53,7 +53,7 @@ void
 run_sort (long num_of_lines, BusLine *bus_lines, const char *command);
 
 /**
- * Runs tests on both sorts - bubble and quick.
+ * Runs tests on both sorts - bubble and quick, and on the BusLineSet.
  * @param num_of_lines An integer equals to the number of lines.
  * @param bus_lines A pointer to a dynamic array of BusLine.
  * @param copy A pointer to a copy of the dynamic array of BusLine.
@@ -87,6 +87,16 @@ void test_quick_sort (long num_of_lines, BusLine *bus_lines,
                       BusLine *start_sorted, BusLine *end_sorted,
                       BusLine *start_original, BusLine *end_original);
 
+/**
+ * Runs the tests of the BusLineSet, on lines of their own.
+ */
+void test_bus_line_set (void);
+
+/**
+ * Runs the test of the binary dataset file, on lines of it's own.
+ */
+void test_bus_lines_file (void);
+
 /**
  *
  * @param num_of_lines An integer equals to the number of lines.
@@ -97,6 +107,31 @@ void test_quick_sort (long num_of_lines, BusLine *bus_lines,
 void run_command (long num_of_lines, BusLine *bus_lines,
                   BusLine *copy, const char *command);
 
+/**
+ * Prints the lines in their current order.
+ * @param num_of_lines An integer equals to the number of lines.
+ * @param bus_lines A pointer to a dynamic array of BusLine.
+ */
+void print_lines (long num_of_lines, const BusLine *bus_lines);
+
+/**
+ * Gets the sort-state flag matching the given command.
+ * @param command A string of sort type.
+ * @return The flag of the key the command sorts by, 0 for "test".
+ */
+uint16_t get_sort_flag (const char *command);
+
+/**
+ * Runs the command on a binary dataset file.
+ * If the file exists it's mapped and used as is, sorting is skipped when
+ * the dataset is already sorted by the requested key. Otherwise the lines
+ * are read from the user and saved to the file for the next runs.
+ * @param path A string of the dataset file path.
+ * @param command A string of the given command by the user.
+ * @return EXIT_SUCCESS upon success, EXIT_FAILURE otherwise.
+ */
+int run_dataset_command (const char *path, const char *command);
+
 /**
  * Frees memory allocated earlier in the program and sets pointer to NULL
  * @param dynamic_array A pointer to the memory to free
@@ -107,6 +142,8 @@ void free_memory (BusLine *dynamic_array);
  * Main function of the program.
  * Sorts a given set of Bus lines by distance or duration by request.
  * Checks validity of given command and acts accordingly.
+ * An optional second argument names a binary dataset file to use instead
+ * of reading the lines from the user.
  */
 int main (int argc, char *argv[])
 {
@@ -114,6 +151,10 @@ int main (int argc, char *argv[])
   {
     return EXIT_FAILURE;
   }
+  if (argc == DATASET_ARG_LEN) // read lines from a binary dataset
+  {
+    return run_dataset_command (argv[DATASET_ARG], argv[COMMAND_ARG]);
+  }
   long num_of_lines = get_num_of_lines (); // get number of lines from user
   BusLine *bus_lines = get_lines_info (num_of_lines); // get all lines info
   if (bus_lines == NULL) // check if memory allocation was successful
@@ -150,12 +191,92 @@ void run_command (long num_of_lines, BusLine *bus_lines,
   else
   {
     run_sort (num_of_lines, bus_lines, command);
-    for (int i = 0; i < num_of_lines; i++)
+    print_lines (num_of_lines, bus_lines);
+  }
+}
+
+void print_lines (long num_of_lines, const BusLine *bus_lines)
+{
+  for (int i = 0; i < num_of_lines; i++)
+  {
+    fprintf (stdout, "%d,%d,%d\n", bus_lines[i].line_number,
+             bus_lines[i].distance, bus_lines[i].duration);
+  }
+}
+
+uint16_t get_sort_flag (const char *command)
+{
+  if (strcmp (command, "bubble") == 0)
+  {
+    return SORTED_BY_DISTANCE;
+  }
+  if (strcmp (command, "quick") == 0)
+  {
+    return SORTED_BY_DURATION;
+  }
+  return 0;
+}
+
+int run_dataset_command (const char *path, const char *command)
+{
+  uint16_t flag = get_sort_flag (command);
+  BusLinesFile *file = load_bus_lines (path);
+  if (file == NULL)
+  {
+    if (access (path, F_OK) == 0)
+    {
+      fprintf (stdout, "ERROR: Invalid dataset file\n");
+      return EXIT_FAILURE;
+    }
+    long num_of_lines = get_num_of_lines ();
+    BusLine *bus_lines = get_lines_info (num_of_lines);
+    if (bus_lines == NULL)
+    {
+      return EXIT_FAILURE;
+    }
+    BusLine *copy = calloc (num_of_lines, sizeof (BusLine));
+    if (copy == NULL)
     {
-      fprintf (stdout, "%d,%d,%d\n", bus_lines[i].line_number,
-               bus_lines[i].distance, bus_lines[i].duration);
+      free_memory (bus_lines);
+      return EXIT_FAILURE;
     }
+    memcpy (copy, bus_lines, num_of_lines * sizeof (BusLine));
+    run_command (num_of_lines, bus_lines, copy, command);
+    int ret = save_bus_lines (path, bus_lines, num_of_lines, flag);
+    free_memory (bus_lines);
+    free_memory (copy);
+    return ret;
+  }
+  int ret = EXIT_SUCCESS;
+  if (file->count == 0)
+  {
+    close_bus_lines (&file);
+    return ret;
   }
+  if (flag == 0) // tests sort the lines, keep the original order aside
+  {
+    BusLine *copy = calloc (file->count, sizeof (BusLine));
+    if (copy == NULL)
+    {
+      close_bus_lines (&file);
+      return EXIT_FAILURE;
+    }
+    memcpy (copy, file->lines, file->count * sizeof (BusLine));
+    run_tests (file->count, file->lines, copy);
+    free_memory (copy);
+  }
+  else if ((file->flags & flag) != 0) // already sorted by requested key
+  {
+    print_lines (file->count, file->lines);
+  }
+  else
+  {
+    run_sort (file->count, file->lines, command);
+    print_lines (file->count, file->lines);
+    ret = save_bus_lines (path, file->lines, file->count, flag);
+  }
+  close_bus_lines (&file);
+  return ret;
 }
 
 void run_tests (long num_of_lines, BusLine *bus_lines, BusLine *copy)
@@ -168,6 +289,46 @@ void run_tests (long num_of_lines, BusLine *bus_lines, BusLine *copy)
                     start_original, end_original);
   test_quick_sort (num_of_lines, bus_lines, start_sorted, end_sorted,
                    start_original, end_original);
+  test_bus_line_set ();
+  test_bus_lines_file ();
+}
+
+void test_bus_line_set (void)
+{
+  if (test_set_insert () == 0)
+  {
+    fprintf (stdout, "TEST 5 FAILED: testing the set splits a full block "
+                     "and stays sorted\n");
+  }
+  else
+  {
+    fprintf (stdout, "TEST 5 PASSED: testing the set splits a full block "
+                     "and stays sorted\n");
+  }
+  if (test_set_merge () == 0)
+  {
+    fprintf (stdout, "TEST 6 FAILED: testing the set merges sorted lines "
+                     "into partly filled blocks\n");
+  }
+  else
+  {
+    fprintf (stdout, "TEST 6 PASSED: testing the set merges sorted lines "
+                     "into partly filled blocks\n");
+  }
+}
+
+void test_bus_lines_file (void)
+{
+  if (test_file_round_trip () == 0)
+  {
+    fprintf (stdout, "TEST 7 FAILED: testing a saved dataset loads the "
+                     "same lines and rejects invalid ones\n");
+  }
+  else
+  {
+    fprintf (stdout, "TEST 7 PASSED: testing a saved dataset loads the "
+                     "same lines and rejects invalid ones\n");
+  }
 }
 
 void test_quick_sort (long num_of_lines, BusLine *bus_lines,
@@ -326,10 +487,10 @@ long get_num_of_lines ()
 
 int command_validity (int argc, char *const *argv)
 {
-  if (argc != ARG_LEN)
+  if (argc != ARG_LEN && argc != DATASET_ARG_LEN)
   {
-    fprintf (stdout, "USAGE: The program only takes 1 argument, %d was given"
-                     ".\n", argc-1);
+    fprintf (stdout, "USAGE: The program takes a command and an optional "
+                     "dataset file, %d arguments were given.\n", argc-1);
     return EXIT_FAILURE;
   }
   if ((strcmp (argv[COMMAND_ARG], "bubble") != 0)
@@ -1,6 +1,15 @@
 #include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 #include "test_bus_lines.h"
 
+#define NUM_OF_SET_LINES (BUS_LINE_BLOCK_CAPACITY * 4)
+#define DISTANCE_MOD 101 // distances repeat, so ties are broken by number
+#define NUM_OF_FILE_LINES 3
+#define FILE_TEMPLATE "/tmp/test_bus_lines_XXXXXX"
+
 int is_sorted_by_distance (BusLine *start, BusLine *end)
 {
   for (;start < end; start++)
@@ -53,3 +62,159 @@ int is_equal (BusLine *start_sorted,
   }
   return 0;
 }
+
+/**
+ * Compares two BusLine elements the way a set ordered by key does.
+ * @return 1 if first comes before second, 0 otherwise.
+ */
+static int is_before (SortKey key, const BusLine *first,
+                      const BusLine *second)
+{
+  int first_val = (key == BY_DISTANCE) ? first->distance : first->duration;
+  int second_val = (key == BY_DISTANCE) ? second->distance : second->duration;
+  return first_val < second_val
+         || (first_val == second_val
+             && first->line_number < second->line_number);
+}
+
+int is_set_valid (const BusLineSet *set)
+{
+  long size = 0;
+  const BusLine *prev = NULL;
+  for (int i = 0; i < set->num_of_blocks; i++)
+  {
+    const BusLineBlock *block = set->blocks[i];
+    if (block->size <= 0 || block->size > BUS_LINE_BLOCK_CAPACITY)
+    {
+      return 0;
+    }
+    for (int j = 0; j < block->size; j++)
+    {
+      if (prev != NULL && !is_before (set->key, prev, &block->lines[j]))
+      {
+        return 0;
+      }
+      prev = &block->lines[j];
+    }
+    size += block->size;
+  }
+  return size == set->size;
+}
+
+/**
+ * Makes the i-th line of the set tests.
+ */
+static BusLine set_line (int i, int distance)
+{
+  return (BusLine) {i, distance, i};
+}
+
+int test_set_insert (void)
+{
+  BusLineSet *set = bus_line_set_create (BY_DISTANCE);
+  if (set == NULL)
+  {
+    return 0;
+  }
+  bool passed = true;
+  // a full block, inserted from the end so each goes first
+  for (int i = BUS_LINE_BLOCK_CAPACITY - 1; i >= 0 && passed; i--)
+  {
+    BusLine line = set_line (i, (i * 7) % DISTANCE_MOD);
+    passed = bus_line_set_insert (set, &line) == EXIT_SUCCESS;
+  }
+  passed = passed && set->num_of_blocks == 1 && is_set_valid (set);
+  // one more splits it in half
+  BusLine line = set_line (BUS_LINE_BLOCK_CAPACITY,
+                           (BUS_LINE_BLOCK_CAPACITY * 7) % DISTANCE_MOD);
+  passed = passed && bus_line_set_insert (set, &line) == EXIT_SUCCESS
+           && set->num_of_blocks == 2 && is_set_valid (set)
+           && set->blocks[0]->size >= BUS_LINE_BLOCK_CAPACITY / 2
+           && set->blocks[1]->size >= BUS_LINE_BLOCK_CAPACITY / 2;
+  for (int i = BUS_LINE_BLOCK_CAPACITY + 1; i < NUM_OF_SET_LINES && passed;
+       i++)
+  {
+    line = set_line (i, (i * 7) % DISTANCE_MOD);
+    passed = bus_line_set_insert (set, &line) == EXIT_SUCCESS;
+  }
+  passed = passed && set->size == NUM_OF_SET_LINES && is_set_valid (set);
+  for (int i = 0; i < NUM_OF_SET_LINES && passed; i++)
+  {
+    line = set_line (i, (i * 7) % DISTANCE_MOD);
+    passed = bus_line_set_remove (set, &line) == EXIT_SUCCESS
+             && bus_line_set_remove (set, &line) == EXIT_FAILURE
+             && is_set_valid (set);
+  }
+  passed = passed && set->size == 0 && set->num_of_blocks == 0;
+  bus_line_set_free (&set);
+  return passed;
+}
+
+int test_set_merge (void)
+{
+  BusLineSet *set = bus_line_set_create (BY_DISTANCE);
+  BusLine *batch = malloc (sizeof (BusLine) * MERGE_FILL * 2);
+  if (set == NULL || batch == NULL)
+  {
+    bus_line_set_free (&set);
+    free (batch);
+    return 0;
+  }
+  for (int i = 0; i < MERGE_FILL * 2; i++)
+  {
+    batch[i] = set_line (i, i * 2);
+  }
+  // two full merged blocks
+  bool passed = bus_line_set_merge_sorted (set, &batch[0],
+                                           &batch[MERGE_FILL * 2 - 1])
+                == EXIT_SUCCESS && set->num_of_blocks == 2
+                && set->blocks[0]->size == MERGE_FILL
+                && set->blocks[1]->size == MERGE_FILL && is_set_valid (set);
+  // one more line, between the others, opens a third block
+  BusLine line = set_line (MERGE_FILL * 2, MERGE_FILL + 1);
+  passed = passed && bus_line_set_merge_sorted (set, &line, &line)
+                     == EXIT_SUCCESS && set->num_of_blocks == 3
+           && set->blocks[2]->size == 1 && is_set_valid (set);
+  // lines before all of the others fill the first block, then split it
+  for (int i = 1; i <= BUS_LINE_BLOCK_CAPACITY - MERGE_FILL && passed; i++)
+  {
+    line = set_line (MERGE_FILL * 2 + i, -i);
+    passed = bus_line_set_insert (set, &line) == EXIT_SUCCESS
+             && set->num_of_blocks == 3;
+  }
+  line = set_line (MERGE_FILL * 3, -BUS_LINE_BLOCK_CAPACITY);
+  passed = passed && set->blocks[0]->size == BUS_LINE_BLOCK_CAPACITY
+           && bus_line_set_insert (set, &line) == EXIT_SUCCESS
+           && set->num_of_blocks == 4 && is_set_valid (set);
+  bus_line_set_free (&set);
+  free (batch);
+  return passed;
+}
+
+int test_file_round_trip (void)
+{
+  char path[] = FILE_TEMPLATE;
+  int fd = mkstemp (path);
+  if (fd == -1)
+  {
+    return 0;
+  }
+  close (fd);
+  BusLine lines[NUM_OF_FILE_LINES] = {{10, 20, 30}, {11, 5, 40},
+                                      {12, 20, 10}};
+  BusLinesFile *file = NULL;
+  bool passed = save_bus_lines (path, lines, NUM_OF_FILE_LINES,
+                                SORTED_BY_DURATION) == EXIT_SUCCESS
+                && (file = load_bus_lines (path)) != NULL
+                && file->count == NUM_OF_FILE_LINES
+                && file->flags == SORTED_BY_DURATION
+                && memcmp (file->lines, lines, sizeof (lines)) == 0;
+  close_bus_lines (&file);
+  // a duration below the bounds, the way a corrupted record may be
+  lines[1].duration = DURATION_LOWER_BOUND - 1;
+  passed = passed && save_bus_lines (path, lines, NUM_OF_FILE_LINES, 0)
+                     == EXIT_SUCCESS && (file = load_bus_lines (path)) == NULL;
+  close_bus_lines (&file);
+  remove (path);
+  return passed;
+}
@@ -1,6 +1,8 @@
 #ifndef EX2_REPO_TESTBUSLINES_H
 #define EX2_REPO_TESTBUSLINES_H
 #include "sort_bus_lines.h"
+#include "bus_line_set.h"
+#include "bus_lines_file.h"
 
 // write only between #define EX2_REPO_TESTBUSLINES_H and
 // #endif //EX2_REPO_TESTBUSLINES_H
@@ -23,6 +25,32 @@ int is_equal (BusLine *start_sorted,
               BusLine *end_sorted, BusLine *start_original,
               BusLine *end_original);
 
+/**
+ * Tests if the set is well formed: it's blocks aren't empty or over
+ * BUS_LINE_BLOCK_CAPACITY, their elements are sorted by the set's key
+ * within and across blocks, and they add up to the set's size.
+ */
+int is_set_valid (const BusLineSet *set);
+
+/**
+ * Tests inserting to a BusLineSet up to a full block, splitting it with
+ * one more element, and removing all of the elements.
+ */
+int test_set_insert (void);
+
+/**
+ * Tests merging sorted batches into a BusLineSet: blocks of MERGE_FILL
+ * elements, and inserts that fill a merged block before splitting it.
+ */
+int test_set_merge (void);
+
+/**
+ * Tests saving lines to a dataset file and loading them back with their
+ * sort flags, and that a dataset with a line out of the input bounds isn't
+ * loaded.
+ */
+int test_file_round_trip (void);
+
 // write only between #define EX2_REPO_TESTBUSLINES_H and
 // #endif //EX2_REPO_TESTBUSLINES_H
 #endif //EX2_REPO_TESTBUSLINES_H
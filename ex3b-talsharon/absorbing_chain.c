@@ -0,0 +1,703 @@
+#include "absorbing_chain.h"
+#include <math.h>
+#include <string.h>
+
+#define INITIAL_CAPACITY 64
+#define GROWTH_FACTOR 2
+#define MIN_PIVOT 1e-12
+#define TOLERANCE 1e-13 // of the residual, relative to the costs' norm
+#define MAX_ITERATIONS 1000 // about 100s for a million states
+#define NUM_OF_VECTORS 8 // of the iterative solver
+#define MAX_LOOPS 4 // open at once in the preconditioner
+#define MAX_LOOP_LENGTH 256 // rows of the preconditioner's open loops
+
+/**
+ * The rows of a chain while they're built.
+ */
+typedef struct RowBuilder {
+    int *columns;
+    double *probabilities;
+    int size;
+    int capacity;
+} RowBuilder;
+
+static int append_entry (RowBuilder *rows, int column, double probability)
+{
+  if (rows->size == rows->capacity)
+  {
+    int capacity = rows->capacity * GROWTH_FACTOR;
+    int *columns = realloc (rows->columns, sizeof (int) * capacity);
+    if (columns == NULL)
+    {
+      return 1;
+    }
+    rows->columns = columns;
+    double *probabilities = realloc (rows->probabilities,
+                                     sizeof (double) * capacity);
+    if (probabilities == NULL)
+    {
+      return 1;
+    }
+    rows->probabilities = probabilities;
+    rows->capacity = capacity;
+  }
+  rows->columns[rows->size] = column;
+  rows->probabilities[rows->size++] = probability;
+  return 0;
+}
+
+/**
+ * Appends the successors of a state, each with probability times it's
+ * transition probability, leading through free successors.
+ * @param depth num of free states led through, more than the num of states
+ * means they lead to each other in a cycle
+ * @return 0 on success, 1 in case of allocation error or a cycle
+ */
+static int append_successors (RowBuilder *rows, const AbsorbingChain *chain,
+                              MarkovNode *const *nodes, int id,
+                              double probability, int depth)
+{
+  if (depth > chain->num_of_states)
+  {
+    return 1;
+  }
+  const MarkovNode *markov_node = nodes[id];
+  long total = 0;
+  for (int i = 0; i < markov_node->counter_list_size; i++)
+  {
+    total += markov_node->counter_list[i].frequency;
+  }
+  for (int i = 0; i < markov_node->counter_list_size; i++)
+  {
+    const NextNodeCounter *counter = &markov_node->counter_list[i];
+    int next = counter->markov_node->id;
+    double next_probability = probability * counter->frequency / total;
+    int status = chain->free[next]
+                 ? append_successors (rows, chain, nodes, next,
+                                      next_probability, depth + 1)
+                 : append_entry (rows, next, next_probability);
+    if (status != 0)
+    {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+AbsorbingChain *build_absorbing_chain (const MarkovChain *markov_chain,
+                                       GenericIsLast is_free)
+{
+  int n = markov_chain->database->size;
+  AbsorbingChain *chain = calloc (1, sizeof (AbsorbingChain));
+  MarkovNode **nodes = malloc (sizeof (MarkovNode *) * (n + 1));
+  RowBuilder rows = {malloc (sizeof (int) * INITIAL_CAPACITY),
+                     malloc (sizeof (double) * INITIAL_CAPACITY), 0,
+                     INITIAL_CAPACITY};
+  if (chain == NULL || nodes == NULL || rows.columns == NULL
+      || rows.probabilities == NULL
+      || (chain->absorbing = malloc (sizeof (bool) * (n + 1))) == NULL
+      || (chain->free = malloc (sizeof (bool) * (n + 1))) == NULL
+      || (chain->row_offsets = malloc (sizeof (int) * (n + 1))) == NULL)
+  {
+    free (nodes);
+    free (rows.columns);
+    free (rows.probabilities);
+    free_absorbing_chain (&chain);
+    return NULL;
+  }
+  chain->num_of_states = n;
+  for (Node *node = markov_chain->database->first; node != NULL;
+       node = node->next)
+  {
+    MarkovNode *markov_node = node->data;
+    int id = markov_node->id;
+    nodes[id] = markov_node;
+    chain->absorbing[id] = markov_chain->is_last (markov_node->data)
+                           || markov_node->counter_list_size == 0;
+    chain->free[id] = !chain->absorbing[id] && is_free != NULL
+                      && is_free (markov_node->data);
+  }
+  int status = 0;
+  for (int id = 0; id < n && status == 0; id++)
+  {
+    chain->row_offsets[id] = rows.size;
+    if (!chain->absorbing[id])
+    {
+      status = append_successors (&rows, chain, nodes, id, 1, 0);
+    }
+  }
+  chain->row_offsets[n] = rows.size;
+  chain->columns = rows.columns;
+  chain->probabilities = rows.probabilities;
+  free (nodes);
+  if (status != 0)
+  {
+    free_absorbing_chain (&chain);
+  }
+  return chain;
+}
+
+/**
+ * Cost of a step from a state: a move, but for free and absorbing states.
+ */
+static double step_cost (const AbsorbingChain *chain, int id)
+{
+  return chain->absorbing[id] || chain->free[id] ? 0 : 1;
+}
+
+/**
+ * Checks that every state can reach an absorbing one, by one BFS from the
+ * absorbing states over the chain's rows reversed.
+ * @return 0 if they all can, 1 in case of allocation error,
+ * UNREACHABLE_ABSORPTION otherwise
+ */
+static int check_absorption (const AbsorbingChain *chain)
+{
+  int n = chain->num_of_states;
+  int num_of_entries = chain->row_offsets[n];
+  // entries leading to state i: sources[in_offsets[i] .. in_offsets[i+1]]
+  int *in_offsets = calloc ((size_t) n + 1, sizeof (int));
+  int *sources = malloc (sizeof (int) * (num_of_entries + 1));
+  int *queue = malloc (sizeof (int) * (n + 1));
+  bool *reaches = calloc ((size_t) n + 1, sizeof (bool));
+  if (in_offsets == NULL || sources == NULL || queue == NULL
+      || reaches == NULL)
+  {
+    free (in_offsets);
+    free (sources);
+    free (queue);
+    free (reaches);
+    return 1;
+  }
+  for (int e = 0; e < num_of_entries; e++)
+  {
+    in_offsets[chain->columns[e]]++;
+  }
+  for (int i = 1; i <= n; i++) // the end of each state's entries
+  {
+    in_offsets[i] += in_offsets[i - 1];
+  }
+  for (int i = 0; i < n; i++) // filled from the end, back to the start
+  {
+    for (int e = chain->row_offsets[i]; e < chain->row_offsets[i + 1]; e++)
+    {
+      sources[--in_offsets[chain->columns[e]]] = i;
+    }
+  }
+  int head = 0, tail = 0;
+  for (int i = 0; i < n; i++)
+  {
+    if (chain->absorbing[i])
+    {
+      reaches[i] = true;
+      queue[tail++] = i;
+    }
+  }
+  while (head < tail)
+  {
+    int id = queue[head++];
+    for (int e = in_offsets[id]; e < in_offsets[id + 1]; e++)
+    {
+      if (!reaches[sources[e]])
+      {
+        reaches[sources[e]] = true;
+        queue[tail++] = sources[e];
+      }
+    }
+  }
+  free (in_offsets);
+  free (sources);
+  free (queue);
+  free (reaches);
+  return tail == n ? 0 : UNREACHABLE_ABSORPTION;
+}
+
+/**
+ * Solves (I - Q) t = c by LU decomposition with partial pivoting.
+ * @return 0 on success, 1 in case of allocation error,
+ * UNREACHABLE_ABSORPTION if the matrix is singular
+ */
+static int solve_dense (const AbsorbingChain *chain, double *steps)
+{
+  int n = chain->num_of_states;
+  double *matrix = calloc ((size_t) n * n + 1, sizeof (double));
+  if (matrix == NULL)
+  {
+    return 1;
+  }
+  for (int i = 0; i < n; i++)
+  {
+    matrix[(size_t) i * n + i] = 1;
+    for (int e = chain->row_offsets[i]; e < chain->row_offsets[i + 1]; e++)
+    {
+      if (!chain->absorbing[chain->columns[e]]) // t is 0 there
+      {
+        matrix[(size_t) i * n + chain->columns[e]] -= chain->probabilities[e];
+      }
+    }
+    steps[i] = step_cost (chain, i);
+  }
+  // the right hand side is eliminated along with the rows
+  for (int k = 0; k < n; k++)
+  {
+    int pivot = k;
+    for (int i = k + 1; i < n; i++)
+    {
+      if (fabs (matrix[(size_t) i * n + k])
+          > fabs (matrix[(size_t) pivot * n + k]))
+      {
+        pivot = i;
+      }
+    }
+    if (fabs (matrix[(size_t) pivot * n + k]) < MIN_PIVOT)
+    {
+      free (matrix);
+      return UNREACHABLE_ABSORPTION;
+    }
+    if (pivot != k)
+    {
+      for (int j = 0; j < n; j++)
+      {
+        double temp = matrix[(size_t) k * n + j];
+        matrix[(size_t) k * n + j] = matrix[(size_t) pivot * n + j];
+        matrix[(size_t) pivot * n + j] = temp;
+      }
+      double temp = steps[k];
+      steps[k] = steps[pivot];
+      steps[pivot] = temp;
+    }
+    for (int i = k + 1; i < n; i++)
+    {
+      double factor = matrix[(size_t) i * n + k] / matrix[(size_t) k * n + k];
+      if (factor == 0)
+      {
+        continue;
+      }
+      for (int j = k; j < n; j++)
+      {
+        matrix[(size_t) i * n + j] -= factor * matrix[(size_t) k * n + j];
+      }
+      steps[i] -= factor * steps[k];
+    }
+  }
+  for (int i = n - 1; i >= 0; i--)
+  {
+    double sum = steps[i];
+    for (int j = i + 1; j < n; j++)
+    {
+      sum -= matrix[(size_t) i * n + j] * steps[j];
+    }
+    steps[i] = sum / matrix[(size_t) i * n + i];
+  }
+  free (matrix);
+  return 0;
+}
+
+/**
+ * A loop open in the preconditioner's sweep: the rows of it's block hold
+ * z = z' + coefficients * z[target], until target's row solves it.
+ */
+typedef struct Loop {
+    int target;
+    double *coefficients;
+} Loop;
+
+/**
+ * Opens a loop on every state the backward steps of a row lead to, that
+ * has none open and keeps the block, the rows from top down to the loops'
+ * states, within MAX_LOOP_LENGTH, while there's room.
+ * @param top the block's first row, the row itself if no loop is open
+ */
+static void open_loops (const AbsorbingChain *chain, int id, int top,
+                        Loop *loops, int *num_of_loops)
+{
+  for (int e = chain->row_offsets[id];
+       e < chain->row_offsets[id + 1] && *num_of_loops < MAX_LOOPS; e++)
+  {
+    int column = chain->columns[e];
+    bool is_open = false;
+    for (int k = 0; k < *num_of_loops && !is_open; k++)
+    {
+      is_open = loops[k].target == column;
+    }
+    if (column < id && top - column <= MAX_LOOP_LENGTH && !is_open
+        && !chain->absorbing[column])
+    {
+      loops[(*num_of_loops)++].target = column;
+    }
+  }
+}
+
+/**
+ * Solves the loop on a state once it's row is swept: the state's value
+ * becomes a part of the rows above it in the block and of the loops still
+ * open.
+ */
+static void close_loop (Loop *loops, int *num_of_loops, int k, int top,
+                        double *z)
+{
+  int id = loops[k].target;
+  double *coefficients = loops[k].coefficients;
+  double feedback = coefficients[id];
+  double scale = 1 - feedback > MIN_PIVOT ? 1 / (1 - feedback) : 1;
+  coefficients[id] = 0;
+  z[id] *= scale;
+  for (int other = 0; other < *num_of_loops; other++)
+  {
+    loops[other].coefficients[id] *= scale;
+  }
+  for (int j = id + 1; j <= top; j++)
+  {
+    if (coefficients[j] != 0)
+    {
+      z[j] += coefficients[j] * z[id];
+      for (int other = 0; other < *num_of_loops; other++)
+      {
+        loops[other].coefficients[j] += other != k
+            ? coefficients[j] * loops[other].coefficients[id] : 0;
+      }
+      coefficients[j] = 0;
+    }
+  }
+  Loop closed = loops[k]; // it's coefficients are kept for the next loop
+  loops[k] = loops[--*num_of_loops];
+  loops[*num_of_loops] = closed;
+}
+
+/**
+ * Applies the preconditioner, one backward Gauss-Seidel sweep from the last
+ * state that solves short loops on the way: the backward steps of a row open
+ * loops on the states they lead to (see open_loops), and the rows below
+ * are kept in terms of the open loops' states until their rows are swept.
+ * Backward steps that open no loop are left out. On boards moves go forward,
+ * so this solves the whole game but for long snakes and crowded ones.
+ * @param coefficients MAX_LOOPS vectors of num_of_states, all 0, and left
+ * so
+ */
+static void precondition (const AbsorbingChain *chain, const double *r,
+                          double *z, double *coefficients)
+{
+  int n = chain->num_of_states, num_of_loops = 0, top = -1;
+  Loop loops[MAX_LOOPS];
+  for (int k = 0; k < MAX_LOOPS; k++)
+  {
+    loops[k].coefficients = coefficients + (size_t) k * n;
+  }
+  for (int i = n - 1; i >= 0; i--)
+  {
+    z[i] = 0;
+    if (chain->absorbing[i])
+    {
+      continue;
+    }
+    top = num_of_loops > 0 ? top : i;
+    open_loops (chain, i, top, loops, &num_of_loops);
+    double sum = r[i], self = 0;
+    for (int e = chain->row_offsets[i]; e < chain->row_offsets[i + 1]; e++)
+    {
+      int column = chain->columns[e];
+      double probability = chain->probabilities[e];
+      if (column == i)
+      {
+        self += probability;
+        continue;
+      }
+      if (chain->absorbing[column])
+      {
+        continue;
+      }
+      sum += column > i ? probability * z[column] : 0;
+      for (int k = 0; k < num_of_loops; k++)
+      {
+        loops[k].coefficients[i] += column > i
+            ? probability * loops[k].coefficients[column]
+            : (column == loops[k].target ? probability : 0);
+      }
+    }
+    z[i] = sum / (1 - self);
+    for (int k = 0; k < num_of_loops; k++)
+    {
+      loops[k].coefficients[i] /= 1 - self;
+    }
+    for (int k = 0; k < num_of_loops; k++)
+    {
+      if (loops[k].target == i)
+      {
+        close_loop (loops, &num_of_loops, k, top, z);
+        break;
+      }
+    }
+  }
+}
+
+/**
+ * Sets y = (I - Q) x, over the non absorbing states.
+ */
+static void multiply (const AbsorbingChain *chain, const double *x, double *y)
+{
+  for (int i = 0; i < chain->num_of_states; i++)
+  {
+    double sum = chain->absorbing[i] ? 0 : x[i];
+    for (int e = chain->row_offsets[i];
+         e < chain->row_offsets[i + 1] && !chain->absorbing[i]; e++)
+    {
+      if (!chain->absorbing[chain->columns[e]])
+      {
+        sum -= chain->probabilities[e] * x[chain->columns[e]];
+      }
+    }
+    y[i] = sum;
+  }
+}
+
+static double dot (const double *x, const double *y, int n)
+{
+  double sum = 0;
+  for (int i = 0; i < n; i++)
+  {
+    sum += x[i] * y[i];
+  }
+  return sum;
+}
+
+/**
+ * Sets r = b - (I - Q) x, b the cost of a step from each state.
+ */
+static void residual (const AbsorbingChain *chain, const double *x,
+                      double *r)
+{
+  multiply (chain, x, r);
+  for (int i = 0; i < chain->num_of_states; i++)
+  {
+    r[i] = step_cost (chain, i) - r[i];
+  }
+}
+
+/**
+ * Solves (I - Q) t = c by BiCGSTAB, right preconditioned by a backward
+ * Gauss-Seidel sweep that solves short loops (see precondition). The
+ * preconditioned matrix is the identity but for the backward steps the
+ * sweep leaves out, so the iterations grow with the long and crowded snakes
+ * rather than with the size of the board. Each iteration is 2 sweeps and 2
+ * products over the rows, about 0.1s for a million states, and the solver
+ * takes NUM_OF_VECTORS + MAX_LOOPS vectors of num_of_states. On a million
+ * cells, 2000 or 20000 snakes and ladders of up to 50 cells took 1
+ * iteration, 2000 or 20000 of any length 14 to 16. Games of more than about
+ * 1e15 moves still converge, but to rounding errors as large as the answer.
+ * @return 0 on success, 1 in case of allocation error, UNSOLVED_ABSORPTION
+ * if it didn't converge in MAX_ITERATIONS
+ */
+static int solve_iterative (const AbsorbingChain *chain, double *steps)
+{
+  int n = chain->num_of_states;
+  double *vectors = calloc ((size_t) (NUM_OF_VECTORS + MAX_LOOPS) * n,
+                            sizeof (double));
+  if (vectors == NULL)
+  {
+    return 1;
+  }
+  double *r = vectors, *r0 = r + n, *p = r0 + n, *v = p + n, *p_hat = v + n;
+  double *s = p_hat + n, *s_hat = s + n, *t = s_hat + n;
+  double *loops = t + n;
+  double *x = steps;
+  residual (chain, (memset (x, 0, sizeof (double) * n), x), r);
+  double target = TOLERANCE * sqrt (dot (r, r, n)); // b, as x is 0
+  precondition (chain, r, x, loops); // one sweep is the first guess
+  residual (chain, x, r);
+  double rho = 1, alpha = 1, omega = 1;
+  bool restart = true;
+  for (int iteration = 0; iteration < MAX_ITERATIONS; iteration++)
+  {
+    if (sqrt (dot (r, r, n)) <= target)
+    {
+      free (vectors);
+      return 0;
+    }
+    if (restart) // on a breakdown, from the current residual
+    {
+      memcpy (r0, r, sizeof (double) * n);
+      memset (p, 0, sizeof (double) * n);
+      memset (v, 0, sizeof (double) * n);
+      rho = alpha = omega = 1;
+      restart = false;
+    }
+    double rho_next = dot (r0, r, n);
+    double beta = (rho_next / rho) * (alpha / omega);
+    for (int i = 0; i < n; i++)
+    {
+      p[i] = r[i] + beta * (p[i] - omega * v[i]);
+    }
+    precondition (chain, p, p_hat, loops);
+    multiply (chain, p_hat, v);
+    double r0_v = dot (r0, v, n);
+    if (rho_next == 0 || r0_v == 0)
+    {
+      restart = true;
+      continue;
+    }
+    alpha = rho_next / r0_v;
+    for (int i = 0; i < n; i++)
+    {
+      s[i] = r[i] - alpha * v[i];
+    }
+    precondition (chain, s, s_hat, loops);
+    multiply (chain, s_hat, t);
+    double t_t = dot (t, t, n);
+    omega = t_t > 0 ? dot (t, s, n) / t_t : 0;
+    for (int i = 0; i < n; i++)
+    {
+      x[i] += alpha * p_hat[i] + omega * s_hat[i];
+      r[i] = s[i] - omega * t[i];
+    }
+    rho = rho_next;
+    restart = omega == 0;
+  }
+  free (vectors);
+  return UNSOLVED_ABSORPTION;
+}
+
+int expected_absorption_moves (const AbsorbingChain *chain, double *steps)
+{
+  int status = check_absorption (chain);
+  if (status != 0)
+  {
+    return status;
+  }
+  if (chain->num_of_states <= DENSE_SOLVER_MAX_STATES)
+  {
+    return solve_dense (chain, steps);
+  }
+  return solve_iterative (chain, steps);
+}
+
+/**
+ * Moves the mass of each state in from along it's row: into to, or into
+ * absorbed for absorbing successors.
+ */
+static void step_distribution (const AbsorbingChain *chain, const double *from,
+                               double *to, double *absorbed)
+{
+  for (int i = 0; i < chain->num_of_states; i++)
+  {
+    if (from[i] == 0)
+    {
+      continue;
+    }
+    for (int e = chain->row_offsets[i]; e < chain->row_offsets[i + 1]; e++)
+    {
+      double mass = from[i] * chain->probabilities[e];
+      if (chain->absorbing[chain->columns[e]])
+      {
+        *absorbed += mass;
+      }
+      else
+      {
+        to[chain->columns[e]] += mass;
+      }
+    }
+  }
+}
+
+/**
+ * Grows the distribution to hold one more move.
+ * @return 0 on success, 1 in case of allocation error
+ */
+static int grow_distribution (double **distribution, int *capacity)
+{
+  int capacity_grown = *capacity * GROWTH_FACTOR;
+  double *grown = realloc (*distribution, sizeof (double) * capacity_grown);
+  if (grown == NULL)
+  {
+    return 1;
+  }
+  memset (grown + *capacity, 0,
+          sizeof (double) * (capacity_grown - *capacity));
+  *distribution = grown;
+  *capacity = capacity_grown;
+  return 0;
+}
+
+double absorption_distribution (const AbsorbingChain *chain, int start,
+                                double max_tail, double **distribution,
+                                int *num_of_moves)
+{
+  int n = chain->num_of_states, capacity = INITIAL_CAPACITY;
+  long max_moves = DISTRIBUTION_MAX_WORK
+                   / ((long) n + chain->row_offsets[n]);
+  double *cur = calloc ((size_t) n + 1, sizeof (double));
+  double *next = calloc ((size_t) n + 1, sizeof (double));
+  double *moves = calloc (capacity, sizeof (double));
+  *distribution = NULL;
+  if (cur == NULL || next == NULL || moves == NULL)
+  {
+    free (cur);
+    free (next);
+    free (moves);
+    return -1;
+  }
+  if (chain->absorbing[start])
+  {
+    moves[0] = 1;
+  }
+  else if (chain->free[start]) // it's step is taken before the first move
+  {
+    for (int e = chain->row_offsets[start]; e < chain->row_offsets[start + 1];
+         e++)
+    {
+      if (chain->absorbing[chain->columns[e]])
+      {
+        moves[0] += chain->probabilities[e];
+      }
+      else
+      {
+        cur[chain->columns[e]] += chain->probabilities[e];
+      }
+    }
+  }
+  else
+  {
+    cur[start] = 1;
+  }
+  int k = 0;
+  for (double remaining = 1 - moves[0];
+       remaining > max_tail && k < max_moves; remaining -= moves[k])
+  {
+    if (++k == capacity && grow_distribution (&moves, &capacity) != 0)
+    {
+      free (cur);
+      free (next);
+      free (moves);
+      return -1;
+    }
+    memset (next, 0, sizeof (double) * n);
+    step_distribution (chain, cur, next, &moves[k]);
+    double *temp = cur;
+    cur = next;
+    next = temp;
+  }
+  double remaining = 0; // summed again, free of the rounding of the moves
+  for (int i = 0; i < n; i++)
+  {
+    remaining += cur[i];
+  }
+  free (cur);
+  free (next);
+  *distribution = moves;
+  *num_of_moves = k;
+  return remaining;
+}
+
+void free_absorbing_chain (AbsorbingChain **chain)
+{
+  if (*chain == NULL)
+  {
+    return;
+  }
+  free ((*chain)->absorbing);
+  free ((*chain)->free);
+  free ((*chain)->row_offsets);
+  free ((*chain)->columns);
+  free ((*chain)->probabilities);
+  free (*chain);
+  *chain = NULL;
+}
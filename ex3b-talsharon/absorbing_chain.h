@@ -0,0 +1,83 @@
+#ifndef ABSORBING_CHAIN_H
+#define ABSORBING_CHAIN_H
+#include "markov_chain.h"
+
+// chains of up to this many states are solved by dense LU, larger ones
+// iteratively
+#define DENSE_SOLVER_MAX_STATES 2048
+// expected_absorption_moves of a chain with a state that can't reach an
+// absorbing one
+#define UNREACHABLE_ABSORPTION 2
+// expected_absorption_moves of a chain the iteration didn't solve in time
+#define UNSOLVED_ABSORPTION 3
+// entries absorption_distribution steps over in all, at most: about 3s
+#define DISTRIBUTION_MAX_WORK 2000000000L
+
+/**
+ * A chain's transition matrix, for exact analysis of it's random walks.
+ * States are numbered by their id in the database. A state is absorbing
+ * if it's last or has no successors; the successors of every other state
+ * are a row of the matrix, in compressed sparse rows.
+ * A step from a free state costs no move: it's taken together with the
+ * move that led to it, so rows lead through free states to their
+ * successors (like a snake or a ladder, taken in the same turn as the die
+ * roll that landed on it).
+ */
+typedef struct AbsorbingChain {
+    int num_of_states;
+    bool *absorbing;
+    bool *free; // steps from it cost no move
+    int *row_offsets; // row of state i: row_offsets[i] .. row_offsets[i+1]
+    int *columns; // successor state of each entry
+    double *probabilities; // transition probability of each entry
+} AbsorbingChain;
+
+/**
+ * Builds the transition matrix of a chain from it's counter lists.
+ * @param markov_chain a chain with a database
+ * @param is_free returns true for the data of free states, NULL for none
+ * @return pointer to the new AbsorbingChain: upon success, NULL: in case of
+ * allocation error, or if free states lead to each other in a cycle.
+ */
+AbsorbingChain *build_absorbing_chain (const MarkovChain *markov_chain,
+                                       GenericIsLast is_free);
+
+/**
+ * Computes the expected num of moves until absorption from every state:
+ * solves (I - Q) t = c, Q the transitions between non absorbing states and
+ * c the cost of a step from each (0 for free states, 1 otherwise). By LU
+ * decomposition with partial pivoting for up to DENSE_SOLVER_MAX_STATES
+ * states, by preconditioned BiCGSTAB above it.
+ * Every state is first checked to reach an absorbing one, by one BFS back
+ * from them, so such a chain fails at once instead of in the solve.
+ * @param steps array of num_of_states, set to the expected moves
+ * @return 0 on success, 1 in case of allocation error,
+ * UNREACHABLE_ABSORPTION if some state can't reach an absorbing one,
+ * UNSOLVED_ABSORPTION if the iteration didn't converge
+ */
+int expected_absorption_moves (const AbsorbingChain *chain, double *steps);
+
+/**
+ * Computes the distribution of the num of moves until absorption from a
+ * state, by repeated products of a distribution over the states with the
+ * sparse matrix, until no more than max_tail of it is left. Each move steps
+ * over all of the chain, so the moves are cut once DISTRIBUTION_MAX_WORK
+ * entries were stepped over.
+ * @param start id of the state to start from
+ * @param max_tail probability of a longer walk to stop at
+ * @param distribution set to a new array of *num_of_moves + 1, the
+ * probability of absorption after exactly k moves: free it
+ * @param num_of_moves set to the num of moves computed
+ * @return the probability of absorption after more than *num_of_moves
+ * moves, -1 in case of allocation error
+ */
+double absorption_distribution (const AbsorbingChain *chain, int start,
+                                double max_tail, double **distribution,
+                                int *num_of_moves);
+
+/**
+ * Frees the chain and sets the pointer to NULL.
+ */
+void free_absorbing_chain (AbsorbingChain **chain);
+
+#endif //ABSORBING_CHAIN_H
@@ -0,0 +1,86 @@
+#include "alias_table.h"
+#include <stdlib.h>
+
+AliasTable *create_alias_table (const int *weights, int size)
+{
+  AliasTable *table = malloc (sizeof (AliasTable));
+  int *threshold = malloc (sizeof (int) * size);
+  int *alias = malloc (sizeof (int) * size);
+  // scaled[i] = weights[i] * size, compared against total: a column is
+  // "small" if it's below the average weight
+  long long *scaled = malloc (sizeof (long long) * size);
+  int *small = malloc (sizeof (int) * size);
+  int *large = malloc (sizeof (int) * size);
+  if (table == NULL || threshold == NULL || alias == NULL || scaled == NULL
+      || small == NULL || large == NULL)
+  {
+    free (table);
+    free (threshold);
+    free (alias);
+    free (scaled);
+    free (small);
+    free (large);
+    return NULL;
+  }
+  long long total = 0;
+  for (int i = 0; i < size; i++)
+  {
+    total += weights[i];
+  }
+  int num_small = 0, num_large = 0;
+  for (int i = 0; i < size; i++)
+  {
+    scaled[i] = (long long) weights[i] * size;
+    alias[i] = i;
+    if (scaled[i] < total)
+    {
+      small[num_small++] = i;
+    }
+    else
+    {
+      large[num_large++] = i;
+    }
+  }
+  while (num_small > 0 && num_large > 0)
+  {
+    int less = small[--num_small];
+    int more = large[--num_large];
+    threshold[less] = (int) scaled[less];
+    alias[less] = more;
+    scaled[more] -= total - scaled[less];
+    if (scaled[more] < total)
+    {
+      small[num_small++] = more;
+    }
+    else
+    {
+      large[num_large++] = more;
+    }
+  }
+  // what's left is exactly average
+  while (num_large > 0)
+  {
+    threshold[large[--num_large]] = (int) total;
+  }
+  while (num_small > 0)
+  {
+    threshold[small[--num_small]] = (int) total;
+  }
+  free (scaled);
+  free (small);
+  free (large);
+  *table = (AliasTable) {size, (int) total, threshold, alias};
+  return table;
+}
+
+void free_alias_table (AliasTable **table)
+{
+  if (*table == NULL)
+  {
+    return;
+  }
+  free ((*table)->threshold);
+  free ((*table)->alias);
+  free (*table);
+  *table = NULL;
+}
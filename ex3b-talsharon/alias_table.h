@@ -0,0 +1,43 @@
+#ifndef ALIAS_TABLE_H
+#define ALIAS_TABLE_H
+
+/**
+ * A Walker/Vose alias table over integer weights.
+ * Sampling picks a column uniformly and keeps it or takes it's alias by one
+ * comparison, so it costs O(1) no matter how many outcomes there are.
+ * Thresholds are in units of total, which keeps the probabilities exact.
+ */
+typedef struct AliasTable {
+    int size; // num of outcomes
+    int total; // sum of the weights the table was built from
+    int *threshold; // keep column i if the coin is below threshold[i]
+    int *alias; // outcome to take otherwise
+} AliasTable;
+
+/**
+ * Builds an alias table over the given weights.
+ * @param weights array of positive weights
+ * @param size num of weights, at least 1
+ * @return pointer to the new AliasTable: upon success, NULL: otherwise
+ */
+AliasTable *create_alias_table (const int *weights, int size);
+
+/**
+ * Picks an outcome from a uniform draw.
+ * @param table the table to sample from
+ * @param column uniform draw in [0, size)
+ * @param coin uniform draw in [0, total)
+ * @return index of the chosen outcome
+ */
+static inline int sample_alias_table (const AliasTable *table, int column,
+                                      int coin)
+{
+  return coin < table->threshold[column] ? column : table->alias[column];
+}
+
+/**
+ * Frees the table and sets the pointer to NULL.
+ */
+void free_alias_table (AliasTable **table);
+
+#endif //ALIAS_TABLE_H
@@ -0,0 +1,150 @@
+#include "arena.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdalign.h>
+
+#define ARENA_BLOCK_SIZE (1 << 20)
+// larger allocations get a block of their own
+#define MAX_SHARED_ALLOC (ARENA_BLOCK_SIZE / 4)
+#define ALIGNMENT alignof (max_align_t)
+#define ALIGN_UP(X) (((X) + ALIGNMENT - 1) & ~(size_t) (ALIGNMENT - 1))
+#define HEADER_SIZE ALIGN_UP (sizeof (ArenaBlock))
+#define MIN_SIZE_CLASS 4 // smallest slab is 16 bytes, fits a free list link
+
+/**
+ * Gets the data of a block.
+ */
+static char *block_data (ArenaBlock *block)
+{
+  return (char *) block + HEADER_SIZE;
+}
+
+/**
+ * Allocates a new block of at least size bytes.
+ * A block for a single large allocation is linked after the block being
+ * filled, so it doesn't waste what is left of it.
+ * @return pointer to the new block: upon success, NULL: otherwise
+ */
+static ArenaBlock *add_block (Arena *arena, size_t size)
+{
+  size_t block_size = size > MAX_SHARED_ALLOC ? size : ARENA_BLOCK_SIZE;
+  ArenaBlock *block = malloc (HEADER_SIZE + block_size);
+  if (block == NULL)
+  {
+    return NULL;
+  }
+  block->size = block_size;
+  block->used = 0;
+  if (size > MAX_SHARED_ALLOC && arena->blocks != NULL)
+  {
+    block->next = arena->blocks->next;
+    arena->blocks->next = block;
+  }
+  else
+  {
+    block->next = arena->blocks;
+    arena->blocks = block;
+  }
+  arena->num_of_blocks++;
+  arena->bytes_allocated += HEADER_SIZE + block_size;
+  return block;
+}
+
+/**
+ * Gets the size class of an array: the log2 of it's slab size.
+ */
+static int size_class (size_t size)
+{
+  int ind = MIN_SIZE_CLASS;
+  while (((size_t) 1 << ind) < size)
+  {
+    ind++;
+  }
+  return ind;
+}
+
+Arena *create_arena (void)
+{
+  Arena *arena = calloc (1, sizeof (Arena));
+  return arena;
+}
+
+void *arena_alloc (Arena *arena, size_t size)
+{
+  size = ALIGN_UP (size);
+  ArenaBlock *block = arena->blocks;
+  if (size > MAX_SHARED_ALLOC || block == NULL
+      || block->size - block->used < size)
+  {
+    block = add_block (arena, size);
+    if (block == NULL)
+    {
+      return NULL;
+    }
+  }
+  void *ptr = block_data (block) + block->used;
+  block->used += size;
+  return ptr;
+}
+
+void *arena_copy (Arena *arena, const void *data, size_t size)
+{
+  void *ptr = arena_alloc (arena, size);
+  if (ptr != NULL)
+  {
+    memcpy (ptr, data, size);
+  }
+  return ptr;
+}
+
+void *arena_resize_array (Arena *arena, void *ptr, size_t old_size,
+                          size_t new_size)
+{
+  int old_class = size_class (old_size);
+  int new_class = size_class (new_size);
+  if (ptr != NULL && new_class == old_class)
+  {
+    return ptr;
+  }
+  if (new_class >= ARENA_SIZE_CLASSES)
+  {
+    return NULL;
+  }
+  void *new_ptr = arena->free_lists[new_class];
+  if (new_ptr != NULL) // reuse a slab that was outgrown
+  {
+    arena->free_lists[new_class] = *(void **) new_ptr;
+  }
+  else
+  {
+    new_ptr = arena_alloc (arena, (size_t) 1 << new_class);
+    if (new_ptr == NULL)
+    {
+      return NULL;
+    }
+  }
+  if (ptr != NULL)
+  {
+    memcpy (new_ptr, ptr, old_size < new_size ? old_size : new_size);
+    *(void **) ptr = arena->free_lists[old_class];
+    arena->free_lists[old_class] = ptr;
+  }
+  return new_ptr;
+}
+
+void free_arena (Arena **arena)
+{
+  if (*arena == NULL)
+  {
+    return;
+  }
+  ArenaBlock *block = (*arena)->blocks;
+  while (block != NULL)
+  {
+    ArenaBlock *temp = block;
+    block = block->next;
+    free (temp);
+  }
+  free (*arena);
+  *arena = NULL;
+}
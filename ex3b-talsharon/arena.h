@@ -0,0 +1,67 @@
+#ifndef ARENA_H
+#define ARENA_H
+#include <stddef.h>
+
+/**
+ * Num of size classes of the arena's free lists: arrays of 2^0 .. 2^31
+ * bytes rounded up to a power of 2.
+ */
+#define ARENA_SIZE_CLASSES 32
+
+typedef struct ArenaBlock {
+    struct ArenaBlock *next;
+    size_t size; // bytes available in data
+    size_t used;
+    // data follows the header
+} ArenaBlock;
+
+/**
+ * A bump allocator: memory is handed out from a few large blocks and
+ * released all at once when the arena is freed.
+ * Growable arrays get power of 2 sized slabs, and an array that is
+ * outgrown goes back to a free list of it's size class for reuse.
+ */
+typedef struct Arena {
+    ArenaBlock *blocks; // the block being filled is first
+    void *free_lists[ARENA_SIZE_CLASSES];
+    size_t num_of_blocks;
+    size_t bytes_allocated; // bytes taken by the blocks
+} Arena;
+
+/**
+ * Creates an empty arena.
+ * @return pointer to the new Arena: upon success, NULL: otherwise
+ */
+Arena *create_arena (void);
+
+/**
+ * Allocates memory from the arena, aligned for any type.
+ * @return pointer to the memory: upon success, NULL: otherwise
+ */
+void *arena_alloc (Arena *arena, size_t size);
+
+/**
+ * Allocates a copy of the given bytes from the arena.
+ * @return pointer to the copy: upon success, NULL: otherwise
+ */
+void *arena_copy (Arena *arena, const void *data, size_t size);
+
+/**
+ * Resizes an array allocated by this function (or NULL) to new_size bytes.
+ * The array lives in a slab of a power of 2 size, so growing it inside the
+ * slab is free, and a slab that is outgrown is kept for reuse.
+ * @param ptr the array, or NULL
+ * @param old_size size in bytes ptr was last resized to (0 for NULL)
+ * @param new_size new size in bytes
+ * @return pointer to the resized array: upon success, NULL: otherwise (ptr
+ * is left as is)
+ */
+void *arena_resize_array (Arena *arena, void *ptr, size_t old_size,
+                          size_t new_size);
+
+/**
+ * Frees all memory of the arena and sets the pointer to NULL.
+ */
+void free_arena (Arena **arena);
+
+#endif //ARENA_H
@@ -0,0 +1,155 @@
+#include "bench_common.h"
+#include "corpus.h"
+#include <time.h>
+
+bool ends_with_dot (const char *str, size_t len)
+{
+  return len > 0 && str[len - 1] == '.';
+}
+
+bool is_last_str (void *data)
+{
+  return ((const InternedStr *) data)->is_last;
+}
+
+int comp_str (const void *first, const void *second)
+{
+  return comp_interned (first, second);
+}
+
+size_t hash_str (const void *data)
+{
+  return (size_t) ((const InternedStr *) data)->hash;
+}
+
+void *copy_str (const void *data)
+{
+  return (void *) data;
+}
+
+MarkovChain *create_string_chain (bool indexed)
+{
+  LinkedList *database = malloc (sizeof (LinkedList));
+  MarkovChain *markov_chain = malloc (sizeof (MarkovChain));
+  if (database == NULL || markov_chain == NULL)
+  {
+    free (database);
+    free (markov_chain);
+    return NULL;
+  }
+  *database = (LinkedList) {NULL, NULL, 0};
+  *markov_chain = (MarkovChain) {.database = database,
+                                 .comp_func = comp_str,
+                                 .copy_func = copy_str,
+                                 .is_last = is_last_str,
+                                 .hash_func = indexed ? hash_str : NULL};
+  return markov_chain;
+}
+
+double now (void)
+{
+  struct timespec time;
+  clock_gettime (CLOCK_MONOTONIC, &time);
+  return (double) time.tv_sec + (double) time.tv_nsec * NANO;
+}
+
+size_t chain_bytes (const MarkovChain *markov_chain)
+{
+  size_t bytes = sizeof (MarkovNode *) * markov_chain->start_nodes_capacity;
+  for (const ArenaBlock *block = markov_chain->arena != NULL
+                                 ? markov_chain->arena->blocks : NULL;
+       block != NULL; block = block->next)
+  {
+    bytes += block->used;
+  }
+  if (markov_chain->index != NULL)
+  {
+    bytes += (sizeof (size_t) + sizeof (Node *))
+             * markov_chain->index->capacity;
+  }
+  if (markov_chain->compiled != NULL)
+  {
+    bytes += markov_chain->compiled->image_size;
+  }
+  if (markov_chain->approximate != NULL)
+  {
+    bytes += count_min_bytes (markov_chain->approximate->edges);
+  }
+  return bytes;
+}
+
+/**
+ * Adds a state to the chain, following the previous one.
+ * @return the state's Node, NULL in case of allocation error
+ */
+static Node *train_state (MarkovChain *markov_chain, const void *state,
+                          Node *prev, bool specialized)
+{
+  Node *node = specialized
+               ? add_string_to_database (markov_chain, state)
+               : add_to_database (markov_chain, (void *) state);
+  if (node == NULL || prev == NULL)
+  {
+    return node;
+  }
+  bool added = specialized
+               ? add_string_to_counter_list (prev->data, node->data,
+                                             markov_chain)
+               : add_node_to_counter_list (prev->data, node->data,
+                                           markov_chain);
+  return added ? node : NULL;
+}
+
+int train_chain (const char *text, size_t size, StringPool *pool,
+                 NGramPool *ngrams, MarkovChain *markov_chain,
+                 bool specialized, size_t *tokens)
+{
+  const char *cur = text, *end = text + size;
+  size_t len = 0;
+  const char *line;
+  while ((line = next_line (&cur, end, &len)) != NULL)
+  {
+    const char *word_cur = line;
+    const NGram *window = NULL;
+    Node *prev = NULL;
+    size_t word_len = 0;
+    const char *token;
+    while ((token = next_token (&word_cur, line + len, &word_len)) != NULL)
+    {
+      if (tokens != NULL)
+      {
+        (*tokens)++;
+      }
+      const InternedStr *word = intern_str (pool, token, word_len);
+      if (word == NULL)
+      {
+        return 1;
+      }
+      const void *state = word;
+      if (ngrams != NULL)
+      {
+        window = shift_ngram (ngrams, window, word);
+        if (window == NULL)
+        {
+          return 1;
+        }
+        if (window->order < ngrams->order) // not a full state yet
+        {
+          window = word->is_last ? NULL : window;
+          continue;
+        }
+        state = window;
+      }
+      Node *node = train_state (markov_chain, state, prev,
+                                specialized && ngrams == NULL);
+      if (node == NULL)
+      {
+        return 1;
+      }
+      // the next sentence starts afresh
+      prev = word->is_last ? NULL : node;
+      window = word->is_last ? NULL : window;
+    }
+  }
+  return 0;
+}
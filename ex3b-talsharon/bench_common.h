@@ -0,0 +1,65 @@
+#ifndef BENCH_COMMON_H
+#define BENCH_COMMON_H
+#include "markov_chain.h"
+#include "string_pool.h"
+#include "ngram.h"
+#include <stddef.h>
+#include <stdbool.h>
+
+#define NANO 1e-9
+
+/**
+ * The word functions of a chain of pool words, the way tweets_generator
+ * sets them: the pool's words are it's states, compared and hashed by the
+ * pool.
+ */
+bool ends_with_dot (const char *str, size_t len);
+
+bool is_last_str (void *data);
+
+int comp_str (const void *first, const void *second);
+
+size_t hash_str (const void *data);
+
+/**
+ * Copies a state by it's pointer: the pool owns the words and tuples,
+ * states point to them.
+ */
+void *copy_str (const void *data);
+
+/**
+ * Creates an empty chain of pool words, the way tweets_generator does.
+ * @param indexed true to index it's database by hash_str
+ * @return pointer to the new MarkovChain: upon success, NULL: otherwise
+ */
+MarkovChain *create_string_chain (bool indexed);
+
+/**
+ * Gets the time of a monotonic clock, in seconds.
+ */
+double now (void);
+
+/**
+ * Bytes used by a chain's nodes, counters, index, start nodes, and it's
+ * compiled image and sketch if it has them. The arena's used bytes are
+ * counted, not the allocated: it's blocks are too big to tell chains
+ * apart.
+ */
+size_t chain_bytes (const MarkovChain *markov_chain);
+
+/**
+ * Trains a chain on all of a text, line by line, the way tweets_generator
+ * does.
+ * @param pool pointer to StringPool the words are interned in
+ * @param ngrams pointer to NGramPool for a chain of order-k states, NULL
+ *               for a chain of words
+ * @param specialized true to train a chain of words by the functions
+ *                    specialized for InternedStr states
+ * @param tokens if not NULL, increased by the num of words read
+ * @return 0 on success, 1 in case of allocation error
+ */
+int train_chain (const char *text, size_t size, StringPool *pool,
+                 NGramPool *ngrams, MarkovChain *markov_chain,
+                 bool specialized, size_t *tokens);
+
+#endif //BENCH_COMMON_H
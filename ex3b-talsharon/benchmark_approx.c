@@ -0,0 +1,183 @@
+#include "bench_common.h"
+#include "corpus.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define CORPUS_ARG 1
+#define BUDGET_ARG 2
+#define MIN_ARG_LEN 2
+#define DEFAULT_BUDGET_KB 256
+#define BYTES_PER_KB 1024
+#define INT_BASE 10
+#define NUM_OF_CONFIGS 6
+#define USAGE_MSG "Usage: benchmark_approx <corpus> [sketch budget in KB]\n"
+#define HEADER_MSG "threshold\tprune_every\tcounters\tbytes\tbytes_saved\t" \
+"mass_kept\ttv_distance\n"
+#define EXACT_ROW_MSG "exact\t-\t%ld\t%zu\t-\t1.000\t0.000\n"
+#define ROW_MSG "%d\t%ld\t%ld\t%zu\t%.1f%%\t%.3f\t%.3f\n"
+
+/**
+ * An approximate training configuration to compare with the exact chain.
+ */
+typedef struct ApproxConfig {
+    int promote_threshold;
+    long prune_every;
+} ApproxConfig;
+
+static const ApproxConfig CONFIGS[NUM_OF_CONFIGS] = {
+    {2, 0}, {3, 0}, {1, 10000}, {1, 50000}, {2, 50000}, {3, 50000}};
+
+static long num_of_counters (const MarkovChain *markov_chain)
+{
+  long counters = 0;
+  for (Node *node = markov_chain->database->first; node != NULL;
+       node = node->next)
+  {
+    counters += node->data->counter_list_size;
+  }
+  return counters;
+}
+
+/**
+ * Compares the next state distributions of an approximate chain with the
+ * exact one's, weighted by how often each state occurred: the probability
+ * that a generated step of the approximate chain has to differ from the
+ * exact chain's (total variation distance), and the share of the exact
+ * transitions the approximate chain kept.
+ * @return 0 on success, 1 in case of allocation error
+ */
+static int compare (MarkovChain *exact, MarkovChain *approx,
+                    double *distance, double *mass_kept)
+{
+  int size = exact->database->size;
+  MarkovNode **approx_nodes = malloc (sizeof (MarkovNode *) * (size + 1));
+  double *q = calloc ((size_t) size + 1, sizeof (double));
+  if (approx_nodes == NULL || q == NULL)
+  {
+    free (approx_nodes);
+    free (q);
+    return 1;
+  }
+  for (Node *node = exact->database->first; node != NULL; node = node->next)
+  {
+    approx_nodes[node->data->id] = get_node_from_database
+        (approx, node->data->data)->data;
+  }
+  double weighted = 0, weights = 0, kept = 0, total = 0;
+  for (Node *node = exact->database->first; node != NULL; node = node->next)
+  {
+    MarkovNode *e = node->data;
+    MarkovNode *a = approx_nodes[e->id];
+    if (e->counter_list_size == 0)
+    {
+      continue;
+    }
+    int e_total = 0;
+    for (int i = 0; i < e->counter_list_size; i++)
+    {
+      e_total += e->counter_list[i].frequency;
+    }
+    int a_total = 0;
+    for (int i = 0; i < a->counter_list_size; i++)
+    {
+      q[a->counter_list[i].markov_node->id] = a->counter_list[i].frequency;
+      a_total += a->counter_list[i].frequency;
+    }
+    double diff = a_total == 0 ? 2 : 0;
+    for (int i = 0; i < e->counter_list_size && a_total > 0; i++)
+    {
+      int target = approx_nodes[e->counter_list[i].markov_node->id]->id;
+      diff += fabs ((double) e->counter_list[i].frequency / e_total
+                    - q[target] / a_total);
+      kept += q[target] > 0 ? e->counter_list[i].frequency : 0;
+    }
+    for (int i = 0; i < a->counter_list_size; i++)
+    {
+      q[a->counter_list[i].markov_node->id] = 0;
+    }
+    weighted += diff / 2 * e_total;
+    weights += e_total;
+    total += e_total;
+  }
+  *distance = weights > 0 ? weighted / weights : 0;
+  *mass_kept = total > 0 ? kept / total : 1;
+  free (approx_nodes);
+  free (q);
+  return 0;
+}
+
+/**
+ * Trains an exact chain and approximate chains with a sketch of the given
+ * budget on a corpus, and prints for each approximate configuration the
+ * memory it saved against how far it's generation is from the exact one.
+ * @param argc number of arguments given from command line
+ * @param argv command line's arguments
+                1) the corpus
+                2) optional: sketch budget in KB, if not given: 256
+ * @return 0: upon success, 1: otherwise
+ */
+int main (int argc, char *argv[])
+{
+  if (argc < MIN_ARG_LEN)
+  {
+    fprintf (stderr, USAGE_MSG);
+    return EXIT_FAILURE;
+  }
+  size_t budget = (argc > BUDGET_ARG
+                   ? (size_t) strtol (argv[BUDGET_ARG], NULL, INT_BASE)
+                   : DEFAULT_BUDGET_KB) * BYTES_PER_KB;
+  Corpus *corpus = open_corpus (argv[CORPUS_ARG]);
+  StringPool *pool = create_string_pool (ends_with_dot);
+  MarkovChain *exact = create_string_chain (true);
+  if (corpus == NULL || pool == NULL || exact == NULL
+      || train_chain (corpus->text, corpus->size, pool, NULL, exact,
+                      false, NULL) != 0)
+  {
+    fprintf (stderr, ALLOCATION_ERROR_MASSAGE);
+    close_corpus (&corpus);
+    free_string_pool (&pool);
+    if (exact != NULL)
+    {
+      free_markov_chain (&exact);
+    }
+    return EXIT_FAILURE;
+  }
+  size_t exact_bytes = chain_bytes (exact);
+  fprintf (stdout, HEADER_MSG);
+  fprintf (stdout, EXACT_ROW_MSG, num_of_counters (exact), exact_bytes);
+  int status = EXIT_SUCCESS;
+  for (int i = 0; i < NUM_OF_CONFIGS && status == EXIT_SUCCESS; i++)
+  {
+    MarkovChain *approx = create_string_chain (true);
+    double distance = 0, mass_kept = 0;
+    if (approx == NULL
+        || !start_approximate_training (approx, budget,
+                                        CONFIGS[i].promote_threshold,
+                                        CONFIGS[i].prune_every)
+        || train_chain (corpus->text, corpus->size, pool, NULL, approx,
+                        false, NULL) != 0
+        || compare (exact, approx, &distance, &mass_kept) != 0)
+    {
+      fprintf (stderr, ALLOCATION_ERROR_MASSAGE);
+      status = EXIT_FAILURE;
+    }
+    else
+    {
+      size_t bytes = chain_bytes (approx);
+      fprintf (stdout, ROW_MSG, CONFIGS[i].promote_threshold,
+               CONFIGS[i].prune_every, num_of_counters (approx), bytes,
+               100.0 * ((double) exact_bytes - (double) bytes) / exact_bytes,
+               mass_kept, distance);
+    }
+    if (approx != NULL)
+    {
+      free_markov_chain (&approx);
+    }
+  }
+  free_markov_chain (&exact);
+  close_corpus (&corpus);
+  free_string_pool (&pool);
+  return status;
+}
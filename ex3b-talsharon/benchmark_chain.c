@@ -0,0 +1,323 @@
+#include "bench_common.h"
+#include "corpus.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#define CORPUS_ARG 1
+#define MAX_SCALE_ARG 2
+#define MIN_ARG_LEN 2
+#define DEFAULT_MAX_SCALE 1000
+#define SCALE_FACTOR 10 // scales 1, 10, 100 .. max scale
+#define TIME_BUDGET 60 // seconds an engine may be expected to train a scale
+#define NUM_OF_TWEETS 100000
+#define MAX_TWEET_LENGTH 20
+#define SEED 1
+#define INT_BASE 10
+#define INITIAL_CAPACITY 1024
+#define GROWTH_FACTOR 2
+#define NUM_OF_ENGINES 5
+#define USAGE_MSG "Usage: benchmark_chain <corpus> [max scale]\n"
+#define HEADER_MSG "engine\tscale\twords\tstates\ttrain_sec\twords/sec\t" \
+"prepare_sec\tchain_bytes\tpeak_rss_kb\ttweets\tgen_sec\ttweets/sec\t" \
+"ns/step\tstatus\n"
+#define ROW_MSG "%s\t%d\t%zu\t%d\t%.3f\t%.0f\t%.3f\t%zu\t%ld\t%d\t%.3f\t" \
+"%.0f\t%.1f\tok\n"
+#define SKIPPED_ROW_MSG "%s\t%d\t-\t-\t-\t-\t-\t-\t-\t-\t-\t-\t-\tskipped\n"
+#define FAILED_ROW_MSG "%s\t%d\t-\t-\t-\t-\t-\t-\t-\t-\t-\t-\t-\tfailed\n"
+
+/**
+ * The ways a chain is trained and generated from.
+ */
+typedef enum Engine {
+    ENGINE_LIST, // states looked up by scanning the database
+    ENGINE_HASH, // states looked up by the hash index
+    ENGINE_STRING, // hashed, by the chain's functions specialized for strings
+    ENGINE_CSR, // hashed, generated from a compiled image by running sums
+    ENGINE_ALIAS // hashed, frozen: generated from a compiled image by alias
+} Engine;
+
+static const char *const ENGINE_NAMES[NUM_OF_ENGINES] = {"list", "hash",
+                                                         "string", "csr",
+                                                         "alias"};
+
+/**
+ * What a run of one engine on one scale measured.
+ */
+typedef struct RunResult {
+    bool success;
+    size_t words;
+    int states;
+    double train_seconds;
+    double prepare_seconds; // compiling the image, or freezing
+    size_t chain_bytes;
+    long steps; // states generated
+    double gen_seconds;
+} RunResult;
+
+/**
+ * Copies the corpus scale times, the lines of each copy shuffled by a
+ * stream of it's own, so every scale has the base corpus' words and
+ * transitions scale times over, in an order the chain can't take
+ * advantage of.
+ * @param size set to the size of the text
+ * @return the text, NULL in case of allocation error
+ */
+static char *scale_corpus (const Corpus *corpus, int scale, size_t *size)
+{
+  size_t num_of_lines = 0, capacity = INITIAL_CAPACITY;
+  const char **lines = malloc (sizeof (char *) * capacity);
+  size_t *lens = malloc (sizeof (size_t) * capacity);
+  char *text = malloc (corpus->size * scale + scale);
+  const char *cur = corpus->text, *end = corpus->text + corpus->size;
+  const char *line;
+  size_t len = 0;
+  while (lines != NULL && lens != NULL && text != NULL
+         && (line = next_line (&cur, end, &len)) != NULL)
+  {
+    if (num_of_lines == capacity)
+    {
+      capacity *= GROWTH_FACTOR;
+      const char **grown_lines = realloc (lines, sizeof (char *) * capacity);
+      lines = grown_lines != NULL ? grown_lines : lines;
+      size_t *grown_lens = realloc (lens, sizeof (size_t) * capacity);
+      lens = grown_lens != NULL ? grown_lens : lens;
+      if (grown_lines == NULL || grown_lens == NULL)
+      {
+        free (text);
+        text = NULL;
+        break;
+      }
+    }
+    lines[num_of_lines] = line;
+    lens[num_of_lines++] = len;
+  }
+  *size = 0;
+  for (int copy = 0; text != NULL && copy < scale; copy++)
+  {
+    Rng rng = rng_stream (SEED, (uint64_t) copy);
+    for (size_t i = num_of_lines; i > 1; i--) // Fisher-Yates
+    {
+      size_t j = (size_t) rng_below (&rng, (int) i);
+      const char *temp_line = lines[i - 1];
+      lines[i - 1] = lines[j];
+      lines[j] = temp_line;
+      size_t temp_len = lens[i - 1];
+      lens[i - 1] = lens[j];
+      lens[j] = temp_len;
+    }
+    for (size_t i = 0; i < num_of_lines; i++)
+    {
+      memcpy (text + *size, lines[i], lens[i]);
+      *size += lens[i];
+      text[(*size)++] = '\n';
+    }
+  }
+  free (lines);
+  free (lens);
+  return text;
+}
+
+/**
+ * Compiles the chain for the engine, the CSR engine without alias tables
+ * so it's states are sampled by their running sums.
+ * @return true on success, false in case of allocation error
+ */
+static bool prepare (MarkovChain *markov_chain, Engine engine)
+{
+  if (engine == ENGINE_ALIAS)
+  {
+    return freeze_markov_chain (markov_chain);
+  }
+  if (engine == ENGINE_CSR)
+  {
+    markov_chain->compiled = compile_markov_chain (markov_chain, false,
+                                                   false);
+    if (markov_chain->compiled == NULL)
+    {
+      return false;
+    }
+    markov_chain->compiled->source_version = markov_chain->version;
+  }
+  return true;
+}
+
+/**
+ * Trains a chain on the text by the engine, and generates NUM_OF_TWEETS
+ * tweets from it into a buffer.
+ */
+static RunResult run_engine (const char *text, size_t size, Engine engine)
+{
+  RunResult result = {false};
+  StringPool *pool = create_string_pool (ends_with_dot);
+  MarkovChain *markov_chain = create_string_chain (engine != ENGINE_LIST);
+  if (pool == NULL || markov_chain == NULL)
+  {
+    free_string_pool (&pool);
+    if (markov_chain != NULL)
+    {
+      free_markov_chain (&markov_chain);
+    }
+    return result;
+  }
+  double start = now ();
+  bool specialized = engine == ENGINE_STRING;
+  int status = train_chain (text, size, pool, NULL, markov_chain,
+                            specialized, &result.words);
+  result.train_seconds = now () - start;
+  start = now ();
+  if (status == 0 && prepare (markov_chain, engine))
+  {
+    result.prepare_seconds = now () - start;
+    result.states = markov_chain->database->size;
+    result.chain_bytes = chain_bytes (markov_chain);
+    Rng rng = rng_seed (SEED);
+    void *states[MAX_TWEET_LENGTH];
+    const InternedStr *words[MAX_TWEET_LENGTH];
+    int len = 0;
+    start = now ();
+    for (int i = 0; i < NUM_OF_TWEETS; i++)
+    {
+      if (specialized)
+      {
+        generate_strings_into (markov_chain, NULL, MAX_TWEET_LENGTH, &rng,
+                               words, &len);
+      }
+      else
+      {
+        generate_sequence_into (markov_chain, NULL, MAX_TWEET_LENGTH, &rng,
+                                states, &len);
+      }
+      result.steps += len;
+    }
+    result.gen_seconds = now () - start;
+    result.success = true;
+  }
+  free_markov_chain (&markov_chain);
+  free_string_pool (&pool);
+  return result;
+}
+
+/**
+ * Runs an engine in a child process, so it's peak memory is it's own.
+ * @param peak_rss set to the child's peak resident memory, in KB
+ */
+static RunResult run_isolated (const char *text, size_t size, Engine engine,
+                               long *peak_rss)
+{
+  RunResult result = {false};
+  int fds[2];
+  if (pipe (fds) != 0)
+  {
+    return result;
+  }
+  fflush (NULL);
+  pid_t pid = fork ();
+  if (pid == 0)
+  {
+    close (fds[0]);
+    result = run_engine (text, size, engine);
+    ssize_t written = write (fds[1], &result, sizeof (RunResult));
+    _exit (written == (ssize_t) sizeof (RunResult) ? EXIT_SUCCESS
+                                                   : EXIT_FAILURE);
+  }
+  close (fds[1]);
+  if (pid > 0 && read (fds[0], &result, sizeof (RunResult))
+                 != (ssize_t) sizeof (RunResult))
+  {
+    result.success = false;
+  }
+  close (fds[0]);
+  struct rusage usage = {0};
+  int wait_status = 0;
+  if (pid < 0 || wait4 (pid, &wait_status, 0, &usage) != pid)
+  {
+    result.success = false;
+  }
+  *peak_rss = usage.ru_maxrss;
+  return result;
+}
+
+/**
+ * Trains a chain by each engine on the corpus copied 1, 10, 100 .. max
+ * scale times, generates tweets from it, and prints a tab separated row
+ * per engine and scale. An engine whose training is expected to take more
+ * than TIME_BUDGET seconds on a scale, by it's speed on the scale before,
+ * is skipped from there on.
+ * @param argc number of arguments given from command line
+ * @param argv command line's arguments
+                1) the corpus
+                2) optional: max scale, if not given: 1000
+ * @return 0: upon success, 1: otherwise
+ */
+int main (int argc, char *argv[])
+{
+  if (argc < MIN_ARG_LEN)
+  {
+    fprintf (stderr, USAGE_MSG);
+    return EXIT_FAILURE;
+  }
+  int max_scale = argc > MAX_SCALE_ARG
+                  ? (int) strtol (argv[MAX_SCALE_ARG], NULL, INT_BASE)
+                  : DEFAULT_MAX_SCALE;
+  Corpus *corpus = open_corpus (argv[CORPUS_ARG]);
+  if (corpus == NULL)
+  {
+    fprintf (stderr, USAGE_MSG);
+    return EXIT_FAILURE;
+  }
+  double words_per_sec[NUM_OF_ENGINES] = {0};
+  size_t base_words = 0; // words of the corpus
+  int status = EXIT_SUCCESS;
+  fprintf (stdout, HEADER_MSG);
+  for (int scale = 1; scale <= max_scale && status == EXIT_SUCCESS;
+       scale *= SCALE_FACTOR)
+  {
+    size_t size = 0;
+    char *text = scale_corpus (corpus, scale, &size);
+    if (text == NULL)
+    {
+      fprintf (stderr, ALLOCATION_ERROR_MASSAGE);
+      status = EXIT_FAILURE;
+      break;
+    }
+    for (int engine = 0; engine < NUM_OF_ENGINES; engine++)
+    {
+      // an engine that failed, or was skipped, is skipped from there on
+      double expected_seconds = words_per_sec[engine] > 0
+                                ? (double) base_words * scale
+                                  / words_per_sec[engine] : 0;
+      if (scale > 1 && (words_per_sec[engine] <= 0
+                        || expected_seconds > TIME_BUDGET))
+      {
+        fprintf (stdout, SKIPPED_ROW_MSG, ENGINE_NAMES[engine], scale);
+        words_per_sec[engine] = 0;
+        continue;
+      }
+      long peak_rss = 0;
+      RunResult result = run_isolated (text, size, (Engine) engine,
+                                       &peak_rss);
+      if (!result.success)
+      {
+        fprintf (stdout, FAILED_ROW_MSG, ENGINE_NAMES[engine], scale);
+        words_per_sec[engine] = 0;
+        continue;
+      }
+      words_per_sec[engine] = result.words / result.train_seconds;
+      base_words = result.words / scale;
+      fprintf (stdout, ROW_MSG, ENGINE_NAMES[engine], scale, result.words,
+               result.states, result.train_seconds, words_per_sec[engine],
+               result.prepare_seconds, result.chain_bytes, peak_rss,
+               NUM_OF_TWEETS, result.gen_seconds,
+               NUM_OF_TWEETS / result.gen_seconds,
+               result.gen_seconds / NANO / result.steps);
+      fflush (stdout);
+    }
+    free (text);
+  }
+  close_corpus (&corpus);
+  return status;
+}
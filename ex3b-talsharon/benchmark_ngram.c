@@ -0,0 +1,125 @@
+#include "bench_common.h"
+#include "corpus.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define CORPUS_ARG 1
+#define MAX_ORDER_ARG 2
+#define MIN_ARG_LEN 2
+#define DEFAULT_MAX_ORDER 4
+#define INT_BASE 10
+#define USAGE_MSG "Usage: benchmark_ngram <corpus> [max order]\n"
+#define HEADER_MSG "order\ttokens\tstates\tseconds\tstates/sec\t" \
+"tokens/sec\tbytes/state\n"
+#define ROW_MSG "%d\t%zu\t%d\t%.3f\t%.0f\t%.0f\t%.1f\n"
+
+/**
+ * The training work of one order: tokens read and what they cost.
+ */
+typedef struct OrderResult {
+    size_t tokens;
+    int states;
+    double seconds;
+    size_t bytes; // taken by the chain and it's tuples, not the words
+} OrderResult;
+
+static bool is_last_ngram (void *data)
+{
+  return ((const NGram *) data)->word->is_last;
+}
+
+static int comp_ngram (const void *first, const void *second)
+{
+  return (first > second) - (first < second);
+}
+
+static size_t hash_ngram (const void *data)
+{
+  return (size_t) ((const NGram *) data)->key;
+}
+
+/**
+ * Trains an order-k chain of NGram states on the corpus, the same way
+ * tweets_generator does, and measures it.
+ * @return 0 on success, 1 in case of allocation error
+ */
+static int train_order (const Corpus *corpus, StringPool *pool, int order,
+                        OrderResult *result)
+{
+  LinkedList database = {NULL, NULL, 0};
+  MarkovChain markov_chain = {.database = &database,
+                              .comp_func = comp_ngram,
+                              .copy_func = copy_str,
+                              .is_last = is_last_ngram,
+                              .hash_func = hash_ngram};
+  NGramPool *ngrams = create_ngram_pool ((uint32_t) order);
+  if (ngrams == NULL)
+  {
+    return 1;
+  }
+  *result = (OrderResult) {0};
+  double start = now ();
+  int status = train_chain (corpus->text, corpus->size, pool, ngrams,
+                            &markov_chain, false, &result->tokens);
+  result->seconds = now () - start;
+  result->states = database.size;
+  if (status == 0 && markov_chain.arena != NULL)
+  {
+    result->bytes = chain_bytes (&markov_chain)
+                    + ngrams->arena->bytes_allocated
+                    + sizeof (NGram *) * ngrams->capacity;
+  }
+  free_hash_index (&markov_chain.index);
+  free (markov_chain.start_nodes);
+  free_arena (&markov_chain.arena);
+  free_ngram_pool (&ngrams);
+  return status;
+}
+
+/**
+ * Trains order 1 .. max order chains on a corpus and prints, for each,
+ * how fast states were trained and how much memory a state takes.
+ * @param argc number of arguments given from command line
+ * @param argv command line's arguments
+                1) the corpus
+                2) optional: max order, if not given: 4
+ * @return 0: upon success, 1: otherwise
+ */
+int main (int argc, char *argv[])
+{
+  if (argc < MIN_ARG_LEN)
+  {
+    fprintf (stderr, USAGE_MSG);
+    return EXIT_FAILURE;
+  }
+  int max_order = argc > MAX_ORDER_ARG
+                  ? (int) strtol (argv[MAX_ORDER_ARG], NULL, INT_BASE)
+                  : DEFAULT_MAX_ORDER;
+  Corpus *corpus = open_corpus (argv[CORPUS_ARG]);
+  // one pool of words for all orders: each order's bytes are it's states
+  // only, the first order's time includes interning the words
+  StringPool *pool = create_string_pool (ends_with_dot);
+  if (corpus == NULL || pool == NULL)
+  {
+    close_corpus (&corpus);
+    free_string_pool (&pool);
+    return EXIT_FAILURE;
+  }
+  fprintf (stdout, HEADER_MSG);
+  for (int order = 1; order <= max_order; order++)
+  {
+    OrderResult result;
+    if (train_order (corpus, pool, order, &result) != 0)
+    {
+      fprintf (stderr, ALLOCATION_ERROR_MASSAGE);
+      break;
+    }
+    fprintf (stdout, ROW_MSG, order, result.tokens, result.states,
+             result.seconds, result.states / result.seconds,
+             result.tokens / result.seconds,
+             result.states > 0 ? (double) result.bytes / result.states : 0);
+  }
+  close_corpus (&corpus);
+  free_string_pool (&pool);
+  return EXIT_SUCCESS;
+}
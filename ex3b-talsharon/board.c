@@ -0,0 +1,305 @@
+#include "board.h"
+#include <stdio.h>
+#include <string.h>
+
+#define INITIAL_CAPACITY 64
+#define GROWTH_FACTOR 2
+
+static int comp_jumps (const void *first, const void *second)
+{
+  const int *jump1 = (const int *) first;
+  const int *jump2 = (const int *) second;
+  return (jump1[0] > jump2[0]) - (jump1[0] < jump2[0]);
+}
+
+/**
+ * Finds the jump from a cell.
+ * @return it's index in the board's jumps, -1 if there is no jump from it
+ */
+static int find_jump (const Board *board, int cell)
+{
+  int low = 0, high = board->num_of_jumps;
+  while (low < high)
+  {
+    int mid = low + (high - low) / 2;
+    if (board->jumps[mid][0] < cell)
+    {
+      low = mid + 1;
+    }
+    else
+    {
+      high = mid;
+    }
+  }
+  return low < board->num_of_jumps && board->jumps[low][0] == cell ? low
+                                                                   : -1;
+}
+
+int board_land (const Board *board, int cell)
+{
+  for (int hops = 0; board_jump (board, cell) != NO_JUMP_TO; hops++)
+  {
+    if (hops == board->num_of_jumps)
+    {
+      return -1;
+    }
+    cell = board_jump (board, cell);
+  }
+  return cell;
+}
+
+/**
+ * Finds the first of the jumps sorted by the cell they lead to that leads
+ * to the given cell, or past it.
+ */
+static int first_jump_to (int (*const by_to)[2], int num_of_jumps, int cell)
+{
+  int low = 0, high = num_of_jumps;
+  while (low < high)
+  {
+    int mid = low + (high - low) / 2;
+    if (by_to[mid][1] < cell)
+    {
+      low = mid + 1;
+    }
+    else
+    {
+      high = mid;
+    }
+  }
+  return low;
+}
+
+static int comp_jumps_to (const void *first, const void *second)
+{
+  const int *jump1 = (const int *) first;
+  const int *jump2 = (const int *) second;
+  return (jump1[1] > jump2[1]) - (jump1[1] < jump2[1]);
+}
+
+/**
+ * Checks that the last cell can be reached from every cell, by one BFS
+ * back from it: a cell reaches it if it's jump leads to a cell that does,
+ * or, with no jump, if one of the cells it's die lands on does. Otherwise
+ * a game could never end, and the game's matrix is singular.
+ * @return 0 if it can, 1 if it can't or in case of allocation error
+ */
+static int check_reachable (const Board *board)
+{
+  int n = board->num_of_cells;
+  bool *reaches = calloc ((size_t) n + 1, sizeof (bool));
+  int *queue = malloc (sizeof (int) * n);
+  int (*by_to)[2] = malloc (sizeof (*by_to) * (board->num_of_jumps + 1));
+  if (reaches == NULL || queue == NULL || by_to == NULL)
+  {
+    free (reaches);
+    free (queue);
+    free (by_to);
+    return 1;
+  }
+  memcpy (by_to, board->jumps, sizeof (*by_to) * board->num_of_jumps);
+  qsort (by_to, board->num_of_jumps, sizeof (*by_to), comp_jumps_to);
+  int head = 0, tail = 0;
+  reaches[n] = true;
+  queue[tail++] = n;
+  while (head < tail)
+  {
+    int cell = queue[head++];
+    for (int i = first_jump_to (by_to, board->num_of_jumps, cell);
+         i < board->num_of_jumps && by_to[i][1] == cell; i++)
+    {
+      if (!reaches[by_to[i][0]])
+      {
+        reaches[by_to[i][0]] = true;
+        queue[tail++] = by_to[i][0];
+      }
+    }
+    // the die lands on it from the cells up to BOARD_DIE_FACES before it
+    for (int from = cell > BOARD_DIE_FACES ? cell - BOARD_DIE_FACES : 1;
+         from < cell; from++)
+    {
+      if (!reaches[from] && board_jump (board, from) == NO_JUMP_TO)
+      {
+        reaches[from] = true;
+        queue[tail++] = from;
+      }
+    }
+  }
+  free (reaches);
+  free (queue);
+  free (by_to);
+  return tail == n ? 0 : 1;
+}
+
+/**
+ * Checks the jumps of a board, sorted.
+ * @return 0 if they are valid, 1 otherwise
+ */
+static int check_jumps (const Board *board)
+{
+  for (int i = 0; i < board->num_of_jumps; i++)
+  {
+    int from = board->jumps[i][0], to = board->jumps[i][1];
+    if (from < 1 || from >= board->num_of_cells || to < 1
+        || to > board->num_of_cells || from == to
+        || (i > 0 && board->jumps[i - 1][0] == from))
+    {
+      return 1;
+    }
+  }
+  for (int i = 0; i < board->num_of_jumps; i++)
+  {
+    if (board_land (board, board->jumps[i][0]) < 0)
+    {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+Board *create_board (int num_of_cells, const int jumps[][2],
+                     int num_of_jumps)
+{
+  if (num_of_cells < 1 || num_of_jumps < 0)
+  {
+    return NULL;
+  }
+  Board *board = malloc (sizeof (Board));
+  if (board == NULL)
+  {
+    return NULL;
+  }
+  *board = (Board) {num_of_cells, num_of_jumps,
+                    malloc (sizeof (*board->jumps) * (num_of_jumps + 1))};
+  if (board->jumps == NULL)
+  {
+    free_board (&board);
+    return NULL;
+  }
+  for (int i = 0; i < num_of_jumps; i++)
+  {
+    board->jumps[i][0] = jumps[i][0];
+    board->jumps[i][1] = jumps[i][1];
+  }
+  qsort (board->jumps, num_of_jumps, sizeof (*board->jumps), comp_jumps);
+  if (check_jumps (board) != 0 || check_reachable (board) != 0)
+  {
+    free_board (&board);
+  }
+  return board;
+}
+
+Board *load_board (const char *path)
+{
+  FILE *file = fopen (path, "r");
+  if (file == NULL)
+  {
+    return NULL;
+  }
+  int num_of_cells = 0, num_of_jumps = 0, capacity = INITIAL_CAPACITY;
+  int (*jumps)[2] = malloc (sizeof (*jumps) * capacity);
+  int status = jumps == NULL || fscanf (file, "%d", &num_of_cells) != 1;
+  int from, to, read = EOF;
+  while (status == 0 && (read = fscanf (file, "%d %d", &from, &to)) == 2)
+  {
+    if (num_of_jumps == capacity)
+    {
+      capacity *= GROWTH_FACTOR;
+      int (*grown)[2] = realloc (jumps, sizeof (*jumps) * capacity);
+      if (grown == NULL)
+      {
+        status = 1;
+        break;
+      }
+      jumps = grown;
+    }
+    jumps[num_of_jumps][0] = from;
+    jumps[num_of_jumps++][1] = to;
+  }
+  // all of the file is jumps, up to it's end
+  status = status != 0 || read != EOF;
+  fclose (file);
+  Board *board = status == 0 ? create_board (num_of_cells, jumps,
+                                             num_of_jumps)
+                             : NULL;
+  free (jumps);
+  return board;
+}
+
+int board_jump (const Board *board, int cell)
+{
+  int ind = find_jump (board, cell);
+  return ind >= 0 ? board->jumps[ind][1] : NO_JUMP_TO;
+}
+
+int board_jump_num (const Board *board, int cell)
+{
+  return find_jump (board, cell) + 1; // NO_JUMP_TO if there is none
+}
+
+int board_faces (const Board *board, int cell)
+{
+  int ahead = board->num_of_cells - cell;
+  return ahead < BOARD_DIE_FACES ? ahead : BOARD_DIE_FACES;
+}
+
+AbsorbingChain *board_absorbing_chain (const Board *board)
+{
+  int n = board->num_of_cells;
+  AbsorbingChain *chain = calloc (1, sizeof (AbsorbingChain));
+  if (chain == NULL
+      || (chain->absorbing = malloc (sizeof (bool) * n)) == NULL
+      || (chain->free = malloc (sizeof (bool) * n)) == NULL
+      || (chain->row_offsets = malloc (sizeof (int) * (n + 1))) == NULL)
+  {
+    free_absorbing_chain (&chain);
+    return NULL;
+  }
+  chain->num_of_states = n;
+  size_t num_of_entries = 0;
+  for (int cell = 1; cell <= n; cell++)
+  {
+    int id = cell - 1;
+    chain->absorbing[id] = cell == n;
+    chain->free[id] = board_jump (board, cell) != NO_JUMP_TO;
+    chain->row_offsets[id] = (int) num_of_entries;
+    num_of_entries += chain->absorbing[id] ? 0
+                      : chain->free[id] ? 1 : board_faces (board, cell);
+  }
+  chain->row_offsets[n] = (int) num_of_entries;
+  chain->columns = malloc (sizeof (int) * (num_of_entries + 1));
+  chain->probabilities = malloc (sizeof (double) * (num_of_entries + 1));
+  if (chain->columns == NULL || chain->probabilities == NULL)
+  {
+    free_absorbing_chain (&chain);
+    return NULL;
+  }
+  for (int cell = 1; cell < n; cell++)
+  {
+    int e = chain->row_offsets[cell - 1];
+    if (chain->free[cell - 1])
+    {
+      chain->columns[e] = board_land (board, cell) - 1;
+      chain->probabilities[e] = 1;
+      continue;
+    }
+    int faces = board_faces (board, cell);
+    for (int face = 1; face <= faces; face++, e++)
+    {
+      chain->columns[e] = board_land (board, cell + face) - 1;
+      chain->probabilities[e] = 1.0 / faces;
+    }
+  }
+  return chain;
+}
+
+void free_board (Board **board)
+{
+  if (*board == NULL)
+  {
+    return;
+  }
+  free ((*board)->jumps);
+  free (*board);
+  *board = NULL;
+}
@@ -0,0 +1,81 @@
+#ifndef BOARD_H
+#define BOARD_H
+#include "absorbing_chain.h"
+
+#define BOARD_DIE_FACES 6
+#define NO_JUMP_TO 0
+
+/**
+ * A snakes and ladders board of any size, in memory of it's jumps only.
+ * Cells are numbered 1 to num_of_cells, the last one ends the game. The
+ * dice transitions are implicit: from a cell the die lands on one of the
+ * board_faces cells ahead, uniformly. The snakes and ladders are kept
+ * sorted by the cell they jump from, and found by binary search.
+ */
+typedef struct Board {
+    int num_of_cells;
+    int num_of_jumps;
+    int (*jumps)[2]; // (from, to) of each snake or ladder, sorted by from
+} Board;
+
+/**
+ * Creates a board.
+ * @param num_of_cells num of cells, the last one ends the game
+ * @param jumps (from, to) cells of each snake or ladder, in any order
+ * @return pointer to the new Board: upon success, NULL: in case of
+ * allocation error, a jump off the board, from the last cell or from a
+ * cell another jump is from, jumps that lead to each other in a cycle, or
+ * a cell the last one can't be reached from.
+ */
+Board *create_board (int num_of_cells, const int jumps[][2],
+                     int num_of_jumps);
+
+/**
+ * Loads a board from a text file: it's num of cells, then the from and to
+ * cells of each snake or ladder, all separated by whitespace.
+ * @return pointer to the new Board: upon success, NULL: if the file can't
+ * be read, isn't a valid board, or in case of allocation error.
+ */
+Board *load_board (const char *path);
+
+/**
+ * Gets the cell a snake or a ladder from the given cell leads to.
+ * @return the cell, NO_JUMP_TO if there is no snake nor ladder from it
+ */
+int board_jump (const Board *board, int cell);
+
+/**
+ * Gets the num of the snake or ladder from the given cell, by it's
+ * position in the board's jumps, from 1.
+ * @return the num, NO_JUMP_TO if there is no snake nor ladder from it
+ */
+int board_jump_num (const Board *board, int cell);
+
+/**
+ * Follows the jumps from a cell to the cell a move on it ends on.
+ * @return the cell, -1 if the jumps lead to each other in a cycle (never
+ * on a board create_board made)
+ */
+int board_land (const Board *board, int cell);
+
+/**
+ * Gets the num of cells the die may land on from a cell: the faces that
+ * stay on the board. A roll past the last cell is rolled again.
+ */
+int board_faces (const Board *board, int cell);
+
+/**
+ * Builds the transition matrix of the board's game, state i being cell
+ * i + 1 and it's snakes and ladders free states, the way
+ * build_absorbing_chain builds the chain of the board's cells.
+ * @return pointer to the new AbsorbingChain: upon success, NULL: in case
+ * of allocation error.
+ */
+AbsorbingChain *board_absorbing_chain (const Board *board);
+
+/**
+ * Frees the board and sets the pointer to NULL.
+ */
+void free_board (Board **board);
+
+#endif //BOARD_H
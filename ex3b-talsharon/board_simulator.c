@@ -0,0 +1,376 @@
+#include "board_simulator.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+
+/**
+ * A thread of the pool: takes chunks of games until all are taken, and
+ * counts them in counts.
+ */
+typedef struct SimWorker {
+    const FlatBoard *board;
+    int start_cell;
+    long num_of_games;
+    uint64_t seed;
+    atomic_long *next_chunk;
+    SimResult counts;
+    bool success;
+} SimWorker;
+
+/**
+ * Fills the row of a cell.
+ */
+static void fill_row (FlatBoard *flat, const Board *board, int cell)
+{
+  int last = board->num_of_cells;
+  if (cell == last)
+  {
+    flat->faces[cell] = 0;
+    for (int die = 0; die < BOARD_DIE_FACES; die++)
+    {
+      flat->next[cell][die] = last;
+      flat->via[cell][die] = NO_JUMP_TO;
+    }
+    return;
+  }
+  flat->faces[cell] = board_jump (board, cell) != NO_JUMP_TO ? 0
+                      : (uint32_t) board_faces (board, cell);
+  for (int die = 0; die < BOARD_DIE_FACES; die++)
+  {
+    // a jump cell leads from itself, faces past the last one are never
+    // drawn: keep them on the board
+    int face = (uint32_t) die < flat->faces[cell] ? die + 1
+               : (int) flat->faces[cell];
+    flat->next[cell][die] = board_land (board, cell + face);
+    flat->via[cell][die] = board_jump_num (board, cell + face);
+  }
+}
+
+FlatBoard *create_flat_board (const Board *board)
+{
+  size_t rows = (size_t) board->num_of_cells + 1; // cells are numbered
+                                                  // from 1
+  FlatBoard *flat = calloc (1, sizeof (FlatBoard));
+  if (flat == NULL
+      || (flat->next = malloc (sizeof (*flat->next) * rows)) == NULL
+      || (flat->via = malloc (sizeof (*flat->via) * rows)) == NULL
+      || (flat->faces = malloc (sizeof (uint32_t) * rows)) == NULL)
+  {
+    free_flat_board (&flat);
+    return NULL;
+  }
+  flat->num_of_cells = board->num_of_cells;
+  flat->num_of_jumps = board->num_of_jumps;
+  for (int cell = 1; cell <= board->num_of_cells; cell++)
+  {
+    fill_row (flat, board, cell);
+  }
+  return flat;
+}
+
+/**
+ * Draws the die of a lane again, the multiply-shift of the walks having
+ * landed in it's biased part: see rng_below.
+ * @return the die
+ */
+static int redraw_die (uint64_t state[][SIM_LANES], int lane, uint32_t faces)
+{
+  Rng rng = {RNG_XOSHIRO, {state[0][lane], state[1][lane], state[2][lane],
+                           state[3][lane]}};
+  int die = rng_below (&rng, (int) faces);
+  for (int word = 0; word < RNG_STATE_WORDS; word++)
+  {
+    state[word][lane] = rng.state[word];
+  }
+  return die;
+}
+
+/**
+ * Doubles the width of the bins of the games' lengths, merging each pair.
+ */
+static void widen_bins (SimResult *counts)
+{
+  for (int bin = 0; bin < SIM_BINS / 2; bin++)
+  {
+    counts->lengths[bin] = counts->lengths[2 * bin]
+                           + counts->lengths[2 * bin + 1];
+  }
+  for (int bin = SIM_BINS / 2; bin < SIM_BINS; bin++)
+  {
+    counts->lengths[bin] = 0;
+  }
+  counts->bin_width *= 2;
+}
+
+/**
+ * Counts a game that ended after the given num of moves, widening the bins
+ * until it fits.
+ */
+static void count_length (SimResult *counts, int moves)
+{
+  while (moves / counts->bin_width >= SIM_BINS)
+  {
+    widen_bins (counts);
+  }
+  counts->lengths[moves / counts->bin_width]++;
+}
+
+/**
+ * Plays a chunk of games on SIM_LANES walks: each walk plays a game, and
+ * a new one as long as the chunk has games not started.
+ * Each move is drawn for all walks at once, over arrays of the lanes' rng
+ * words and cells so the compiler can advance the lanes in SIMD
+ * registers; a walk done with it's games stays on the last cell.
+ */
+static void play_chunk (const FlatBoard *board, int start_cell,
+                        long num_of_games, uint64_t seed, long chunk,
+                        SimResult *counts)
+{
+  uint64_t state[RNG_STATE_WORDS][SIM_LANES];
+  int cell[SIM_LANES], moves[SIM_LANES] = {0};
+  bool active[SIM_LANES];
+  int last = board->num_of_cells, num_of_active = 0;
+  long started = 0;
+  for (int lane = 0; lane < SIM_LANES; lane++)
+  {
+    Rng rng = rng_stream (seed, (uint64_t) chunk * SIM_LANES + lane);
+    for (int word = 0; word < RNG_STATE_WORDS; word++)
+    {
+      state[word][lane] = rng.state[word];
+    }
+    active[lane] = started < num_of_games;
+    started += active[lane];
+    num_of_active += active[lane];
+    cell[lane] = active[lane] ? start_cell : last;
+  }
+  while (num_of_active > 0)
+  {
+    int from[SIM_LANES], via[SIM_LANES];
+    uint32_t low[SIM_LANES];
+    for (int lane = 0; lane < SIM_LANES; lane++)
+    {
+      // rng_next of each lane
+      uint64_t result = rng_rotate (state[1][lane] * 5, 7) * 9;
+      uint64_t shifted = state[1][lane] << 17;
+      state[2][lane] ^= state[0][lane];
+      state[3][lane] ^= state[1][lane];
+      state[1][lane] ^= state[2][lane];
+      state[0][lane] ^= state[3][lane];
+      state[2][lane] ^= shifted;
+      state[3][lane] = rng_rotate (state[3][lane], 45);
+      uint64_t product = (result >> RNG_BITS_PER_DRAW)
+                         * board->faces[cell[lane]];
+      int die = (int) (product >> RNG_BITS_PER_DRAW);
+      low[lane] = (uint32_t) product;
+      from[lane] = cell[lane];
+      cell[lane] = board->next[from[lane]][die];
+      via[lane] = board->via[from[lane]][die];
+    }
+    for (int lane = 0; lane < SIM_LANES; lane++)
+    {
+      if (!active[lane])
+      {
+        continue;
+      }
+      uint32_t faces = board->faces[from[lane]];
+      if (low[lane] < faces && low[lane] < -faces % faces) // biased
+      {
+        int die = redraw_die (state, lane, faces);
+        cell[lane] = board->next[from[lane]][die];
+        via[lane] = board->via[from[lane]][die];
+      }
+      counts->hits[via[lane]]++;
+      if (++moves[lane] < SIM_CUT_MOVES && cell[lane] != last)
+      {
+        continue;
+      }
+      if (cell[lane] == last)
+      {
+        count_length (counts, moves[lane]);
+      }
+      else
+      {
+        counts->cut++;
+      }
+      counts->moves += moves[lane];
+      counts->games++;
+      moves[lane] = 0;
+      if (started < num_of_games)
+      {
+        started++;
+        cell[lane] = start_cell;
+      }
+      else
+      {
+        active[lane] = false;
+        num_of_active--;
+        cell[lane] = last;
+      }
+    }
+  }
+}
+
+static bool alloc_counts (SimResult *counts, int num_of_jumps)
+{
+  *counts = (SimResult) {0, 0, calloc (SIM_BINS, sizeof (long)), 1, 0,
+                         calloc ((size_t) num_of_jumps + 1, sizeof (long)),
+                         num_of_jumps};
+  if (counts->lengths == NULL || counts->hits == NULL)
+  {
+    free_sim_result (counts);
+    return false;
+  }
+  return true;
+}
+
+/**
+ * The thread routine of simulate_games.
+ * @param arg pointer to SimWorker
+ */
+static void *run_worker (void *arg)
+{
+  SimWorker *worker = (SimWorker*) arg;
+  worker->success = alloc_counts (&worker->counts,
+                                  worker->board->num_of_jumps);
+  while (worker->success)
+  {
+    long chunk = atomic_fetch_add (worker->next_chunk, 1);
+    long first = chunk * SIM_GAMES_PER_CHUNK;
+    if (first >= worker->num_of_games)
+    {
+      break;
+    }
+    long games = worker->num_of_games - first < SIM_GAMES_PER_CHUNK
+                 ? worker->num_of_games - first : SIM_GAMES_PER_CHUNK;
+    play_chunk (worker->board, worker->start_cell, games, worker->seed, chunk,
+                &worker->counts);
+  }
+  return NULL;
+}
+
+static int get_num_of_cpus (void)
+{
+  long num_of_cpus = sysconf (_SC_NPROCESSORS_ONLN);
+  if (num_of_cpus < 1)
+  {
+    return 1;
+  }
+  return num_of_cpus < MAX_SIM_THREADS ? (int) num_of_cpus : MAX_SIM_THREADS;
+}
+
+/**
+ * Adds the counts of src to dst, in bins as wide as the wider of them: the
+ * bins of src may be widened.
+ */
+static void add_counts (SimResult *dst, SimResult *src)
+{
+  dst->games += src->games;
+  dst->moves += src->moves;
+  dst->cut += src->cut;
+  while (dst->bin_width < src->bin_width)
+  {
+    widen_bins (dst);
+  }
+  while (src->bin_width < dst->bin_width)
+  {
+    widen_bins (src);
+  }
+  for (int i = 0; i < SIM_BINS; i++)
+  {
+    dst->lengths[i] += src->lengths[i];
+  }
+  for (int i = 0; i <= dst->num_of_jumps; i++)
+  {
+    dst->hits[i] += src->hits[i];
+  }
+}
+
+bool simulate_games (const FlatBoard *board, int start_cell,
+                     long num_of_games, uint64_t seed, int num_of_threads,
+                     SimResult *result)
+{
+  if (!alloc_counts (result, board->num_of_jumps))
+  {
+    return false;
+  }
+  // a game from a jump cell starts where it leads, in no move
+  if (start_cell != board->num_of_cells && board->faces[start_cell] == 0)
+  {
+    start_cell = board->next[start_cell][0];
+  }
+  if (start_cell == board->num_of_cells)
+  {
+    result->games = num_of_games;
+    result->lengths[0] = num_of_games;
+    return true;
+  }
+  long num_of_chunks = (num_of_games + SIM_GAMES_PER_CHUNK - 1)
+                       / SIM_GAMES_PER_CHUNK;
+  if (num_of_threads <= 0 || num_of_threads > MAX_SIM_THREADS)
+  {
+    num_of_threads = get_num_of_cpus ();
+  }
+  if (num_of_threads > num_of_chunks)
+  {
+    num_of_threads = num_of_chunks > 0 ? (int) num_of_chunks : 1;
+  }
+  atomic_long next_chunk;
+  atomic_init (&next_chunk, 0);
+  SimWorker workers[MAX_SIM_THREADS];
+  pthread_t threads[MAX_SIM_THREADS];
+  bool started[MAX_SIM_THREADS] = {false};
+  for (int i = 0; i < num_of_threads; i++)
+  {
+    workers[i] = (SimWorker) {board, start_cell, num_of_games, seed,
+                              &next_chunk, {0}, false};
+  }
+  for (int i = 1; i < num_of_threads; i++)
+  {
+    started[i] = pthread_create (&threads[i], NULL, run_worker,
+                                 &workers[i]) == 0;
+  }
+  run_worker (&workers[0]); // threads that didn't start leave it more chunks
+  bool success = true;
+  for (int i = 0; i < num_of_threads; i++)
+  {
+    if (i > 0 && started[i])
+    {
+      pthread_join (threads[i], NULL);
+    }
+    if (i == 0 || started[i])
+    {
+      success = success && workers[i].success;
+      if (workers[i].success)
+      {
+        add_counts (result, &workers[i].counts);
+      }
+      free_sim_result (&workers[i].counts);
+    }
+  }
+  if (!success)
+  {
+    free_sim_result (result);
+  }
+  return success;
+}
+
+void free_sim_result (SimResult *result)
+{
+  free (result->lengths);
+  free (result->hits);
+  result->lengths = NULL;
+  result->hits = NULL;
+}
+
+void free_flat_board (FlatBoard **board)
+{
+  if (*board == NULL)
+  {
+    return;
+  }
+  free ((*board)->next);
+  free ((*board)->via);
+  free ((*board)->faces);
+  free (*board);
+  *board = NULL;
+}
@@ -0,0 +1,80 @@
+#ifndef BOARD_SIMULATOR_H
+#define BOARD_SIMULATOR_H
+#include "board.h"
+#include "rng.h"
+#include <stdbool.h>
+
+#define SIM_LANES 8 // walks advanced together by each thread
+#define SIM_GAMES_PER_CHUNK 4096 // games a thread takes from the pool at once
+#define SIM_BINS 1024 // of the games' lengths, as wide as the longest needs
+#define SIM_CUT_MOVES 100000000 // longer games are cut, on a board that may
+                                // never end
+#define MAX_SIM_THREADS 64
+
+/**
+ * A Board as a flat transition table, for simulating millions of walks
+ * without looking the jumps up.
+ * Cells are numbered 1 to num_of_cells, the last one ends the game. From a
+ * cell the die lands on one of faces[cell] cells ahead, uniformly (a roll
+ * past the last cell is rolled again, see board_faces); snakes and ladders
+ * are taken in the same move. A jump cell and the last cell have no
+ * faces: their first entry is the cell they lead to.
+ */
+typedef struct FlatBoard {
+    int num_of_cells;
+    int num_of_jumps;
+    // next[cell][die]: the cell a walk ends it's move on, any jumps taken
+    int (*next)[BOARD_DIE_FACES];
+    // via[cell][die]: num of the jump that move took (see board_jump_num),
+    // NO_JUMP_TO if none
+    int (*via)[BOARD_DIE_FACES];
+    uint32_t *faces;
+} FlatBoard;
+
+/**
+ * Counts of a simulation.
+ */
+typedef struct SimResult {
+    long games;
+    long moves;
+    // games that ended in each bin of moves: SIM_BINS bins of bin_width
+    // moves from 0, bin_width a power of 2 that doubles as games outgrow it
+    long *lengths;
+    int bin_width;
+    long cut; // games cut at SIM_CUT_MOVES, not in lengths
+    long *hits; // times each jump was taken, by it's num
+    int num_of_jumps;
+} SimResult;
+
+/**
+ * Creates the flat table of a board, which create_board has checked.
+ * @return pointer to the new FlatBoard: upon success, NULL: in case of
+ * allocation error.
+ */
+FlatBoard *create_flat_board (const Board *board);
+
+/**
+ * Plays num_of_games games from start_cell by a pool of threads.
+ * Games are played in chunks of SIM_GAMES_PER_CHUNK, each on SIM_LANES
+ * walks with random streams of their own (rng_stream of the chunk's
+ * lanes): the counts depend on the seed only, not on the num of threads.
+ * @param num_of_threads num of threads to play by, 0 for one per CPU
+ * @param result set to the counts, free it with free_sim_result
+ * @return success/failure: true if the process was successful, false if
+ * in case of allocation error.
+ */
+bool simulate_games (const FlatBoard *board, int start_cell,
+                     long num_of_games, uint64_t seed, int num_of_threads,
+                     SimResult *result);
+
+/**
+ * Frees the counts of a simulation.
+ */
+void free_sim_result (SimResult *result);
+
+/**
+ * Frees the board and sets the pointer to NULL.
+ */
+void free_flat_board (FlatBoard **board);
+
+#endif //BOARD_SIMULATOR_H
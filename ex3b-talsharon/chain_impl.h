@@ -0,0 +1,207 @@
+/**
+ * The paths of a MarkovChain that call it's functions on every state:
+ * finding and adding states, counting transitions and generating.
+ * markov_chain.c includes this file once per kind of state, with these
+ * macros defined, and it generates static functions named by CHAIN_FN:
+ *   CHAIN_FN(name)          the name of a generated function
+ *   CHAIN_KEY               the type of a state's data
+ *   CHAIN_HASH(chain, d)    the hash of d, the one chain's hash_func gives
+ *   CHAIN_EQUAL(chain, a, b) true if a and b are the same state
+ *   CHAIN_IS_LAST(chain, d) true if d is a last state
+ * The generic instance calls the chain's functions through it's pointers,
+ * a specialized one inlines them. Both come from this one implementation
+ * so they can't drift apart. The macros are undefined at the end, ready
+ * for the next instance.
+ */
+
+/**
+ * Finds a state in the chain's hash index.
+ * @param hash CHAIN_HASH of data
+ * @return Pointer to the Node wrapping the state, NULL if not in the index.
+ */
+static Node *CHAIN_FN (find_indexed) (const MarkovChain *markov_chain,
+                                     size_t hash, CHAIN_KEY data)
+{
+  const HashIndex *index = markov_chain->index;
+  size_t mask = index->capacity - 1;
+  for (size_t slot = hash & mask; index->nodes[slot] != NULL;
+       slot = (slot + 1) & mask)
+  {
+    if (index->hashes[slot] == hash
+        && CHAIN_EQUAL (markov_chain,
+                        (CHAIN_KEY) index->nodes[slot]->data->data, data))
+    {
+      return index->nodes[slot];
+    }
+  }
+  return NULL;
+}
+
+/**
+ * get_node_from_database for the instance's states.
+ */
+static Node *CHAIN_FN (find_state) (MarkovChain *markov_chain, CHAIN_KEY data)
+{
+  if (markov_chain->hash_func != NULL && build_index (markov_chain))
+  {
+    return CHAIN_FN (find_indexed) (markov_chain,
+                                    CHAIN_HASH (markov_chain, data), data);
+  }
+  Node *node_ptr = markov_chain->database->first;
+  while (node_ptr != NULL) //go through all markov chain and look for data
+  {
+    if (CHAIN_EQUAL (markov_chain, (CHAIN_KEY) node_ptr->data->data, data))
+    {
+      return node_ptr;
+    }
+    node_ptr = node_ptr->next;
+  }
+  return node_ptr; //node_ptr should be NULL
+}
+
+/**
+ * Finds a state in the database, or adds it, and adds occurrences to it.
+ * @return Pointer to the Node wrapping the state, NULL in case of
+ * allocation error.
+ */
+static Node *CHAIN_FN (find_or_add) (MarkovChain *markov_chain,
+                                     CHAIN_KEY data, int occurrences)
+{
+  size_t hash = 0;
+  Node *node_ptr = NULL;
+  bool indexed = markov_chain->hash_func != NULL;
+  if (indexed)
+  {
+    if (!build_index (markov_chain))
+    {
+      return NULL;
+    }
+    hash = CHAIN_HASH (markov_chain, data);
+    node_ptr = CHAIN_FN (find_indexed) (markov_chain, hash, data);
+  }
+  else
+  {
+    node_ptr = CHAIN_FN (find_state) (markov_chain, data);
+  }
+  markov_chain->version++;
+  if (node_ptr != NULL)
+  {
+    node_ptr->data->occurrences = saturating_add (node_ptr->data->occurrences,
+                                                  occurrences);
+    if (node_ptr->data->counter_list_size > 0) // a start node
+    {
+      markov_chain->start_occurrences += occurrences;
+    }
+    return node_ptr;
+  }
+  if (markov_chain->arena == NULL
+      && (markov_chain->arena = create_arena ()) == NULL)
+  {
+    return NULL;
+  }
+  Node *new_node = arena_alloc (markov_chain->arena, sizeof (Node));
+  MarkovNode *markov_node = arena_alloc (markov_chain->arena,
+                                         sizeof (MarkovNode));
+  if (new_node == NULL || markov_node == NULL)
+  {
+    return NULL;
+  }
+  // copied once the rest is allocated, so a copy_func copy isn't lost
+  void *data_copy = markov_chain->copy_func != NULL
+                    ? markov_chain->copy_func (data)
+                    : arena_copy (markov_chain->arena, data,
+                                  markov_chain->size_func (data));
+  if (data_copy == NULL)
+  {
+    return NULL;
+  }
+  *markov_node = (MarkovNode) {data_copy, NULL, 0, 0, 0, NULL, 0, NULL,
+                               occurrences, markov_chain->database->size};
+  *new_node = (Node) {markov_node, NULL};
+  // indexed before it's appended, so a failure leaves the database and
+  // the index alike, and a retry adds it again
+  if (indexed && hash_index_insert (markov_chain->index, hash, new_node) != 0)
+  {
+    if (markov_chain->copy_func != NULL && markov_chain->free_data != NULL)
+    {
+      markov_chain->free_data (data_copy);
+    }
+    return NULL;
+  }
+  // it becomes a start node with it's first counter, see add_to_counter
+  append_node (markov_chain->database, new_node);
+  return new_node;
+}
+
+/**
+ * add_node_to_counter_list for the instance's states.
+ */
+static bool CHAIN_FN (add_transition) (MarkovNode *first_node,
+                                       MarkovNode *second_node,
+                                       MarkovChain *markov_chain)
+{
+  bool is_last = CHAIN_IS_LAST (markov_chain, (CHAIN_KEY) first_node->data);
+  if (markov_chain->approximate != NULL && !is_last)
+  {
+    return add_approximate_counter (markov_chain, first_node, second_node);
+  }
+  if (!is_last && !add_to_counter (markov_chain, first_node, second_node, 1))
+  {
+    return false;
+  }
+  first_node->counter_list_full_size++;
+  markov_chain->version++;
+  return true;
+}
+
+/**
+ * generate_sequence_into for the instance's states.
+ */
+static bool CHAIN_FN (generate_into) (MarkovChain *markov_chain,
+                                      MarkovNode *first_node, int max_length,
+                                      Rng *rng, CHAIN_KEY *out, int *out_len)
+{
+  rng = rng != NULL ? rng : &markov_chain->rng;
+  *out_len = 0;
+  if (is_compiled_current (markov_chain))
+  {
+    const CompiledChain *compiled = markov_chain->compiled;
+    const uint32_t *ids = compiled->ids;
+    long id = first_node == NULL ? first_compiled_node (markov_chain, rng)
+              : ids != NULL ? ids[first_node->id] : (uint32_t) first_node->id;
+    while (id != EMPTY_SLOT && *out_len < max_length)
+    {
+      CHAIN_KEY data = (CHAIN_KEY) compiled_node_data (compiled,
+                                                       (uint32_t) id);
+      out[(*out_len)++] = data;
+      if ((*out_len > 1 && CHAIN_IS_LAST (markov_chain, data))
+          || *out_len == max_length) // no draw past the end
+      {
+        break;
+      }
+      id = next_compiled_node (compiled, (uint32_t) id, rng);
+    }
+    return *out_len > 0;
+  }
+  MarkovNode *cur_node = first_node != NULL ? first_node
+                         : first_random_node (markov_chain, rng);
+  while (cur_node != NULL && *out_len < max_length)
+  {
+    out[(*out_len)++] = (CHAIN_KEY) cur_node->data;
+    if ((*out_len > 1
+         && CHAIN_IS_LAST (markov_chain, (CHAIN_KEY) cur_node->data))
+        || cur_node->counter_list_size == 0 // a dead end of the corpus
+        || *out_len == max_length)
+    {
+      break;
+    }
+    cur_node = next_node (markov_chain, cur_node, rng);
+  }
+  return *out_len > 0;
+}
+
+#undef CHAIN_FN
+#undef CHAIN_KEY
+#undef CHAIN_HASH
+#undef CHAIN_EQUAL
+#undef CHAIN_IS_LAST
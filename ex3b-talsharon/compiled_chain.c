@@ -0,0 +1,526 @@
+#include "compiled_chain.h"
+#include "markov_chain.h"
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define SECTION_ALIGNMENT 8
+#define TEMP_SUFFIX ".tmp"
+
+_Static_assert (sizeof (int) == sizeof (int32_t),
+                "alias tables are copied into int32 sections");
+_Static_assert (sizeof (CompiledChainHeader) % SECTION_ALIGNMENT == 0,
+                "sections following the header must stay aligned");
+
+/**
+ * Byte offsets of the sections of an image, see CompiledChainHeader.
+ */
+typedef struct ChainLayout {
+    size_t data_offsets;
+    size_t successor_offsets;
+    size_t successors;
+    size_t cumulative;
+    size_t alias_threshold;
+    size_t alias;
+    size_t start_nodes;
+    size_t start_threshold;
+    size_t start_alias;
+    size_t data;
+    size_t size; // size of the whole image
+} ChainLayout;
+
+static size_t align_up (size_t size)
+{
+  return (size + SECTION_ALIGNMENT - 1) & ~(size_t) (SECTION_ALIGNMENT - 1);
+}
+
+/**
+ * Lays the sections of an image with the given header's counts out.
+ */
+static void get_layout (const CompiledChainHeader *header,
+                        ChainLayout *layout)
+{
+  size_t num_of_successors = header->num_of_successors;
+  size_t num_of_start_nodes = header->num_of_start_nodes;
+  size_t alias_size = (header->flags & COMPILED_CHAIN_HAS_ALIAS)
+                      ? align_up (sizeof (int32_t) * num_of_successors) : 0;
+  layout->data_offsets = sizeof (CompiledChainHeader);
+  layout->successor_offsets = layout->data_offsets
+      + sizeof (uint64_t) * header->num_of_nodes;
+  layout->successors = layout->successor_offsets
+      + sizeof (uint64_t) * ((size_t) header->num_of_nodes + 1);
+  layout->cumulative = layout->successors
+      + align_up (sizeof (uint32_t) * num_of_successors);
+  layout->alias_threshold = layout->cumulative
+      + align_up (sizeof (int32_t) * num_of_successors);
+  layout->alias = layout->alias_threshold + alias_size;
+  layout->start_nodes = layout->alias + alias_size;
+  layout->start_threshold = layout->start_nodes
+      + align_up (sizeof (uint32_t) * num_of_start_nodes);
+  layout->start_alias = layout->start_threshold
+      + align_up (sizeof (int32_t) * num_of_start_nodes);
+  layout->data = layout->start_alias
+      + align_up (sizeof (int32_t) * num_of_start_nodes);
+  layout->size = layout->data + header->data_size;
+}
+
+/**
+ * Points the views of compiled to the sections of it's image.
+ */
+static void set_views (CompiledChain *compiled)
+{
+  const char *base = compiled->image;
+  ChainLayout layout;
+  compiled->header = compiled->image;
+  get_layout (compiled->header, &layout);
+  bool has_alias = compiled->header->flags & COMPILED_CHAIN_HAS_ALIAS;
+  compiled->data_offsets = (const uint64_t *) (base + layout.data_offsets);
+  compiled->successor_offsets = (const uint64_t *) (base
+      + layout.successor_offsets);
+  compiled->successors = (const uint32_t *) (base + layout.successors);
+  compiled->cumulative = (const int32_t *) (base + layout.cumulative);
+  compiled->alias_threshold = has_alias
+      ? (const int32_t *) (base + layout.alias_threshold) : NULL;
+  compiled->alias = has_alias ? (const int32_t *) (base + layout.alias)
+                              : NULL;
+  compiled->start_nodes = (const uint32_t *) (base + layout.start_nodes);
+  compiled->start_threshold = (const int32_t *) (base
+      + layout.start_threshold);
+  compiled->start_alias = (const int32_t *) (base + layout.start_alias);
+  compiled->data = base + layout.data;
+}
+
+/**
+ * Builds an alias table over the given weights into threshold and alias.
+ * @return 0 on success, 1 in case of allocation error
+ */
+static int write_alias_table (const int *weights, int size,
+                              int32_t *threshold, int32_t *alias)
+{
+  AliasTable *table = create_alias_table (weights, size);
+  if (table == NULL)
+  {
+    return 1;
+  }
+  memcpy (threshold, table->threshold, sizeof (int32_t) * size);
+  memcpy (alias, table->alias, sizeof (int32_t) * size);
+  free_alias_table (&table);
+  return 0;
+}
+
+/**
+ * Gets the id in the image of a state by it's id in the database.
+ */
+static uint32_t image_id (const uint32_t *ids, int id)
+{
+  return ids != NULL ? ids[id] : (uint32_t) id;
+}
+
+/**
+ * Orders states by occurrences, most frequent first, then by database
+ * order.
+ */
+static int comp_occurrences (const void *first, const void *second)
+{
+  const MarkovNode *first_node = *(MarkovNode *const *) first;
+  const MarkovNode *second_node = *(MarkovNode *const *) second;
+  if (first_node->occurrences != second_node->occurrences)
+  {
+    return first_node->occurrences > second_node->occurrences ? -1 : 1;
+  }
+  return (first_node->id > second_node->id)
+         - (first_node->id < second_node->id);
+}
+
+/**
+ * Writes the successors of every state (and their alias tables if the
+ * header says so), and the data of every state if the image holds copies.
+ * @param nodes the states in image order
+ * @param ids image id of each state by database id, NULL if the same
+ * @param weights buffer for the frequencies of the longest counter list
+ * @return 0 on success, 1 in case of allocation error
+ */
+static int write_nodes (const MarkovChain *markov_chain,
+                        MarkovNode *const *nodes, const uint32_t *ids,
+                        char *image, const ChainLayout *layout, int *weights)
+{
+  const CompiledChainHeader *header = (const CompiledChainHeader *) image;
+  uint64_t *data_offsets = (uint64_t *) (image + layout->data_offsets);
+  uint64_t *successor_offsets = (uint64_t *) (image
+      + layout->successor_offsets);
+  uint32_t *successors = (uint32_t *) (image + layout->successors);
+  int32_t *cumulative = (int32_t *) (image + layout->cumulative);
+  uint64_t data_offset = 0, successor_offset = 0;
+  for (uint32_t id = 0; id < header->num_of_nodes; id++)
+  {
+    const MarkovNode *markov_node = nodes[id];
+    if (header->data_size > 0)
+    {
+      size_t size = markov_chain->size_func (markov_node->data);
+      memcpy (image + layout->data + data_offset, markov_node->data, size);
+      data_offsets[id] = data_offset;
+      data_offset += align_up (size);
+    }
+    successor_offsets[id] = successor_offset;
+    int32_t sum = 0;
+    for (int i = 0; i < markov_node->counter_list_size; i++)
+    {
+      const NextNodeCounter *counter = &markov_node->counter_list[i];
+      successors[successor_offset + i] = image_id (ids,
+                                                   counter->markov_node->id);
+      sum += counter->frequency;
+      cumulative[successor_offset + i] = sum;
+      weights[i] = counter->frequency;
+    }
+    if ((header->flags & COMPILED_CHAIN_HAS_ALIAS)
+        && markov_node->counter_list_size > 0
+        && write_alias_table (weights, markov_node->counter_list_size,
+                              (int32_t *) (image + layout->alias_threshold)
+                              + successor_offset,
+                              (int32_t *) (image + layout->alias)
+                              + successor_offset) != 0)
+    {
+      return 1;
+    }
+    successor_offset += markov_node->counter_list_size;
+  }
+  successor_offsets[header->num_of_nodes] = successor_offset;
+  return 0;
+}
+
+/**
+ * Writes the start nodes and their alias table into the image.
+ * @param ids image id of each state by database id, NULL if the same
+ * @param weights buffer for the occurrences of the start nodes
+ * @return 0 on success, 1 in case of allocation error
+ */
+static int write_start_nodes (const MarkovChain *markov_chain,
+                              const uint32_t *ids, char *image,
+                              const ChainLayout *layout, int *weights)
+{
+  uint32_t *start_nodes = (uint32_t *) (image + layout->start_nodes);
+  for (int i = 0; i < markov_chain->start_nodes_size; i++)
+  {
+    start_nodes[i] = image_id (ids, markov_chain->start_nodes[i]->id);
+    weights[i] = markov_chain->start_nodes[i]->occurrences;
+  }
+  if (markov_chain->start_nodes_size == 0)
+  {
+    return 0;
+  }
+  return write_alias_table (weights, markov_chain->start_nodes_size,
+                            (int32_t *) (image + layout->start_threshold),
+                            (int32_t *) (image + layout->start_alias));
+}
+
+/**
+ * Lists the states of the chain in image order, and gives the image id of
+ * each state by it's database id when the order is by occurrences.
+ * @param nodes set to the states in image order
+ * @param ids set to the image ids, or NULL if not hot_order
+ * @return 0 on success, 1 in case of allocation error
+ */
+static int order_nodes (const MarkovChain *markov_chain, bool hot_order,
+                        MarkovNode ***nodes, uint32_t **ids)
+{
+  size_t num_of_nodes = (size_t) markov_chain->database->size;
+  *nodes = malloc (sizeof (MarkovNode *) * (num_of_nodes + 1));
+  *ids = hot_order ? malloc (sizeof (uint32_t) * (num_of_nodes + 1)) : NULL;
+  if (*nodes == NULL || (hot_order && *ids == NULL))
+  {
+    free (*nodes);
+    free (*ids);
+    return 1;
+  }
+  for (Node *node_ptr = markov_chain->database->first; node_ptr != NULL;
+       node_ptr = node_ptr->next)
+  {
+    (*nodes)[node_ptr->data->id] = node_ptr->data;
+  }
+  if (hot_order)
+  {
+    qsort (*nodes, num_of_nodes, sizeof (MarkovNode *), comp_occurrences);
+    for (size_t i = 0; i < num_of_nodes; i++)
+    {
+      (*ids)[(*nodes)[i]->id] = (uint32_t) i;
+    }
+  }
+  return 0;
+}
+
+CompiledChain *compile_markov_chain (const MarkovChain *markov_chain,
+                                     bool with_alias, bool hot_order)
+{
+  CompiledChainHeader header = {
+      COMPILED_CHAIN_MAGIC, COMPILED_CHAIN_VERSION,
+      with_alias ? COMPILED_CHAIN_HAS_ALIAS : 0,
+      (uint32_t) markov_chain->database->size,
+      (uint32_t) markov_chain->start_nodes_size, 0, 0,
+      (uint64_t) markov_chain->start_occurrences, 0};
+  int max_weights = markov_chain->start_nodes_size;
+  for (Node *node_ptr = markov_chain->database->first; node_ptr != NULL;
+       node_ptr = node_ptr->next)
+  {
+    header.num_of_successors += node_ptr->data->counter_list_size;
+    if (markov_chain->size_func != NULL)
+    {
+      header.data_size += align_up (markov_chain->size_func
+                                        (node_ptr->data->data));
+    }
+    if (node_ptr->data->counter_list_size > max_weights)
+    {
+      max_weights = node_ptr->data->counter_list_size;
+    }
+  }
+  if (header.data_size > 0) // a zero block ends the data, see load
+  {
+    header.data_size += SECTION_ALIGNMENT;
+  }
+  ChainLayout layout;
+  get_layout (&header, &layout);
+  header.image_size = layout.size;
+  MarkovNode **nodes = NULL;
+  uint32_t *ids = NULL;
+  if (order_nodes (markov_chain, hot_order, &nodes, &ids) != 0)
+  {
+    return NULL;
+  }
+  CompiledChain *compiled = malloc (sizeof (CompiledChain));
+  char *image = calloc (1, layout.size); // zeroed padding, stable files
+  int *weights = malloc (sizeof (int) * (max_weights + 1));
+  void **node_data = markov_chain->size_func == NULL
+      ? malloc (sizeof (void *) * (header.num_of_nodes + 1)) : NULL;
+  if (compiled == NULL || image == NULL || weights == NULL
+      || (markov_chain->size_func == NULL && node_data == NULL))
+  {
+    free (nodes);
+    free (ids);
+    free (compiled);
+    free (image);
+    free (weights);
+    free (node_data);
+    return NULL;
+  }
+  memcpy (image, &header, sizeof (header));
+  int failed = write_nodes (markov_chain, nodes, ids, image, &layout, weights)
+               || write_start_nodes (markov_chain, ids, image, &layout,
+                                     weights);
+  for (uint32_t i = 0; node_data != NULL && i < header.num_of_nodes; i++)
+  {
+    node_data[i] = nodes[i]->data;
+  }
+  free (nodes);
+  free (weights);
+  if (failed)
+  {
+    free (ids);
+    free (compiled);
+    free (image);
+    free (node_data);
+    return NULL;
+  }
+  *compiled = (CompiledChain) {.image = image, .image_size = layout.size,
+                               .mapped = false};
+  set_views (compiled);
+  compiled->node_data = node_data;
+  compiled->ids = ids;
+  return compiled;
+}
+
+int save_compiled_chain (const CompiledChain *compiled, const char *path)
+{
+  char *temp_path = malloc (strlen (path) + sizeof (TEMP_SUFFIX));
+  if (temp_path == NULL)
+  {
+    return 1;
+  }
+  strcpy (temp_path, path);
+  strcat (temp_path, TEMP_SUFFIX);
+  FILE *fp = fopen (temp_path, "wb");
+  if (fp == NULL)
+  {
+    free (temp_path);
+    return 1;
+  }
+  int failed = fwrite (compiled->image, 1, compiled->image_size, fp)
+               != compiled->image_size;
+  failed = (fclose (fp) != 0) || failed;
+  if (failed || rename (temp_path, path) != 0)
+  {
+    remove (temp_path);
+    free (temp_path);
+    return 1;
+  }
+  free (temp_path);
+  return 0;
+}
+
+/**
+ * Checks that the header describes an image of exactly image_size bytes.
+ */
+static bool is_header_valid (const CompiledChainHeader *header,
+                             size_t image_size)
+{
+  if (header->magic != COMPILED_CHAIN_MAGIC
+      || header->version != COMPILED_CHAIN_VERSION
+      || header->image_size != image_size
+      // bound the counts first, so laying them out can't overflow
+      || header->num_of_successors > image_size
+      || header->data_size > image_size)
+  {
+    return false;
+  }
+  ChainLayout layout;
+  get_layout (header, &layout);
+  if (layout.size != image_size)
+  {
+    return false;
+  }
+  const uint64_t *successor_offsets = (const uint64_t *)
+      ((const char *) header + layout.successor_offsets);
+  return successor_offsets[header->num_of_nodes]
+         == header->num_of_successors;
+}
+
+/**
+ * Checks the alias table of a state's successors: every column's alias is
+ * one of them.
+ */
+static bool is_alias_valid (const CompiledChain *compiled, uint64_t begin,
+                            uint64_t end)
+{
+  for (uint64_t i = begin; i < end; i++)
+  {
+    if ((uint64_t) compiled->alias[i] >= end - begin)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * Checks, in one pass over the sections of a valid header's image, that
+ * following it's offsets and ids stays inside the image: the offsets are
+ * monotonic and in their sections' bounds, the running sums increase, and
+ * the successors, start nodes and alias columns are ids of their tables,
+ * every start node has successors, and the data ends in a zero byte, so
+ * a string copied into it can't be read past it.
+ */
+static bool are_sections_valid (const CompiledChain *compiled)
+{
+  const CompiledChainHeader *header = compiled->header;
+  uint32_t num_of_nodes = header->num_of_nodes;
+  if (compiled->successor_offsets[0] != 0
+      || (num_of_nodes > 0 && header->data_size == 0) // no data to read
+      || (header->data_size > 0
+          && compiled->data[header->data_size - 1] != '\0'))
+  {
+    return false;
+  }
+  for (uint32_t id = 0; id < num_of_nodes; id++)
+  {
+    uint64_t begin = compiled->successor_offsets[id];
+    uint64_t end = compiled->successor_offsets[id + 1];
+    if (end < begin || end > header->num_of_successors
+        || compiled->data_offsets[id] >= header->data_size
+        || (id > 0
+            && compiled->data_offsets[id] < compiled->data_offsets[id - 1])
+        || (compiled->alias != NULL
+            && !is_alias_valid (compiled, begin, end)))
+    {
+      return false;
+    }
+    for (uint64_t i = begin; i < end; i++)
+    {
+      if (compiled->successors[i] >= num_of_nodes
+          || compiled->cumulative[i] <= (i > begin
+                                         ? compiled->cumulative[i - 1] : 0))
+      {
+        return false;
+      }
+    }
+  }
+  if (header->num_of_start_nodes > 0
+      && (header->start_total == 0 || header->start_total > INT_MAX))
+  {
+    return false;
+  }
+  for (uint32_t i = 0; i < header->num_of_start_nodes; i++)
+  {
+    uint32_t id = compiled->start_nodes[i];
+    if (id >= num_of_nodes // or not a start node: it has no successors
+        || compiled->successor_offsets[id + 1]
+           == compiled->successor_offsets[id]
+        || (uint32_t) compiled->start_alias[i] >= header->num_of_start_nodes)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+CompiledChain *load_compiled_chain (const char *path)
+{
+  int fd = open (path, O_RDONLY);
+  if (fd == -1)
+  {
+    return NULL;
+  }
+  struct stat st;
+  if (fstat (fd, &st) != 0
+      || (size_t) st.st_size < sizeof (CompiledChainHeader))
+  {
+    close (fd);
+    return NULL;
+  }
+  size_t image_size = (size_t) st.st_size;
+  void *image = mmap (NULL, image_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close (fd); // the mapping keeps the file referenced
+  if (image == MAP_FAILED)
+  {
+    return NULL;
+  }
+  CompiledChain *compiled = NULL;
+  if (!is_header_valid (image, image_size)
+      || (compiled = malloc (sizeof (CompiledChain))) == NULL)
+  {
+    munmap (image, image_size);
+    return NULL;
+  }
+  *compiled = (CompiledChain) {.image = image, .image_size = image_size,
+                               .mapped = true};
+  set_views (compiled);
+  if (!are_sections_valid (compiled))
+  {
+    munmap (image, image_size);
+    free (compiled);
+    return NULL;
+  }
+  return compiled;
+}
+
+void free_compiled_chain (CompiledChain **compiled)
+{
+  if (*compiled == NULL)
+  {
+    return;
+  }
+  if ((*compiled)->mapped)
+  {
+    munmap ((*compiled)->image, (*compiled)->image_size);
+  }
+  else
+  {
+    free ((*compiled)->image);
+  }
+  free ((*compiled)->node_data);
+  free ((*compiled)->ids);
+  free (*compiled);
+  *compiled = NULL;
+}
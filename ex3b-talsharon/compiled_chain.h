@@ -0,0 +1,123 @@
+#ifndef COMPILED_CHAIN_H
+#define COMPILED_CHAIN_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define COMPILED_CHAIN_MAGIC 0x4E4B524DU // "MRKN" little endian
+#define COMPILED_CHAIN_VERSION 1
+// the image holds an alias table over every state's successors
+#define COMPILED_CHAIN_HAS_ALIAS 1
+
+struct MarkovChain;
+
+/**
+ * Header of a compiled chain image. The sections follow it in this order,
+ * each starting 8 byte aligned:
+ *   data_offsets       uint64[num_of_nodes]
+ *   successor_offsets  uint64[num_of_nodes + 1]
+ *   successors         uint32[num_of_successors]  (node ids)
+ *   cumulative         int32[num_of_successors]
+ *   alias_threshold    int32[num_of_successors]   (if HAS_ALIAS)
+ *   alias              int32[num_of_successors]   (if HAS_ALIAS)
+ *   start_nodes        uint32[num_of_start_nodes] (node ids)
+ *   start_threshold    int32[num_of_start_nodes]
+ *   start_alias        int32[num_of_start_nodes]
+ *   data               data_size bytes
+ */
+typedef struct CompiledChainHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t flags;
+    uint32_t num_of_nodes;
+    uint32_t num_of_start_nodes;
+    uint64_t num_of_successors;
+    uint64_t data_size;
+    uint64_t start_total; // sum of the occurrences of the start nodes
+    uint64_t image_size;
+} CompiledChainHeader;
+
+/**
+ * A trained chain in one pointer-free block of memory (an image): the
+ * successors of state i are entries successor_offsets[i] ..
+ * successor_offsets[i + 1] of the successor arrays, and the data of state i
+ * is the flat copy (by the chain's size_func) at data + data_offsets[i].
+ * States are numbered by their position in the database, or by how often
+ * they occurred (most frequent first) so the hot ones share cache lines.
+ * The same image is used in memory and on disk, so a saved chain is
+ * loaded by mapping the file, without reading it through.
+ */
+typedef struct CompiledChain {
+    void *image;
+    size_t image_size;
+    bool mapped; // the image is a read only file mapping
+    const CompiledChainHeader *header;
+    const uint64_t *data_offsets;
+    const uint64_t *successor_offsets;
+    const uint32_t *successors;
+    // running sum of the frequencies of a state's successors, the last one
+    // is the total
+    const int32_t *cumulative;
+    const int32_t *alias_threshold; // NULL if the image has no alias
+    const int32_t *alias; // alias column relative to the state's first
+    const uint32_t *start_nodes;
+    const int32_t *start_threshold;
+    const int32_t *start_alias;
+    const char *data;
+    // data of each state by reference, for chains with no size_func whose
+    // image has no data section. NULL if the image holds copies.
+    void **node_data;
+    // id in the image of each state by it's id in the database, NULL if
+    // they are the same
+    uint32_t *ids;
+    // version of the chain the image was compiled from, see MarkovChain
+    unsigned long source_version;
+} CompiledChain;
+
+/**
+ * Compiles the chain to an image in memory. The data of the states is
+ * copied into the image by the chain's size_func, or referenced from the
+ * chain if it has none (such an image can't be saved).
+ * @param markov_chain the chain to compile
+ * @param with_alias also build alias tables over the successors
+ * @param hot_order number the states by their occurrences
+ * @return pointer to the new CompiledChain: upon success, NULL: otherwise
+ */
+CompiledChain *compile_markov_chain (const struct MarkovChain *markov_chain,
+                                     bool with_alias, bool hot_order);
+
+/**
+ * Writes the image to the given path, through a temporary file that is
+ * renamed over it.
+ * @return 0 on success, 1 otherwise
+ */
+int save_compiled_chain (const CompiledChain *compiled, const char *path);
+
+/**
+ * Maps the image saved at the given path, read only. The header is
+ * checked, and it's offsets and ids in one linear pass, so a corrupt file
+ * can't make generating read outside the image.
+ * @return pointer to the new CompiledChain: upon success, NULL: if the file
+ * can't be read or isn't a valid image of this version
+ */
+CompiledChain *load_compiled_chain (const char *path);
+
+/**
+ * Frees (or unmaps) the image and sets the pointer to NULL.
+ */
+void free_compiled_chain (CompiledChain **compiled);
+
+/**
+ * Gets the data of a state.
+ */
+static inline const void *compiled_node_data (const CompiledChain *compiled,
+                                              uint32_t id)
+{
+  if (compiled->node_data != NULL)
+  {
+    return compiled->node_data[id];
+  }
+  return compiled->data + compiled->data_offsets[id];
+}
+
+#endif //COMPILED_CHAIN_H
@@ -0,0 +1,121 @@
+#include "corpus.h"
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+Corpus *open_corpus (const char *path)
+{
+  int fd = open (path, O_RDONLY);
+  if (fd == -1)
+  {
+    return NULL;
+  }
+  struct stat st;
+  Corpus *corpus = malloc (sizeof (Corpus));
+  if (corpus == NULL || fstat (fd, &st) != 0)
+  {
+    free (corpus);
+    close (fd);
+    return NULL;
+  }
+  *corpus = (Corpus) {NULL, (size_t) st.st_size};
+  if (corpus->size > 0) // an empty file can't be mapped, and needn't be
+  {
+    void *map = mmap (NULL, corpus->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED)
+    {
+      free (corpus);
+      close (fd);
+      return NULL;
+    }
+    madvise (map, corpus->size, MADV_SEQUENTIAL);
+    corpus->text = map;
+  }
+  close (fd); // the mapping keeps the file referenced
+  return corpus;
+}
+
+void close_corpus (Corpus **corpus)
+{
+  if (*corpus == NULL)
+  {
+    return;
+  }
+  if ((*corpus)->size > 0)
+  {
+    munmap ((void *) (*corpus)->text, (*corpus)->size);
+  }
+  free (*corpus);
+  *corpus = NULL;
+}
+
+const char *next_line (const char **cur, const char *end, size_t *len)
+{
+  if (*cur >= end)
+  {
+    return NULL;
+  }
+  const char *line = *cur;
+  // memchr scans a vector of bytes at a time
+  const char *newline = memchr (line, '\n', end - line);
+  if (newline == NULL)
+  {
+    *len = end - line;
+    *cur = end;
+  }
+  else
+  {
+    *len = newline - line;
+    *cur = newline + 1;
+  }
+  return line;
+}
+
+const char *next_token (const char **cur, const char *end, size_t *len)
+{
+  while (*cur < end)
+  {
+    const char *token = *cur;
+    const char *space = memchr (token, ' ', end - token);
+    const char *token_end = space == NULL ? end : space;
+    *cur = space == NULL ? end : space + 1;
+    const char *carriage_return = memchr (token, '\r', token_end - token);
+    if (carriage_return != NULL)
+    {
+      token_end = carriage_return;
+    }
+    if (token_end > token)
+    {
+      *len = token_end - token;
+      return token;
+    }
+  }
+  return NULL;
+}
+
+const char *next_strtok_token (const char **cur, const char *end,
+                               size_t *len)
+{
+  while (*cur < end && **cur == ' ')
+  {
+    (*cur)++;
+  }
+  if (*cur >= end)
+  {
+    return NULL;
+  }
+  const char *token = *cur;
+  const char *space = memchr (token, ' ', end - token);
+  const char *token_end = space == NULL ? end : space;
+  *cur = space == NULL ? end : space + 1;
+  *len = 0;
+  while (token + *len < token_end && token[*len] != '\r'
+         && token[*len] != '\n')
+  {
+    (*len)++;
+  }
+  return token;
+}
@@ -0,0 +1,59 @@
+#ifndef CORPUS_H
+#define CORPUS_H
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * A text corpus mapped to memory. Lines and tokens are handed out as
+ * (pointer, length) views into the mapping, nothing is copied and there is
+ * no limit on the length of a line.
+ */
+typedef struct Corpus {
+    const char *text;
+    size_t size;
+} Corpus;
+
+/**
+ * Maps the file at path to memory, read only.
+ * @return pointer to the new Corpus: upon success, NULL: otherwise
+ */
+Corpus *open_corpus (const char *path);
+
+/**
+ * Unmaps the corpus and sets the pointer to NULL.
+ */
+void close_corpus (Corpus **corpus);
+
+/**
+ * Gets the line starting at *cur and moves *cur past it's '\n'.
+ * @param cur position in the text, at the start of a line
+ * @param end end of the text
+ * @param len set to the length of the line, not including the '\n'
+ * @return pointer to the line, NULL if *cur is at the end of the text
+ */
+const char *next_line (const char **cur, const char *end, size_t *len);
+
+/**
+ * Gets the next space separated token starting at or after *cur and moves
+ * *cur past it. A token ends at the first '\r' in it. Empty tokens are
+ * skipped.
+ * @param cur position in a line
+ * @param end end of the line
+ * @param len set to the length of the token
+ * @return pointer to the token, NULL if there are no more tokens
+ */
+const char *next_token (const char **cur, const char *end, size_t *len);
+
+/**
+ * Gets the next token the way strtok (line, " ") does, cut at it's first
+ * '\r' or '\n', as the first version read a line with it's '\n': a token
+ * of a line end only is an empty token, not skipped.
+ * @param cur position in a line
+ * @param end end of the line, past it's '\n' if it has one
+ * @param len set to the length of the token, 0 for an empty token
+ * @return pointer to the token, NULL if there are no more tokens
+ */
+const char *next_strtok_token (const char **cur, const char *end,
+                               size_t *len);
+
+#endif //CORPUS_H
@@ -0,0 +1,84 @@
+#include "count_min.h"
+#include <stdlib.h>
+
+#define MIN_WIDTH 64
+#define GROWTH_FACTOR 2
+// odd multipliers of the rows' hash functions
+static const uint64_t ROW_MULTIPLIERS[COUNT_MIN_DEPTH] = {
+    0x9E3779B97F4A7C15ULL, 0xBF58476D1CE4E5B9ULL,
+    0x94D049BB133111EBULL, 0xD6E8FEB86659FD93ULL};
+#define ROW_SHIFT 32
+
+/**
+ * Gets the cell of the key in the given row.
+ */
+static uint8_t *key_cell (const CountMinSketch *sketch, uint64_t key,
+                           int row)
+{
+  uint64_t hash = (key ^ (key >> ROW_SHIFT)) * ROW_MULTIPLIERS[row];
+  size_t column = (size_t) (hash >> ROW_SHIFT) & (sketch->width - 1);
+  return sketch->cells + (size_t) row * sketch->width + column;
+}
+
+CountMinSketch *create_count_min (size_t memory_budget)
+{
+  size_t width = MIN_WIDTH;
+  while (width * GROWTH_FACTOR * COUNT_MIN_DEPTH <= memory_budget)
+  {
+    width *= GROWTH_FACTOR;
+  }
+  CountMinSketch *sketch = malloc (sizeof (CountMinSketch));
+  uint8_t *cells = calloc (width * COUNT_MIN_DEPTH, sizeof (uint8_t));
+  if (sketch == NULL || cells == NULL)
+  {
+    free (sketch);
+    free (cells);
+    return NULL;
+  }
+  *sketch = (CountMinSketch) {cells, width};
+  return sketch;
+}
+
+uint32_t count_min_add (CountMinSketch *sketch, uint64_t key, uint32_t count)
+{
+  uint32_t estimate = count_min_estimate (sketch, key);
+  estimate = COUNT_MIN_MAX - estimate > count ? estimate + count
+                                               : COUNT_MIN_MAX;
+  for (int row = 0; row < COUNT_MIN_DEPTH; row++)
+  {
+    uint8_t *cell = key_cell (sketch, key, row);
+    if (*cell < estimate)
+    {
+      *cell = (uint8_t) estimate;
+    }
+  }
+  return estimate;
+}
+
+uint32_t count_min_estimate (const CountMinSketch *sketch, uint64_t key)
+{
+  uint32_t estimate = COUNT_MIN_MAX;
+  for (int row = 0; row < COUNT_MIN_DEPTH; row++)
+  {
+    uint32_t cell = *key_cell (sketch, key, row);
+    estimate = cell < estimate ? cell : estimate;
+  }
+  return estimate;
+}
+
+size_t count_min_bytes (const CountMinSketch *sketch)
+{
+  return sizeof (CountMinSketch)
+         + sketch->width * COUNT_MIN_DEPTH * sizeof (uint8_t);
+}
+
+void free_count_min (CountMinSketch **sketch)
+{
+  if (*sketch == NULL)
+  {
+    return;
+  }
+  free ((*sketch)->cells);
+  free (*sketch);
+  *sketch = NULL;
+}
@@ -0,0 +1,52 @@
+#ifndef COUNT_MIN_H
+#define COUNT_MIN_H
+#include <stddef.h>
+#include <stdint.h>
+
+#define COUNT_MIN_DEPTH 4
+#define COUNT_MIN_MAX UINT8_MAX
+
+/**
+ * A count-min sketch: approximate counts of any num of keys in a fixed
+ * amount of memory. Each key is counted in one cell of each of the rows,
+ * and it's count is the smallest of it's cells, which is never less than
+ * the key's true count.
+ * Cells are single bytes that saturate at COUNT_MIN_MAX: the sketch tells
+ * rare keys from ones that passed a small threshold, and holds 4 times the
+ * cells in the same memory as with full counts.
+ */
+typedef struct CountMinSketch {
+    uint8_t *cells; // COUNT_MIN_DEPTH rows of width cells
+    size_t width; // always a power of 2
+} CountMinSketch;
+
+/**
+ * Creates an empty sketch of at most the given size.
+ * @param memory_budget bytes the cells may take
+ * @return pointer to the new CountMinSketch: upon success, NULL: otherwise
+ */
+CountMinSketch *create_count_min (size_t memory_budget);
+
+/**
+ * Counts a key count more times, raising only the cells that are at the
+ * key's current count (conservative update, which over counts less).
+ * @return the key's count after the update, at most COUNT_MIN_MAX
+ */
+uint32_t count_min_add (CountMinSketch *sketch, uint64_t key, uint32_t count);
+
+/**
+ * Gets the approximate count of a key, at most COUNT_MIN_MAX.
+ */
+uint32_t count_min_estimate (const CountMinSketch *sketch, uint64_t key);
+
+/**
+ * Bytes taken by the sketch.
+ */
+size_t count_min_bytes (const CountMinSketch *sketch);
+
+/**
+ * Frees the sketch and sets the pointer to NULL.
+ */
+void free_count_min (CountMinSketch **sketch);
+
+#endif //COUNT_MIN_H
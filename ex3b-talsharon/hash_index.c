@@ -0,0 +1,108 @@
+#include "hash_index.h"
+#include "markov_chain.h"
+#include <stdlib.h>
+
+#define INITIAL_CAPACITY 64
+#define GROWTH_FACTOR 2
+// grow when more than MAX_LOAD_NUM / MAX_LOAD_DEN of the slots are taken
+#define MAX_LOAD_NUM 7
+#define MAX_LOAD_DEN 10
+
+/**
+ * Allocates empty slot arrays of the given capacity to the index.
+ * @return 0 on success, 1 in case of allocation error
+ */
+static int alloc_slots (HashIndex *index, size_t capacity)
+{
+  size_t *hashes = malloc (sizeof (size_t) * capacity);
+  Node **nodes = calloc (capacity, sizeof (Node *));
+  if (hashes == NULL || nodes == NULL)
+  {
+    free (hashes);
+    free (nodes);
+    return 1;
+  }
+  index->hashes = hashes;
+  index->nodes = nodes;
+  index->capacity = capacity;
+  return 0;
+}
+
+/**
+ * Puts a node in the first free slot of it's probe sequence.
+ * The index must have a free slot.
+ */
+static void place (HashIndex *index, size_t hash, Node *node)
+{
+  size_t mask = index->capacity - 1;
+  size_t slot = hash & mask;
+  while (index->nodes[slot] != NULL)
+  {
+    slot = (slot + 1) & mask;
+  }
+  index->hashes[slot] = hash;
+  index->nodes[slot] = node;
+}
+
+/**
+ * Doubles the capacity of the index and re-places all of it's nodes.
+ * @return 0 on success, 1 in case of allocation error
+ */
+static int grow (HashIndex *index)
+{
+  HashIndex old = *index;
+  if (alloc_slots (index, old.capacity * GROWTH_FACTOR) != 0)
+  {
+    return 1;
+  }
+  for (size_t i = 0; i < old.capacity; i++)
+  {
+    if (old.nodes[i] != NULL)
+    {
+      place (index, old.hashes[i], old.nodes[i]);
+    }
+  }
+  free (old.hashes);
+  free (old.nodes);
+  return 0;
+}
+
+HashIndex *create_hash_index (void)
+{
+  HashIndex *index = malloc (sizeof (HashIndex));
+  if (index == NULL)
+  {
+    return NULL;
+  }
+  index->size = 0;
+  if (alloc_slots (index, INITIAL_CAPACITY) != 0)
+  {
+    free (index);
+    return NULL;
+  }
+  return index;
+}
+
+int hash_index_insert (HashIndex *index, size_t hash, Node *node)
+{
+  if ((index->size + 1) * MAX_LOAD_DEN > index->capacity * MAX_LOAD_NUM
+      && grow (index) != 0)
+  {
+    return 1;
+  }
+  place (index, hash, node);
+  index->size++;
+  return 0;
+}
+
+void free_hash_index (HashIndex **index)
+{
+  if (*index == NULL)
+  {
+    return;
+  }
+  free ((*index)->hashes);
+  free ((*index)->nodes);
+  free (*index);
+  *index = NULL;
+}
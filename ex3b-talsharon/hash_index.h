@@ -0,0 +1,40 @@
+#ifndef HASH_INDEX_H
+#define HASH_INDEX_H
+#include <stddef.h>
+#include "linked_list.h"
+
+/**
+ * An open-addressing (linear probing) hash table from a state's data to the
+ * database Node wrapping it. The index doesn't own the nodes, it's kept
+ * next to the database list, which still owns them and keeps their order.
+ * The chain probes it itself (see chain_impl.h), so the comparison of it's
+ * states can be inlined.
+ */
+typedef struct HashIndex {
+    size_t *hashes; // hash of the data in each slot
+    Node **nodes; // NULL for an empty slot
+    size_t capacity; // always a power of 2
+    size_t size;
+} HashIndex;
+
+/**
+ * Creates an empty index.
+ * @return pointer to the new HashIndex: upon success, NULL: otherwise
+ */
+HashIndex *create_hash_index (void);
+
+/**
+ * Adds a node to the index, the node's data must not be in the index yet.
+ * @param index the index to add to
+ * @param hash hash value of the node's data
+ * @param node the node to add
+ * @return 0 on success, 1 in case of allocation error
+ */
+int hash_index_insert (HashIndex *index, size_t hash, Node *node);
+
+/**
+ * Frees the index (not the nodes in it) and sets the pointer to NULL.
+ */
+void free_hash_index (HashIndex **index);
+
+#endif //HASH_INDEX_H
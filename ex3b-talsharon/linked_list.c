@@ -8,7 +8,13 @@ int add(LinkedList *link_list, void *data)
         return 1;
     }
     *new_node = (Node) {data, NULL};
+    append_node(link_list, new_node);
+    return 0;
+}
 
+void append_node(LinkedList *link_list, Node *new_node)
+{
+    new_node->next = NULL;
     if (link_list->first == NULL)
     {
         link_list->first = new_node;
@@ -21,5 +27,4 @@ int add(LinkedList *link_list, void *data)
     }
 
     link_list->size++;
-    return 0;
 }
\ No newline at end of file
@@ -21,4 +21,11 @@ typedef struct LinkedList {
  */
 int add (LinkedList *link_list, void *data);
 
+/**
+ * Append an already allocated node to the end of the given link list.
+ * @param link_list Link list to add the node to
+ * @param new_node node holding the data, it's next is set by the list
+ */
+void append_node (LinkedList *link_list, Node *new_node);
+
 #endif //_LINKEDLIST_H_
@@ -0,0 +1,307 @@
+#include "live_chain.h"
+
+#define DELTA_INITIAL_CAPACITY 1024
+#define GROWTH_FACTOR 2
+
+/**
+ * Creates a snapshot of the base chain's current version.
+ * @return pointer to the new LiveSnapshot: upon success, NULL: otherwise
+ */
+static LiveSnapshot *take_snapshot (const MarkovChain *base)
+{
+  LiveSnapshot *snapshot = malloc (sizeof (LiveSnapshot));
+  if (snapshot == NULL)
+  {
+    return NULL;
+  }
+  CompiledChain *compiled = compile_markov_chain (base, true, base->hot_order);
+  if (compiled == NULL)
+  {
+    free (snapshot);
+    return NULL;
+  }
+  compiled->source_version = base->version;
+  *snapshot = (LiveSnapshot) {*base, {NULL, NULL, 0}, NULL};
+  MarkovChain *markov_chain = &snapshot->markov_chain;
+  markov_chain->database = &snapshot->database;
+  markov_chain->index = NULL;
+  markov_chain->arena = NULL;
+  markov_chain->start_nodes = NULL;
+  markov_chain->start_nodes_size = 0;
+  markov_chain->start_nodes_capacity = 0;
+  markov_chain->start_alias_table = NULL;
+  markov_chain->score_table = NULL;
+  markov_chain->frozen = true;
+  markov_chain->compiled = compiled;
+  return snapshot;
+}
+
+static void free_snapshot (LiveSnapshot *snapshot)
+{
+  free_compiled_chain (&snapshot->markov_chain.compiled);
+  free (snapshot);
+}
+
+static bool is_held (LiveChain *live, const LiveSnapshot *snapshot)
+{
+  for (int i = 0; i < MAX_LIVE_READERS; i++)
+  {
+    if (atomic_load (&live->readers[i]) == snapshot)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * Frees the retired snapshots no reader holds. Called under compact_lock.
+ */
+static void free_retired (LiveChain *live)
+{
+  LiveSnapshot **link = &live->retired;
+  while (*link != NULL)
+  {
+    LiveSnapshot *snapshot = *link;
+    if (is_held (live, snapshot))
+    {
+      link = &snapshot->next_retired;
+      continue;
+    }
+    *link = snapshot->next_retired;
+    free_snapshot (snapshot);
+  }
+}
+
+/**
+ * Trains the base chain on the taken delta, from taken_pos on. Stops at
+ * the first allocation error with taken_pos at the state that failed, so
+ * training it again resumes right there. Called under compact_lock.
+ * @return 0 on success, 1 in case of allocation error
+ */
+static int train_taken (LiveChain *live)
+{
+  MarkovChain *base = live->base;
+  for (; live->taken_pos < live->taken_size; live->taken_pos++)
+  {
+    void *data = live->taken[live->taken_pos];
+    if (data == NULL) // end of a sequence
+    {
+      live->taken_prev = NULL;
+      continue;
+    }
+    Node *node = live->taken_added ? get_node_from_database (base, data)
+                                   : add_to_database (base, data);
+    if (node == NULL)
+    {
+      return 1;
+    }
+    live->taken_added = true;
+    if (live->taken_prev != NULL && !add_node_to_counter_list
+        (live->taken_prev->data, node->data, base))
+    {
+      return 1;
+    }
+    live->taken_added = false;
+    live->taken_prev = base->is_last (node->data->data) ? NULL : node;
+  }
+  return 0;
+}
+
+/**
+ * Takes the delta appended so far for training, appends go to a new one
+ * meanwhile. Frees the previous taken delta, which must be trained.
+ * Called under compact_lock.
+ */
+static void take_delta (LiveChain *live)
+{
+  free (live->taken);
+  pthread_mutex_lock (&live->delta_lock);
+  live->taken = live->delta;
+  live->taken_size = live->delta_size;
+  live->delta = NULL;
+  live->delta_size = 0;
+  live->delta_capacity = 0;
+  pthread_mutex_unlock (&live->delta_lock);
+  live->taken_pos = 0;
+  live->taken_prev = NULL;
+  live->taken_added = false;
+}
+
+/**
+ * compact_live_chain, called under compact_lock.
+ */
+static bool compact_locked (LiveChain *live)
+{
+  // the rest of a delta taken by a compaction that failed goes first
+  if (train_taken (live) != 0)
+  {
+    return false;
+  }
+  take_delta (live);
+  if (train_taken (live) != 0)
+  {
+    return false;
+  }
+  // base is trained on all of the taken deltas, if this fails the next
+  // compaction publishes it
+  LiveSnapshot *snapshot = take_snapshot (live->base);
+  if (snapshot == NULL)
+  {
+    return false;
+  }
+  LiveSnapshot *old = atomic_exchange (&live->snapshot, snapshot);
+  if (old != NULL)
+  {
+    old->next_retired = live->retired;
+    live->retired = old;
+  }
+  free_retired (live);
+  free (live->taken); // published
+  live->taken = NULL;
+  live->taken_size = 0;
+  live->taken_pos = 0;
+  return true;
+}
+
+LiveChain *create_live_chain (MarkovChain *markov_chain,
+                              size_t compact_every)
+{
+  LiveChain *live = calloc (1, sizeof (LiveChain));
+  if (live == NULL)
+  {
+    return NULL;
+  }
+  live->base = markov_chain;
+  live->compact_every = compact_every;
+  pthread_mutex_init (&live->compact_lock, NULL);
+  pthread_mutex_init (&live->delta_lock, NULL);
+  atomic_init (&live->snapshot, NULL);
+  for (int i = 0; i < MAX_LIVE_READERS; i++)
+  {
+    atomic_init (&live->readers[i], NULL);
+    atomic_init (&live->reader_taken[i], false);
+  }
+  if (!compact_live_chain (live))
+  {
+    live->base = NULL; // still the caller's
+    free_live_chain (&live);
+    return NULL;
+  }
+  return live;
+}
+
+bool append_live_sequence (LiveChain *live, void *const states[],
+                           int num_of_states)
+{
+  pthread_mutex_lock (&live->delta_lock);
+  size_t needed = live->delta_size + (size_t) num_of_states + 1;
+  if (needed > live->delta_capacity)
+  {
+    size_t capacity = live->delta_capacity > 0 ? live->delta_capacity
+                                               : DELTA_INITIAL_CAPACITY;
+    while (capacity < needed)
+    {
+      capacity *= GROWTH_FACTOR;
+    }
+    void **delta = realloc (live->delta, sizeof (void *) * capacity);
+    if (delta == NULL)
+    {
+      pthread_mutex_unlock (&live->delta_lock);
+      return false;
+    }
+    live->delta = delta;
+    live->delta_capacity = capacity;
+  }
+  for (int i = 0; i < num_of_states; i++)
+  {
+    live->delta[live->delta_size++] = states[i];
+  }
+  live->delta[live->delta_size++] = NULL;
+  bool full = live->delta_size >= live->compact_every;
+  pthread_mutex_unlock (&live->delta_lock);
+  // a running compaction takes this delta next time, don't wait for it
+  if (full && pthread_mutex_trylock (&live->compact_lock) == 0)
+  {
+    bool success = compact_locked (live);
+    pthread_mutex_unlock (&live->compact_lock);
+    return success;
+  }
+  return true;
+}
+
+bool compact_live_chain (LiveChain *live)
+{
+  pthread_mutex_lock (&live->compact_lock);
+  bool success = compact_locked (live);
+  pthread_mutex_unlock (&live->compact_lock);
+  return success;
+}
+
+int register_live_reader (LiveChain *live)
+{
+  for (int i = 0; i < MAX_LIVE_READERS; i++)
+  {
+    if (!atomic_exchange (&live->reader_taken[i], true))
+    {
+      return i;
+    }
+  }
+  return NO_LIVE_READER;
+}
+
+void unregister_live_reader (LiveChain *live, int reader)
+{
+  atomic_store (&live->reader_taken[reader], false);
+}
+
+MarkovChain *acquire_live_snapshot (LiveChain *live, int reader)
+{
+  LiveSnapshot *snapshot = atomic_load (&live->snapshot);
+  while (true)
+  {
+    atomic_store (&live->readers[reader], snapshot);
+    // still current after it's held: a compaction that replaces it from
+    // now on sees it held and doesn't free it
+    LiveSnapshot *current = atomic_load (&live->snapshot);
+    if (current == snapshot)
+    {
+      return &snapshot->markov_chain;
+    }
+    snapshot = current;
+  }
+}
+
+void release_live_snapshot (LiveChain *live, int reader)
+{
+  atomic_store (&live->readers[reader], NULL);
+}
+
+void free_live_chain (LiveChain **live)
+{
+  if (*live == NULL)
+  {
+    return;
+  }
+  LiveSnapshot *snapshot = atomic_load (&(*live)->snapshot);
+  if (snapshot != NULL)
+  {
+    free_snapshot (snapshot);
+  }
+  while ((*live)->retired != NULL)
+  {
+    snapshot = (*live)->retired;
+    (*live)->retired = snapshot->next_retired;
+    free_snapshot (snapshot);
+  }
+  if ((*live)->base != NULL)
+  {
+    free_markov_chain (&(*live)->base);
+  }
+  free ((*live)->delta);
+  free ((*live)->taken);
+  pthread_mutex_destroy (&(*live)->compact_lock);
+  pthread_mutex_destroy (&(*live)->delta_lock);
+  free (*live);
+  *live = NULL;
+}
@@ -0,0 +1,123 @@
+#ifndef LIVE_CHAIN_H
+#define LIVE_CHAIN_H
+#include "markov_chain.h"
+#include <pthread.h>
+#include <stdatomic.h>
+
+#define MAX_LIVE_READERS 64
+#define NO_LIVE_READER (-1)
+
+/**
+ * An immutable version of a live chain: a chain with no database, only a
+ * compiled image, generated from the way a loaded chain is.
+ */
+typedef struct LiveSnapshot {
+    MarkovChain markov_chain;
+    LinkedList database; // always empty
+    struct LiveSnapshot *next_retired;
+} LiveSnapshot;
+
+/**
+ * A chain trained and generated from at the same time, by any num of
+ * threads.
+ * Training threads append sequences to a delta, under a lock only they
+ * take. Every compact_every states the delta is compacted: it's sequences
+ * are trained into the base chain, which is compiled into a new snapshot,
+ * and the snapshot is published by an atomic pointer swap.
+ * Generating threads never wait for training: a reader takes the current
+ * snapshot lock free and generates from it while newer ones are published.
+ * A replaced snapshot is retired, and freed once no reader holds it (each
+ * reader publishes the snapshot it holds in it's own slot, a hazard
+ * pointer).
+ */
+typedef struct LiveChain {
+    MarkovChain *base; // touched by compaction only
+    pthread_mutex_t compact_lock; // one compaction at a time
+
+    // states of the sequences appended since the last compaction, each
+    // sequence ended by NULL
+    pthread_mutex_t delta_lock;
+    void **delta;
+    size_t delta_size;
+    size_t delta_capacity;
+    size_t compact_every; // delta size that triggers a compaction
+    // the delta a compaction took, under compact_lock. It's trained into
+    // base up to taken_pos and kept until it's snapshot is published: a
+    // compaction that fails leaves it, and the next one resumes from there
+    void **taken;
+    size_t taken_size;
+    size_t taken_pos;
+    Node *taken_prev; // the state at taken_pos follows it
+    bool taken_added; // the state at taken_pos is in base, it's transition
+                      // isn't yet
+
+    _Atomic (LiveSnapshot *) snapshot; // the current version
+    _Atomic (LiveSnapshot *) readers[MAX_LIVE_READERS]; // held snapshots
+    atomic_bool reader_taken[MAX_LIVE_READERS];
+    LiveSnapshot *retired; // replaced and maybe held, under compact_lock
+} LiveChain;
+
+/**
+ * Creates a live chain over markov_chain, and publishes it's first
+ * snapshot.
+ * @param markov_chain the base chain, empty or trained, with a hash_func.
+ * The live chain owns it from now on.
+ * @param compact_every num of appended states that triggers a compaction
+ * @return pointer to the new LiveChain: upon success, NULL: otherwise
+ */
+LiveChain *create_live_chain (MarkovChain *markov_chain,
+                              size_t compact_every);
+
+/**
+ * Appends a sequence of states to the delta: each state follows the one
+ * before it, unless that one is last. The states are copied into the
+ * chain (by it's copy_func or size_func) when the delta is compacted, so
+ * their data must stay valid until then, like words of a StringPool.
+ * Compacts the delta if it's big enough and no compaction is running.
+ * @param states data of the states, in order
+ * @return success/failure: true if the process was successful, false if
+ * in case of allocation error.
+ */
+bool append_live_sequence (LiveChain *live, void *const states[],
+                           int num_of_states);
+
+/**
+ * Trains the base chain on the delta and publishes a snapshot of it.
+ * @return success/failure: true if the process was successful, false if
+ * in case of allocation error, then the current snapshot is kept, and the
+ * delta is kept for the next compaction: no state of it is lost or trained
+ * twice.
+ */
+bool compact_live_chain (LiveChain *live);
+
+/**
+ * Takes a reader slot, for one thread at a time to generate with.
+ * @return the reader's slot, NO_LIVE_READER if all are taken
+ */
+int register_live_reader (LiveChain *live);
+
+/**
+ * Gives back a reader slot, the reader must hold no snapshot.
+ */
+void unregister_live_reader (LiveChain *live, int reader);
+
+/**
+ * Gets the current snapshot for the reader, lock free. The snapshot stays
+ * valid until the reader releases it. Generate from it with an Rng of the
+ * reader's own (see generate_sequence_into), never with the chain's.
+ * @return the snapshot's chain
+ */
+MarkovChain *acquire_live_snapshot (LiveChain *live, int reader);
+
+/**
+ * Lets the snapshot the reader holds be freed once it's replaced.
+ */
+void release_live_snapshot (LiveChain *live, int reader);
+
+/**
+ * Frees the live chain, it's base chain and all snapshots, sets the
+ * pointer to NULL. No thread may be using it.
+ */
+void free_live_chain (LiveChain **live);
+
+#endif //LIVE_CHAIN_H
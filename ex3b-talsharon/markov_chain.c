@@ -3,6 +3,34 @@
 #include <stdio.h>
 #include <stdbool.h>
 #include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <limits.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#define START_NODES_INITIAL_CAPACITY 64
+#define COUNTER_LIST_INITIAL_CAPACITY 2
+#define GROWTH_FACTOR 2
+// counter lists longer than this get a hash index
+#define COUNTER_INDEX_THRESHOLD 8
+#define EMPTY_SLOT (-1)
+#define POINTER_HASH_MULTIPLIER 0x9E3779B97F4A7C15ULL
+#define POINTER_HASH_SHIFT 32
+#define EDGE_KEY_SHIFT 32
+#define MAX_SCORE_THREADS 64
+
+/**
+ * Sequences a thread of score_sequences scores.
+ */
+typedef struct ScoreWorker {
+    MarkovChain *markov_chain;
+    void **const *sequences;
+    const int *lengths;
+    int first; // first sequence to score
+    int last; // one past the last
+    double *log_probs;
+} ScoreWorker;
 
 /**
  * Checks if second node is in first node's counter list.
@@ -11,12 +39,266 @@
                      the node which it's counter list is checked
  * @param second_node pointer to MarkovNode
                       the node which is searched if already in first's list
- * @param markov_chain pointer to MarkovChain
  * @return true: if second node is in first's counter list, false: otherwise
  */
 bool is_node_in_counter_list (const MarkovNode *first_node, MarkovNode
 *second_node);
 
+/**
+ * Finds the position of second node in first node's counter list.
+ * @return index in the counter list, EMPTY_SLOT if not in it.
+ */
+static int find_counter (const MarkovNode *first_node,
+                         const MarkovNode *second_node);
+
+/**
+ * add_node_to_counter_list of a chain in approximate training: counts the
+ * transition in the sketch, and adds it to the counter list if it's there
+ * already or has just passed the promote threshold.
+ * @return true: upon success, false: in case of allocation error.
+ */
+static bool add_approximate_counter (MarkovChain *markov_chain,
+                                     MarkovNode *first_node,
+                                     MarkovNode *second_node);
+
+/**
+ * A lossy counting round: drops the counters of max_frequency or less from
+ * all counter lists.
+ */
+static void prune_counters (MarkovChain *markov_chain, int max_frequency);
+
+/**
+ * Drops the start nodes left with no counters, dead ends that a sequence
+ * mustn't start from.
+ */
+static void remove_dead_starts (MarkovChain *markov_chain);
+
+/**
+ * Adds frequency to the transition from first node to second node,
+ * appending it to first node's counter list if it isn't there yet, and
+ * making first node a start node with it's first counter.
+ * Doesn't update the counter list full size.
+ * @return true: upon success, false: in case of allocation error.
+ */
+static bool add_to_counter (MarkovChain *markov_chain, MarkovNode *first_node,
+                            MarkovNode *second_node, int frequency);
+
+/**
+ * Adds the counter at position ind of the node's counter list to the
+ * node's counter index, building or growing the index as needed.
+ * @return true: upon success, false: in case of allocation error.
+ */
+static bool index_counter (MarkovNode *markov_node, int ind, Arena *arena);
+
+/**
+ * Makes sure the database is indexed by the chain's hash_func, indexing the
+ * nodes already in the database on first use.
+ * @param markov_chain pointer to MarkovChain with a hash_func
+ * @return true: upon success, false: in case of allocation error.
+ */
+static bool build_index (MarkovChain *markov_chain);
+
+/**
+ * Makes sure the node's alias table matches it's current frequencies,
+ * builds it on first use and rebuilds it if the frequencies changed.
+ * @param markov_node pointer to MarkovNode with a non empty counter list
+ * @return true: upon success, false: in case of allocation error.
+ */
+static bool update_alias_table (MarkovNode *markov_node);
+
+/**
+ * Get random number between 0 and max_number [0, max_number), from the
+ * given stream, or from rand() if it's NULL.
+ */
+static int draw_number (Rng *rng, int max_number);
+
+/**
+ * Draw an outcome from an alias table.
+ * @param table pointer to AliasTable
+ * @param rng the random stream, NULL for rand()
+ * @return index of the chosen outcome
+ */
+static int draw_alias (const AliasTable *table, Rng *rng);
+
+/**
+ * Makes sure the chain's start alias table matches the current occurrences
+ * of it's start nodes, (re)building it if needed.
+ * @param markov_chain pointer to MarkovChain with at least one start node
+ * @return true: upon success, false: in case of allocation error.
+ */
+static bool update_start_alias_table (MarkovChain *markov_chain);
+
+/**
+ * Appends a state to the chain's start nodes, with it's occurrences.
+ * Start nodes are the states a sequence can start from: non terminal
+ * states with at least one counter, so a dead end (a state whose
+ * transitions were all pruned, or the last word of a line with no dot)
+ * never starts one.
+ * @return true: upon success, false: in case of allocation error.
+ */
+static bool add_start_node (MarkovChain *markov_chain,
+                            MarkovNode *markov_node);
+
+/**
+ * Choose the next state from an up to date alias table of the node.
+ * @param markov_node pointer to MarkovNode
+ * @param rng the random stream, NULL for rand()
+ * @return MarkovNode of the chosen state
+ */
+static MarkovNode *sample_alias_node (const MarkovNode *markov_node,
+                                      Rng *rng);
+
+/**
+ * get_first_random_node, drawing from the given stream (NULL for rand()).
+ * A RNG_RAND stream with a uniform start draws the way the first version
+ * did, an index over the whole database until it's a start node, so a
+ * seed of srand gives the same states. Any other stream draws one of the
+ * start nodes directly.
+ */
+static MarkovNode *first_random_node (MarkovChain *markov_chain, Rng *rng);
+
+/**
+ * get_next_random_node, drawing from the given stream (NULL for rand()).
+ */
+static MarkovNode *next_random_node (MarkovNode *markov_node, Rng *rng);
+
+/**
+ * Choose the next state the way markov_chain is set to sample.
+ * @param markov_chain pointer to MarkovChain
+ * @param markov_node pointer to MarkovNode to choose from
+ * @param rng the random stream, NULL for rand()
+ * @return MarkovNode of the chosen state
+ */
+static MarkovNode *next_node (MarkovChain *markov_chain,
+                              MarkovNode *markov_node, Rng *rng);
+
+/**
+ * Checks if the chain has a compiled image of it's current version.
+ */
+static bool is_compiled_current (const MarkovChain *markov_chain);
+
+/**
+ * Get one random first state from the chain's compiled image, chosen the
+ * same way get_first_random_node chooses it.
+ * @param markov_chain pointer to MarkovChain with a compiled image
+ * @param rng the random stream, NULL for rand()
+ * @return id of the chosen state, EMPTY_SLOT if there is no such state
+ */
+static long first_compiled_node (const MarkovChain *markov_chain, Rng *rng);
+
+/**
+ * Choose randomly the next state in a compiled image, by the state's alias
+ * table if the image has them, by it's running sums of frequencies
+ * otherwise.
+ * @param compiled pointer to CompiledChain
+ * @param id id of the state to choose from
+ * @param rng the random stream, NULL for rand()
+ * @return id of the chosen state, EMPTY_SLOT if the state has no successors
+ */
+static long next_compiled_node (const CompiledChain *compiled, uint32_t id,
+                                Rng *rng);
+
+/**
+ * Generate and print a random sentence out of the chain's compiled image.
+ * @param markov_chain pointer to MarkovChain with a compiled image
+ * @param id id of the state to start with
+ * @param max_length maximum length of chain to generate
+ * @param rng the random stream, NULL for rand()
+ */
+static void generate_compiled_sequence (MarkovChain *markov_chain, long id,
+                                        int max_length, Rng *rng);
+
+/**
+ * Print the first state of a sequence by the chain's print_first_func, or
+ * it's print_func if it has none.
+ */
+static void print_first (const MarkovChain *markov_chain, void *data);
+
+/**
+ * Scales a count of a chain merged by merge_markov_chains, see there.
+ */
+static int scale_count (int count, double weight);
+
+/**
+ * Adds a non negative count to another, saturated at INT_MAX.
+ */
+static int saturating_add (int count, int added);
+
+/**
+ * Merges all states and transitions of src into dst, with src's counts
+ * scaled by weight (merge_markov_chain_into for weight 1).
+ * @return success/failure: true if the process was successful, false if in
+ * case of allocation error or if either chain is in approximate training.
+ */
+static bool merge_weighted (MarkovChain *dst, MarkovChain *src,
+                            double weight);
+
+/**
+ * Prepares a frozen chain to be read only by a mixture: builds it's index,
+ * start alias table if weighted_start and, if it's image is stale, it's
+ * alias tables.
+ * @param weighted_start weighted_start of the mixture's first chain
+ * @return success/failure: true if the process was successful, false if in
+ * case of allocation error.
+ */
+static bool prepare_mixed (MarkovChain *markov_chain, bool weighted_start);
+
+/**
+ * Draws a chain of the mixture, each by the given weight.
+ * @param weights weight of each chain
+ * @param total sum of weights
+ * @return index of the chain, -1 if total isn't positive
+ */
+static int draw_mixed (const double weights[], int num_of_chains,
+                       double total, Rng *rng);
+
+/**
+ * Draws the first state of a sequence of a mixture, see
+ * create_mixture_chain.
+ * @return the state's data, NULL if the mixture has no first state
+ */
+static void *first_mixed_data (const MixtureChain *mixture, Rng *rng);
+
+/**
+ * Draws the state after data in a mixture, see create_mixture_chain.
+ * @return the state's data, NULL if no chain has a state after it
+ */
+static void *next_mixed_data (const MixtureChain *mixture, void *data,
+                              Rng *rng);
+
+/**
+ * Builds the chain's score table for the given smoothing, unless it has a
+ * current one for it.
+ * @return success/failure: true if the process was successful, false if in
+ * case of allocation error.
+ */
+static bool update_score_table (MarkovChain *markov_chain, double smoothing);
+
+/**
+ * Scores a worker's sequences, see score_sequences.
+ * @param arg pointer to ScoreWorker
+ */
+static void *score_range (void *arg);
+
+// the generic states, through the chain's functions
+#define CHAIN_FN(name) generic_##name
+#define CHAIN_KEY void *
+#define CHAIN_HASH(chain, data) ((chain)->hash_func (data))
+#define CHAIN_EQUAL(chain, first, second) \
+  ((chain)->comp_func (first, second) == 0)
+#define CHAIN_IS_LAST(chain, data) ((chain)->is_last (data))
+#include "chain_impl.h"
+
+// InternedStr states, compared, hashed and checked inline, see comp_interned
+#define CHAIN_FN(name) string_##name
+#define CHAIN_KEY const InternedStr *
+#define CHAIN_HASH(chain, data) ((size_t) (data)->hash)
+#define CHAIN_EQUAL(chain, first, second) \
+  ((first)->pool_id == (second)->pool_id ? (first)->id == (second)->id \
+   : comp_interned (first, second) == 0)
+#define CHAIN_IS_LAST(chain, data) ((data)->is_last)
+#include "chain_impl.h"
+
 /**
 * Get random number between 0 and max_number [0, max_number).
 * @param max_number maximal number to return (not including)
@@ -27,29 +309,56 @@ int get_random_number(int max_number)
   return rand () % max_number;
 }
 
+static int draw_number (Rng *rng, int max_number)
+{
+  if (rng != NULL)
+  {
+    return rng_below (rng, max_number);
+  }
+  return get_random_number (max_number);
+}
+
 /**
- * Get one random state from the given markov_chain's database.
+ * Get one random non terminal state from the given markov_chain's database.
+ * The state is chosen uniformly, or by it's occurrences if the chain's
+ * weighted_start is set.
  * @param markov_chain
- * @return
+ * @return MarkovNode of the chosen state, NULL if there is no such state
  */
 MarkovNode* get_first_random_node(MarkovChain *markov_chain)
 {
-  MarkovNode *rand_node = NULL;
-  while (1)
+  return first_random_node (markov_chain, &markov_chain->rng);
+}
+
+static MarkovNode *first_random_node (MarkovChain *markov_chain, Rng *rng)
+{
+  if (markov_chain->start_nodes_size == 0)
   {
-    int ind = get_random_number (markov_chain->database->size);
-    Node *node_ptr = markov_chain->database->first;
-    for (; ind > 0; ind--)
-    {
-      node_ptr = node_ptr->next;
-    }
-    if (!markov_chain->is_last (node_ptr->data->data))
+    return NULL;
+  }
+  if (markov_chain->weighted_start && update_start_alias_table (markov_chain))
+  {
+    return markov_chain->start_nodes[draw_alias
+        (markov_chain->start_alias_table, rng)];
+  }
+  if (rng == NULL || rng->kind == RNG_RAND)
+  {
+    while (true) // retries last states and dead ends, there is a start node
     {
-      rand_node = node_ptr->data;
-      break;
+      int ind = draw_number (rng, markov_chain->database->size);
+      Node *node_ptr = markov_chain->database->first;
+      for (; ind > 0; ind--)
+      {
+        node_ptr = node_ptr->next;
+      }
+      if (node_ptr->data->counter_list_size > 0) // a start node
+      {
+        return node_ptr->data;
+      }
     }
   }
-  return rand_node;
+  return markov_chain->start_nodes[draw_number
+      (rng, markov_chain->start_nodes_size)];
 }
 
 /**
@@ -59,178 +368,1173 @@ MarkovNode* get_first_random_node(MarkovChain *markov_chain)
  */
 MarkovNode* get_next_random_node(MarkovNode *state_struct_ptr)
 {
-  int rand_num = get_random_number
-                  (state_struct_ptr->counter_list_full_size);
+  return next_random_node (state_struct_ptr, NULL);
+}
+
+static MarkovNode *next_random_node (MarkovNode *state_struct_ptr, Rng *rng)
+{
+  if (state_struct_ptr->alias_table != NULL
+      && update_alias_table (state_struct_ptr))
+  {
+    return sample_alias_node (state_struct_ptr, rng);
+  }
+  int rand_num = draw_number (rng, state_struct_ptr->counter_list_full_size);
   int ind = -1;
   while (rand_num >= 0)
   {
     ind++;
-    rand_num = rand_num - state_struct_ptr->counter_list[ind]->frequency;
+    rand_num = rand_num - state_struct_ptr->counter_list[ind].frequency;
+  }
+  return state_struct_ptr->counter_list[ind].markov_node;
+}
+
+static bool update_alias_table (MarkovNode *markov_node)
+{
+  if (markov_node->alias_table != NULL
+      && markov_node->alias_table->total == markov_node->counter_list_full_size)
+  {
+    return true;
+  }
+  free_alias_table (&markov_node->alias_table);
+  int *weights = malloc (sizeof (int) * markov_node->counter_list_size);
+  if (weights == NULL)
+  {
+    return false;
+  }
+  for (int i = 0; i < markov_node->counter_list_size; i++)
+  {
+    weights[i] = markov_node->counter_list[i].frequency;
+  }
+  markov_node->alias_table = create_alias_table
+      (weights, markov_node->counter_list_size);
+  free (weights);
+  return markov_node->alias_table != NULL;
+}
+
+static int draw_alias (const AliasTable *table, Rng *rng)
+{
+  long long range = (long long) table->size * table->total;
+  int column, coin;
+  if (range <= RAND_MAX) // one draw covers both the column and the coin
+  {
+    int rand_num = draw_number (rng, (int) range);
+    column = rand_num / table->total;
+    coin = rand_num % table->total;
+  }
+  else
+  {
+    column = draw_number (rng, table->size);
+    coin = draw_number (rng, table->total);
   }
-  return state_struct_ptr->counter_list[ind]->markov_node;
+  return sample_alias_table (table, column, coin);
 }
 
+static MarkovNode *sample_alias_node (const MarkovNode *markov_node,
+                                      Rng *rng)
+{
+  return markov_node->counter_list[draw_alias (markov_node->alias_table,
+                                               rng)].markov_node;
+}
 
-/**
- * Receive markov_chain, generate and print random sentence out of it. The
- * sentence most have at least 2 words in it.
- * @param markov_chain pointer to MarkovChain
- * @param first_node markov_node to start with,
- *                   if NULL- choose a random markov_node
- * @param  max_length maximum length of chain to generate
- */
-void generate_random_sequence(MarkovChain *markov_chain, MarkovNode *
-first_node, int max_length)
+static bool update_start_alias_table (MarkovChain *markov_chain)
 {
-  if (first_node == NULL)
+  if (markov_chain->start_alias_table != NULL
+      && markov_chain->start_alias_table->total
+         == markov_chain->start_occurrences)
   {
-    first_node = get_first_random_node (markov_chain);
+    return true;
   }
-  MarkovNode *cur_node = first_node;
-  markov_chain->print_func (cur_node->data);
-  for (int i = 0; i < max_length-1; i++)
+  free_alias_table (&markov_chain->start_alias_table);
+  int *weights = malloc (sizeof (int) * markov_chain->start_nodes_size);
+  if (weights == NULL)
   {
-    cur_node = get_next_random_node (cur_node);
-    if (!markov_chain->is_last (cur_node->data))
-    {
-      markov_chain->print_func (cur_node->data);
-    }
-    else
-    {
-      markov_chain->print_func (cur_node->data);
-      break;
-    }
+    return false;
+  }
+  for (int i = 0; i < markov_chain->start_nodes_size; i++)
+  {
+    weights[i] = markov_chain->start_nodes[i]->occurrences;
   }
+  markov_chain->start_alias_table = create_alias_table
+      (weights, markov_chain->start_nodes_size);
+  free (weights);
+  return markov_chain->start_alias_table != NULL;
 }
 
-/**
- * Free markov_chain and all of it's content from memory
- * @param markov_chain markov_chain to free
- */
-void free_markov_chain(MarkovChain ** ptr_chain)
+static bool add_start_node (MarkovChain *markov_chain,
+                            MarkovNode *markov_node)
 {
-  Node* node_ptr = (*ptr_chain)->database->first;
-  while (node_ptr != NULL)
+  if (markov_chain->start_nodes_size == markov_chain->start_nodes_capacity)
   {
-//    NextNodeCounter *counter_list = *node_ptr->data->counter_list;
-    for (int i = 0; i < node_ptr->data->counter_list_size; i++)
+    int new_capacity = markov_chain->start_nodes_capacity == 0
+                       ? START_NODES_INITIAL_CAPACITY
+                       : markov_chain->start_nodes_capacity * GROWTH_FACTOR;
+    MarkovNode **temp = realloc (markov_chain->start_nodes,
+                                 sizeof (MarkovNode *) * new_capacity);
+    if (temp == NULL)
     {
-      free (node_ptr->data->counter_list[i]);
-      node_ptr->data->counter_list[i] = NULL;
+      return false;
     }
-    free (node_ptr->data->counter_list);
-    node_ptr->data->counter_list = NULL;
-//    free (node_ptr->data->data);
-    (*ptr_chain)->free_data (node_ptr->data->data);
-    node_ptr->data->data = NULL;
-    free (node_ptr->data);
-    node_ptr->data = NULL;
-    Node *temp = node_ptr;
-    node_ptr = node_ptr->next;
-    free (temp);
-    temp = NULL;
+    markov_chain->start_nodes = temp;
+    markov_chain->start_nodes_capacity = new_capacity;
   }
-  free ((*ptr_chain)->database);
-  (*ptr_chain)->database = NULL;
-  free (*ptr_chain);
-  *ptr_chain = NULL;
+  markov_chain->start_nodes[markov_chain->start_nodes_size++] = markov_node;
+  markov_chain->start_occurrences += markov_node->occurrences;
+  free_alias_table (&markov_chain->start_alias_table);
+  return true;
 }
 
-bool
-is_node_in_counter_list (const MarkovNode *first_node, MarkovNode
-*second_node)
+static MarkovNode *next_node (MarkovChain *markov_chain,
+                              MarkovNode *markov_node, Rng *rng)
+{
+  if (markov_chain->frozen && markov_node->counter_list_size > 0
+      && update_alias_table (markov_node))
+  {
+    return sample_alias_node (markov_node, rng);
+  }
+  return next_random_node (markov_node, rng);
+}
+
+static void print_first (const MarkovChain *markov_chain, void *data)
+{
+  if (markov_chain->print_first_func != NULL)
+  {
+    markov_chain->print_first_func (data);
+    return;
+  }
+  markov_chain->print_func (data);
+}
+
+static bool is_compiled_current (const MarkovChain *markov_chain)
+{
+  return markov_chain->compiled != NULL
+         && markov_chain->compiled->source_version == markov_chain->version;
+}
+
+static long first_compiled_node (const MarkovChain *markov_chain, Rng *rng)
 {
-  for (int i = 0; first_node->counter_list[i]; i++)
+  const CompiledChain *compiled = markov_chain->compiled;
+  int size = (int) compiled->header->num_of_start_nodes;
+  if (size == 0)
+  {
+    return EMPTY_SLOT;
+  }
+  if (markov_chain->weighted_start)
   {
-    if (second_node == first_node->counter_list[i]->markov_node)
+    AliasTable table = {size, (int) compiled->header->start_total,
+                        (int *) compiled->start_threshold,
+                        (int *) compiled->start_alias};
+    return compiled->start_nodes[draw_alias (&table, rng)];
+  }
+  if (rng == NULL || rng->kind == RNG_RAND) // draws as first_random_node
+  {
+    const uint32_t *ids = compiled->ids;
+    while (true)
     {
-      first_node->counter_list[i]->frequency++;
-      return true;
+      int ind = draw_number (rng, (int) compiled->header->num_of_nodes);
+      uint32_t id = ids != NULL ? ids[ind] : (uint32_t) ind;
+      if (compiled->successor_offsets[id + 1]
+          > compiled->successor_offsets[id]) // a start node
+      {
+        return id;
+      }
     }
   }
-  return false;
+  return compiled->start_nodes[draw_number (rng, size)];
 }
 
-/**
- * Add the second markov_node to the counter list of the first markov_node.
- * If already in list, update it's counter value.
- * @param first_node
- * @param second_node
- * @param markov_chain
- * @return success/failure: true if the process was successful, false if in
- * case of allocation error.
- */
-bool add_node_to_counter_list(MarkovNode *first_node, MarkovNode
-*second_node, MarkovChain *markov_chain)
+static long next_compiled_node (const CompiledChain *compiled, uint32_t id,
+                                Rng *rng)
 {
-  if (is_node_in_counter_list (first_node, second_node)
-      || markov_chain->is_last (first_node->data))
+  uint64_t begin = compiled->successor_offsets[id];
+  int size = (int) (compiled->successor_offsets[id + 1] - begin);
+  if (size == 0)
   {
-    first_node->counter_list_full_size++;
-    return true;
+    return EMPTY_SLOT;
   }
-  NextNodeCounter *next_node_counter = malloc (sizeof (NextNodeCounter));
-  int counter_list_new_size = first_node->counter_list_size +1;
-  NextNodeCounter **temp =
-      realloc (first_node->counter_list,
-               sizeof (NextNodeCounter) *counter_list_new_size);
-  if (next_node_counter == NULL || temp == NULL)
+  int total = compiled->cumulative[begin + size - 1];
+  if (compiled->alias_threshold != NULL)
   {
-    return false;
+    AliasTable table = {size, total,
+                        (int *) (compiled->alias_threshold + begin),
+                        (int *) (compiled->alias + begin)};
+    return compiled->successors[begin + draw_alias (&table, rng)];
   }
-  first_node->counter_list = temp;
-  next_node_counter->frequency = 1;
-  next_node_counter->markov_node = second_node;
-  first_node->counter_list[first_node->counter_list_size] = next_node_counter;
-  first_node->counter_list[(first_node->counter_list_size)+1] = NULL;
-  first_node->counter_list_size++;
-  first_node->counter_list_full_size++;
-  return true;
+  // the first successor whose running sum is above the draw, the one
+  // get_next_random_node picks for the same draw
+  int rand_num = draw_number (rng, total);
+  int low = 0, high = size - 1;
+  while (low < high)
+  {
+    int mid = low + (high - low) / 2;
+    if (compiled->cumulative[begin + mid] > rand_num)
+    {
+      high = mid;
+    }
+    else
+    {
+      low = mid + 1;
+    }
+  }
+  return compiled->successors[begin + low];
 }
 
-Node* get_node_from_database(MarkovChain *markov_chain, void *data_ptr)
+static void generate_compiled_sequence (MarkovChain *markov_chain, long id,
+                                        int max_length, Rng *rng)
 {
-  Node *node_ptr = markov_chain->database->first;
-  while (node_ptr != NULL) //go through all markov chain and look for data
+  const CompiledChain *compiled = markov_chain->compiled;
+  void *data = (void *) compiled_node_data (compiled, (uint32_t) id);
+  print_first (markov_chain, data);
+  for (int i = 0; i < max_length-1; i++)
   {
-    if (markov_chain->comp_func (node_ptr->data->data, data_ptr) == 0) //found
-      // data:return node
+    id = next_compiled_node (compiled, (uint32_t) id, rng);
+    if (id == EMPTY_SLOT) // a dead end of the corpus
+    {
+      break;
+    }
+    data = (void *) compiled_node_data (compiled, (uint32_t) id);
+    markov_chain->print_func (data);
+    if (markov_chain->is_last (data))
     {
-      return node_ptr;
+      break;
     }
-    node_ptr = node_ptr->next;
   }
-  return node_ptr; //node_ptr should be NULL
 }
 
-Node* add_to_database(MarkovChain *markov_chain, void *data_ptr)
+bool save_markov_chain(const MarkovChain *markov_chain, const char *path)
 {
-  Node *node_ptr = get_node_from_database (markov_chain, data_ptr);
-  if (node_ptr != NULL)
+  // a loaded or frozen chain whose image holds it's data is saved as is
+  if (is_compiled_current (markov_chain)
+      && markov_chain->compiled->node_data == NULL)
   {
-    return node_ptr;
+    return save_compiled_chain (markov_chain->compiled, path) == 0;
   }
-  MarkovNode *markov_node = malloc (sizeof (MarkovNode));
-  NextNodeCounter **counter_list = malloc (sizeof (NextNodeCounter[1]));
-//  NextNodeCounter *next_node_counter = malloc (sizeof (NextNodeCounter));
-  if (markov_node == NULL || counter_list == NULL ||
-      add (markov_chain->database, markov_node) == 1)
+  if (markov_chain->size_func == NULL)
   {
-    return NULL;
+    return false;
   }
-  void *temp = markov_chain->copy_func (data_ptr);
-  markov_node->data = temp;
-  temp = NULL;
-  markov_node->counter_list_size = 0;
-  markov_node->counter_list_full_size = 0;
-  markov_node->counter_list = counter_list;
-  if (markov_chain->is_last (data_ptr))
+  CompiledChain *compiled = compile_markov_chain (markov_chain,
+                                                  markov_chain->frozen,
+                                                  markov_chain->hot_order);
+  if (compiled == NULL)
   {
-    *markov_node->counter_list = NULL;
+    return false;
   }
-  else
+  bool saved = save_compiled_chain (compiled, path) == 0;
+  free_compiled_chain (&compiled);
+  return saved;
+}
+
+bool load_markov_chain(MarkovChain *markov_chain, const char *path)
+{
+  CompiledChain *compiled = load_compiled_chain (path);
+  if (compiled == NULL)
+  {
+    return false;
+  }
+  compiled->source_version = markov_chain->version;
+  free_compiled_chain (&markov_chain->compiled);
+  markov_chain->compiled = compiled;
+  return true;
+}
+
+bool freeze_markov_chain(MarkovChain *markov_chain)
+{
+  // a loaded image is all there is of the chain, keep it
+  if (is_compiled_current (markov_chain)
+      && (markov_chain->compiled->mapped
+          || markov_chain->compiled->alias_threshold != NULL))
+  {
+    markov_chain->frozen = true;
+    return true;
+  }
+  CompiledChain *compiled = compile_markov_chain (markov_chain, true,
+                                                  markov_chain->hot_order);
+  if (compiled == NULL)
   {
-    markov_node->counter_list[0] = NULL;
+    return false;
   }
-  return markov_chain->database->last;
+  compiled->source_version = markov_chain->version;
+  free_compiled_chain (&markov_chain->compiled);
+  markov_chain->compiled = compiled;
+  markov_chain->frozen = true;
+  return true;
+}
+
+
+/**
+ * Receive markov_chain, generate and print random sentence out of it. The
+ * sentence most have at least 2 words in it.
+ * @param markov_chain pointer to MarkovChain
+ * @param first_node markov_node to start with,
+ *                   if NULL- choose a random markov_node
+ * @param  max_length maximum length of chain to generate
+ */
+void generate_random_sequence(MarkovChain *markov_chain, MarkovNode *
+first_node, int max_length)
+{
+  generate_random_sequence_from (markov_chain, first_node, max_length, NULL);
+}
+
+void generate_random_sequence_from (MarkovChain *markov_chain,
+                                    MarkovNode *first_node, int max_length,
+                                    Rng *rng)
+{
+  rng = rng != NULL ? rng : &markov_chain->rng;
+  if (is_compiled_current (markov_chain))
+  {
+    const uint32_t *ids = markov_chain->compiled->ids;
+    long first_id = first_node == NULL
+                    ? first_compiled_node (markov_chain, rng)
+                    : ids != NULL ? ids[first_node->id]
+                    : (uint32_t) first_node->id;
+    if (first_id != EMPTY_SLOT)
+    {
+      generate_compiled_sequence (markov_chain, first_id, max_length, rng);
+    }
+    return;
+  }
+  if (first_node == NULL)
+  {
+    first_node = first_random_node (markov_chain, rng);
+    if (first_node == NULL)
+    {
+      return;
+    }
+  }
+  MarkovNode *cur_node = first_node;
+  print_first (markov_chain, cur_node->data);
+  for (int i = 0; i < max_length-1; i++)
+  {
+    if (cur_node->counter_list_size == 0) // a dead end of the corpus
+    {
+      break;
+    }
+    cur_node = next_node (markov_chain, cur_node, rng);
+    if (!markov_chain->is_last (cur_node->data))
+    {
+      markov_chain->print_func (cur_node->data);
+    }
+    else
+    {
+      markov_chain->print_func (cur_node->data);
+      break;
+    }
+  }
+}
+
+bool generate_sequence_into (MarkovChain *markov_chain,
+                             MarkovNode *first_node, int max_length,
+                             Rng *rng, void **out, int *out_len)
+{
+  return generic_generate_into (markov_chain, first_node, max_length, rng,
+                                out, out_len);
+}
+
+bool generate_strings_into (MarkovChain *markov_chain,
+                            MarkovNode *first_node, int max_length,
+                            Rng *rng, const InternedStr **out, int *out_len)
+{
+  return string_generate_into (markov_chain, first_node, max_length, rng,
+                               out, out_len);
+}
+
+/**
+ * Free markov_chain and all of it's content from memory, if it isn't NULL
+ * @param markov_chain markov_chain to free
+ */
+void free_markov_chain(MarkovChain ** ptr_chain)
+{
+  if (*ptr_chain == NULL)
+  {
+    return;
+  }
+  bool owns_copies = (*ptr_chain)->copy_func != NULL
+                     && (*ptr_chain)->free_data != NULL;
+  for (Node *node_ptr = (*ptr_chain)->database->first; node_ptr != NULL;
+       node_ptr = node_ptr->next)
+  {
+    free_alias_table (&node_ptr->data->alias_table);
+    if (owns_copies)
+    {
+      (*ptr_chain)->free_data (node_ptr->data->data);
+    }
+  }
+  free_arena (&(*ptr_chain)->arena); // nodes, counter lists and copies
+  free ((*ptr_chain)->database);
+  (*ptr_chain)->database = NULL;
+  free_hash_index (&(*ptr_chain)->index);
+  free ((*ptr_chain)->start_nodes);
+  (*ptr_chain)->start_nodes = NULL;
+  free_alias_table (&(*ptr_chain)->start_alias_table);
+  free_compiled_chain (&(*ptr_chain)->compiled);
+  free_score_table (&(*ptr_chain)->score_table);
+  if ((*ptr_chain)->approximate != NULL)
+  {
+    free_count_min (&(*ptr_chain)->approximate->edges);
+    free ((*ptr_chain)->approximate);
+  }
+  free (*ptr_chain);
+  *ptr_chain = NULL;
+}
+
+/**
+ * Hashes a MarkovNode by it's address.
+ */
+static size_t hash_node_ptr (const MarkovNode *markov_node)
+{
+  unsigned long long hash = (unsigned long long) (uintptr_t) markov_node
+                            * POINTER_HASH_MULTIPLIER;
+  return (size_t) (hash ^ (hash >> POINTER_HASH_SHIFT));
+}
+
+static int find_counter (const MarkovNode *first_node,
+                         const MarkovNode *second_node)
+{
+  if (first_node->counter_index == NULL)
+  {
+    for (int i = 0; i < first_node->counter_list_size; i++)
+    {
+      if (first_node->counter_list[i].markov_node == second_node)
+      {
+        return i;
+      }
+    }
+    return EMPTY_SLOT;
+  }
+  size_t mask = (size_t) first_node->counter_index_capacity - 1;
+  for (size_t slot = hash_node_ptr (second_node) & mask;
+       first_node->counter_index[slot] != EMPTY_SLOT; slot = (slot + 1) & mask)
+  {
+    int ind = first_node->counter_index[slot];
+    if (first_node->counter_list[ind].markov_node == second_node)
+    {
+      return ind;
+    }
+  }
+  return EMPTY_SLOT;
+}
+
+static bool index_counter (MarkovNode *markov_node, int ind, Arena *arena)
+{
+  // keep the index at most half full, rebuild it from the list when growing
+  if (markov_node->counter_index_capacity < 2 * (ind + 1))
+  {
+    int new_capacity = markov_node->counter_index_capacity == 0
+                       ? 2 * COUNTER_INDEX_THRESHOLD
+                       : markov_node->counter_index_capacity * GROWTH_FACTOR;
+    while (new_capacity < 2 * (ind + 1))
+    {
+      new_capacity *= GROWTH_FACTOR;
+    }
+    int *temp = arena_resize_array
+        (arena, markov_node->counter_index,
+         sizeof (int) * markov_node->counter_index_capacity,
+         sizeof (int) * new_capacity);
+    if (temp == NULL)
+    {
+      return false;
+    }
+    markov_node->counter_index = temp;
+    markov_node->counter_index_capacity = new_capacity;
+    for (int i = 0; i < new_capacity; i++)
+    {
+      markov_node->counter_index[i] = EMPTY_SLOT;
+    }
+    for (int i = 0; i < ind; i++)
+    {
+      index_counter (markov_node, i, arena); // fits, can't fail
+    }
+  }
+  size_t mask = (size_t) markov_node->counter_index_capacity - 1;
+  size_t slot = hash_node_ptr (markov_node->counter_list[ind].markov_node)
+                & mask;
+  while (markov_node->counter_index[slot] != EMPTY_SLOT)
+  {
+    slot = (slot + 1) & mask;
+  }
+  markov_node->counter_index[slot] = ind;
+  return true;
+}
+
+bool
+is_node_in_counter_list (const MarkovNode *first_node, MarkovNode
+*second_node)
+{
+  int ind = find_counter (first_node, second_node);
+  if (ind == EMPTY_SLOT)
+  {
+    return false;
+  }
+  first_node->counter_list[ind].frequency++;
+  return true;
+}
+
+/**
+ * Add the second markov_node to the counter list of the first markov_node.
+ * If already in list, update it's counter value.
+ * @param first_node
+ * @param second_node
+ * @param markov_chain
+ * @return success/failure: true if the process was successful, false if in
+ * case of allocation error.
+ */
+bool add_node_to_counter_list(MarkovNode *first_node, MarkovNode
+*second_node, MarkovChain *markov_chain)
+{
+  return generic_add_transition (first_node, second_node, markov_chain);
+}
+
+bool add_string_to_counter_list (MarkovNode *first_node,
+                                 MarkovNode *second_node,
+                                 MarkovChain *markov_chain)
+{
+  return string_add_transition (first_node, second_node, markov_chain);
+}
+
+static bool add_approximate_counter (MarkovChain *markov_chain,
+                                     MarkovNode *first_node,
+                                     MarkovNode *second_node)
+{
+  ApproxTraining *approximate = markov_chain->approximate;
+  uint64_t key = ((uint64_t) (uint32_t) first_node->id << EDGE_KEY_SHIFT)
+                 | (uint32_t) second_node->id;
+  uint32_t count = count_min_add (approximate->edges, key, 1);
+  int ind = find_counter (first_node, second_node);
+  int frequency = ind != EMPTY_SLOT ? 1
+                  : count >= (uint32_t) approximate->promote_threshold
+                  ? (int) count : 0;
+  if (frequency > 0)
+  {
+    if (!add_to_counter (markov_chain, first_node, second_node, frequency))
+    {
+      return false;
+    }
+    first_node->counter_list_full_size += frequency;
+  }
+  approximate->transitions++;
+  if (approximate->prune_every > 0
+      && approximate->transitions % approximate->prune_every == 0)
+  {
+    prune_counters (markov_chain, ++approximate->rounds);
+  }
+  return true;
+}
+
+static void prune_counters (MarkovChain *markov_chain, int max_frequency)
+{
+  markov_chain->version++;
+  for (Node *node_ptr = markov_chain->database->first; node_ptr != NULL;
+       node_ptr = node_ptr->next)
+  {
+    MarkovNode *markov_node = node_ptr->data;
+    int size = 0;
+    for (int i = 0; i < markov_node->counter_list_size; i++)
+    {
+      NextNodeCounter counter = markov_node->counter_list[i];
+      if (counter.frequency <= max_frequency)
+      {
+        markov_node->counter_list_full_size -= counter.frequency;
+        continue;
+      }
+      markov_node->counter_list[size++] = counter;
+    }
+    if (size == markov_node->counter_list_size)
+    {
+      continue;
+    }
+    markov_node->counter_list_size = size;
+    free_alias_table (&markov_node->alias_table);
+    if (markov_node->counter_index != NULL) // big enough, the same slots
+    {
+      for (int i = 0; i < markov_node->counter_index_capacity; i++)
+      {
+        markov_node->counter_index[i] = EMPTY_SLOT;
+      }
+      for (int i = 0; i < size; i++)
+      {
+        index_counter (markov_node, i, markov_chain->arena);
+      }
+    }
+  }
+  remove_dead_starts (markov_chain);
+}
+
+static void remove_dead_starts (MarkovChain *markov_chain)
+{
+  int size = 0;
+  for (int i = 0; i < markov_chain->start_nodes_size; i++)
+  {
+    MarkovNode *markov_node = markov_chain->start_nodes[i];
+    if (markov_node->counter_list_size == 0)
+    {
+      markov_chain->start_occurrences -= markov_node->occurrences;
+      continue;
+    }
+    markov_chain->start_nodes[size++] = markov_node;
+  }
+  if (size != markov_chain->start_nodes_size)
+  {
+    markov_chain->start_nodes_size = size;
+    free_alias_table (&markov_chain->start_alias_table);
+  }
+}
+
+bool start_approximate_training(MarkovChain *markov_chain,
+                                size_t sketch_bytes, int promote_threshold,
+                                long prune_every)
+{
+  ApproxTraining *approximate = malloc (sizeof (ApproxTraining));
+  CountMinSketch *edges = create_count_min (sketch_bytes);
+  if (approximate == NULL || edges == NULL)
+  {
+    free (approximate);
+    free_count_min (&edges);
+    return false;
+  }
+  *approximate = (ApproxTraining) {edges, promote_threshold, prune_every, 0,
+                                   0};
+  markov_chain->approximate = approximate;
+  return true;
+}
+
+static bool add_to_counter (MarkovChain *markov_chain, MarkovNode *first_node,
+                            MarkovNode *second_node, int frequency)
+{
+  markov_chain->version++;
+  int ind = find_counter (first_node, second_node);
+  if (ind != EMPTY_SLOT)
+  {
+    first_node->counter_list[ind].frequency
+        = saturating_add (first_node->counter_list[ind].frequency, frequency);
+    return true;
+  }
+  if (first_node->counter_list_size == first_node->counter_list_capacity)
+  {
+    int new_capacity = first_node->counter_list_capacity == 0
+                       ? COUNTER_LIST_INITIAL_CAPACITY
+                       : first_node->counter_list_capacity * GROWTH_FACTOR;
+    NextNodeCounter *temp = arena_resize_array
+        (markov_chain->arena, first_node->counter_list,
+         sizeof (NextNodeCounter) * first_node->counter_list_capacity,
+         sizeof (NextNodeCounter) * new_capacity);
+    if (temp == NULL)
+    {
+      return false;
+    }
+    first_node->counter_list = temp;
+    first_node->counter_list_capacity = new_capacity;
+  }
+  ind = first_node->counter_list_size;
+  if (ind == 0 && !add_start_node (markov_chain, first_node))
+  {
+    return false;
+  }
+  first_node->counter_list[ind] = (NextNodeCounter) {second_node, frequency};
+  if (ind >= COUNTER_INDEX_THRESHOLD
+      && !index_counter (first_node, ind, markov_chain->arena))
+  {
+    return false;
+  }
+  first_node->counter_list_size++;
+  return true;
+}
+
+static bool build_index (MarkovChain *markov_chain)
+{
+  if (markov_chain->index != NULL)
+  {
+    return true;
+  }
+  markov_chain->index = create_hash_index ();
+  if (markov_chain->index == NULL)
+  {
+    return false;
+  }
+  for (Node *node_ptr = markov_chain->database->first; node_ptr != NULL;
+       node_ptr = node_ptr->next)
+  {
+    if (hash_index_insert (markov_chain->index,
+                           markov_chain->hash_func (node_ptr->data->data),
+                           node_ptr) != 0)
+    {
+      free_hash_index (&markov_chain->index);
+      return false;
+    }
+  }
+  return true;
+}
+
+Node* get_node_from_database(MarkovChain *markov_chain, void *data_ptr)
+{
+  return generic_find_state (markov_chain, data_ptr);
+}
+
+Node *get_string_from_database (MarkovChain *markov_chain,
+                                const InternedStr *string)
+{
+  return string_find_state (markov_chain, string);
+}
+
+Node* add_to_database(MarkovChain *markov_chain, void *data_ptr)
+{
+  return generic_find_or_add (markov_chain, data_ptr, 1);
+}
+
+Node *add_string_to_database (MarkovChain *markov_chain,
+                              const InternedStr *string)
+{
+  return string_find_or_add (markov_chain, string, 1);
+}
+
+static int scale_count (int count, double weight)
+{
+  if (count == 0)
+  {
+    return 0;
+  }
+  // clamped before it's rounded, lround is undefined past LONG_MAX
+  double scaled = count * weight;
+  if (scaled >= INT_MAX)
+  {
+    return INT_MAX;
+  }
+  long rounded = lround (scaled);
+  return rounded < 1 ? 1 : (int) rounded;
+}
+
+static int saturating_add (int count, int added)
+{
+  return count > INT_MAX - added ? INT_MAX : count + added;
+}
+
+bool merge_markov_chain_into(MarkovChain *dst, MarkovChain *src)
+{
+  return merge_weighted (dst, src, 1);
+}
+
+static bool merge_weighted (MarkovChain *dst, MarkovChain *src,
+                            double weight)
+{
+  if (dst->approximate != NULL || src->approximate != NULL)
+  {
+    return false; // their sketches can't be merged
+  }
+  // src states by id -> the dst states they are unified with
+  MarkovNode **dst_nodes = malloc (sizeof (MarkovNode *)
+                                   * (src->database->size + 1));
+  if (dst_nodes == NULL)
+  {
+    return false;
+  }
+  for (Node *node_ptr = src->database->first; node_ptr != NULL;
+       node_ptr = node_ptr->next)
+  {
+    Node *dst_node = generic_find_or_add
+        (dst, node_ptr->data->data,
+         scale_count (node_ptr->data->occurrences, weight));
+    if (dst_node == NULL)
+    {
+      free (dst_nodes);
+      return false;
+    }
+    dst_nodes[node_ptr->data->id] = dst_node->data;
+  }
+  for (Node *node_ptr = src->database->first; node_ptr != NULL;
+       node_ptr = node_ptr->next)
+  {
+    MarkovNode *src_node = node_ptr->data;
+    MarkovNode *dst_node = dst_nodes[src_node->id];
+    int full_size = 0;
+    for (int i = 0; i < src_node->counter_list_size; i++)
+    {
+      NextNodeCounter *counter = &src_node->counter_list[i];
+      int frequency = scale_count (counter->frequency, weight);
+      if (!add_to_counter (dst, dst_node,
+                           dst_nodes[counter->markov_node->id], frequency))
+      {
+        free (dst_nodes);
+        return false;
+      }
+      full_size = saturating_add (full_size, frequency);
+    }
+    // the scaled size of a state with no counters (a last state) is kept
+    // all the same
+    dst_node->counter_list_full_size = saturating_add
+        (dst_node->counter_list_full_size, src_node->counter_list_size > 0
+         ? full_size : scale_count (src_node->counter_list_full_size, weight));
+  }
+  free (dst_nodes);
+  return true;
+}
+
+MarkovChain *merge_markov_chains(MarkovChain *const chains[],
+                                 const double weights[], int num_of_chains)
+{
+  if (num_of_chains < 1)
+  {
+    return NULL;
+  }
+  for (int i = 0; i < num_of_chains; i++)
+  {
+    if (!(weights[i] >= 0) || chains[i]->approximate != NULL)
+    {
+      return NULL;
+    }
+  }
+  const MarkovChain *first = chains[0];
+  LinkedList *database = calloc (1, sizeof (LinkedList));
+  MarkovChain *merged = calloc (1, sizeof (MarkovChain));
+  if (database == NULL || merged == NULL)
+  {
+    free (database);
+    free (merged);
+    return NULL;
+  }
+  *merged = (MarkovChain) {.database = database,
+                           .print_func = first->print_func,
+                           .comp_func = first->comp_func,
+                           .free_data = first->free_data,
+                           .copy_func = first->copy_func,
+                           .is_last = first->is_last,
+                           .hash_func = first->hash_func,
+                           .size_func = first->size_func,
+                           .print_first_func = first->print_first_func,
+                           .hot_order = first->hot_order,
+                           .weighted_start = first->weighted_start};
+  for (int i = 0; i < num_of_chains; i++)
+  {
+    if (weights[i] > 0 && !merge_weighted (merged, chains[i], weights[i]))
+    {
+      free_markov_chain (&merged);
+      return NULL;
+    }
+  }
+  return merged;
+}
+
+static bool prepare_mixed (MarkovChain *markov_chain, bool weighted_start)
+{
+  if ((markov_chain->hash_func != NULL && !build_index (markov_chain))
+      || (weighted_start && markov_chain->start_nodes_size > 0
+          && !update_start_alias_table (markov_chain)))
+  {
+    return false;
+  }
+  if (is_compiled_current (markov_chain))
+  {
+    return true;
+  }
+  for (Node *node_ptr = markov_chain->database->first; node_ptr != NULL;
+       node_ptr = node_ptr->next)
+  {
+    if (node_ptr->data->counter_list_size > 0
+        && !update_alias_table (node_ptr->data))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+MixtureChain *create_mixture_chain(MarkovChain *const chains[],
+                                   const double weights[], int num_of_chains)
+{
+  if (num_of_chains < 1 || num_of_chains > MAX_MIXED_CHAINS)
+  {
+    return NULL;
+  }
+  for (int i = 0; i < num_of_chains; i++)
+  {
+    if (!(weights[i] >= 0) || !chains[i]->frozen
+        || !prepare_mixed (chains[i], chains[0]->weighted_start))
+    {
+      return NULL;
+    }
+  }
+  MixtureChain *mixture = malloc (sizeof (MixtureChain));
+  MarkovChain **chains_copy = malloc (sizeof (MarkovChain *) * num_of_chains);
+  double *weights_copy = malloc (sizeof (double) * num_of_chains);
+  if (mixture == NULL || chains_copy == NULL || weights_copy == NULL)
+  {
+    free (mixture);
+    free (chains_copy);
+    free (weights_copy);
+    return NULL;
+  }
+  memcpy (chains_copy, chains, sizeof (MarkovChain *) * num_of_chains);
+  memcpy (weights_copy, weights, sizeof (double) * num_of_chains);
+  *mixture = (MixtureChain) {chains_copy, weights_copy, num_of_chains};
+  return mixture;
+}
+
+static int draw_mixed (const double weights[], int num_of_chains,
+                       double total, Rng *rng)
+{
+  if (!(total > 0))
+  {
+    return -1;
+  }
+  double draw = rng_uniform (rng) * total;
+  int last = -1;
+  for (int i = 0; i < num_of_chains; i++)
+  {
+    if (weights[i] <= 0)
+    {
+      continue;
+    }
+    last = i;
+    draw -= weights[i];
+    if (draw < 0)
+    {
+      return i;
+    }
+  }
+  return last; // draw was rounded up to total
+}
+
+static void *first_mixed_data (const MixtureChain *mixture, Rng *rng)
+{
+  double weights[MAX_MIXED_CHAINS];
+  double total = 0;
+  bool weighted_start = mixture->chains[0]->weighted_start;
+  for (int i = 0; i < mixture->num_of_chains; i++)
+  {
+    const MarkovChain *markov_chain = mixture->chains[i];
+    weights[i] = mixture->weights[i] <= 0 ? 0
+                 : weighted_start ? mixture->weights[i]
+                                    * (double) markov_chain->start_occurrences
+                 : markov_chain->start_nodes_size;
+    total += weights[i];
+  }
+  while (true)
+  {
+    int ind = draw_mixed (weights, mixture->num_of_chains, total, rng);
+    if (ind < 0)
+    {
+      return NULL;
+    }
+    MarkovChain *markov_chain = mixture->chains[ind];
+    if (weighted_start)
+    {
+      return markov_chain->start_nodes[draw_alias
+          (markov_chain->start_alias_table, rng)]->data;
+    }
+    // uniform over the union of the first states: a state of many chains
+    // is only taken from the first of them
+    void *data = markov_chain->start_nodes[draw_number
+        (rng, markov_chain->start_nodes_size)]->data;
+    bool taken = true;
+    for (int i = 0; i < ind && taken; i++)
+    {
+      Node *node_ptr = get_node_from_database (mixture->chains[i], data);
+      taken = weights[i] <= 0 || node_ptr == NULL
+              || node_ptr->data->counter_list_size == 0;
+    }
+    if (taken)
+    {
+      return data;
+    }
+  }
+}
+
+static void *next_mixed_data (const MixtureChain *mixture, void *data,
+                              Rng *rng)
+{
+  double weights[MAX_MIXED_CHAINS];
+  MarkovNode *nodes[MAX_MIXED_CHAINS];
+  double total = 0;
+  for (int i = 0; i < mixture->num_of_chains; i++)
+  {
+    Node *node_ptr = mixture->weights[i] <= 0 ? NULL
+                     : get_node_from_database (mixture->chains[i], data);
+    nodes[i] = node_ptr != NULL ? node_ptr->data : NULL;
+    weights[i] = nodes[i] == NULL || nodes[i]->counter_list_size == 0 ? 0
+                 : mixture->weights[i] * nodes[i]->counter_list_full_size;
+    total += weights[i];
+  }
+  int ind = draw_mixed (weights, mixture->num_of_chains, total, rng);
+  if (ind < 0)
+  {
+    return NULL;
+  }
+  MarkovChain *markov_chain = mixture->chains[ind];
+  if (!is_compiled_current (markov_chain))
+  {
+    return next_node (markov_chain, nodes[ind], rng)->data;
+  }
+  const CompiledChain *compiled = markov_chain->compiled;
+  uint32_t id = compiled->ids != NULL ? compiled->ids[nodes[ind]->id]
+                                      : (uint32_t) nodes[ind]->id;
+  long next_id = next_compiled_node (compiled, id, rng);
+  return (void *) compiled_node_data (compiled, (uint32_t) next_id);
+}
+
+bool generate_mixture_into(const MixtureChain *mixture, int max_length,
+                           Rng *rng, void **out, int *out_len)
+{
+  const MarkovChain *first = mixture->chains[0];
+  *out_len = 0;
+  void *data = first_mixed_data (mixture, rng);
+  while (data != NULL && *out_len < max_length)
+  {
+    out[(*out_len)++] = data;
+    if (*out_len > 1 && first->is_last (data))
+    {
+      break;
+    }
+    data = next_mixed_data (mixture, data, rng);
+  }
+  return *out_len > 0;
+}
+
+void free_mixture_chain(MixtureChain **mixture)
+{
+  if (*mixture == NULL)
+  {
+    return;
+  }
+  free ((*mixture)->chains);
+  free ((*mixture)->weights);
+  free (*mixture);
+  *mixture = NULL;
+}
+
+static bool update_score_table (MarkovChain *markov_chain, double smoothing)
+{
+  ScoreTable *table = markov_chain->score_table;
+  if (table != NULL && table->source_version == markov_chain->version
+      && table->smoothing == smoothing)
+  {
+    return true;
+  }
+  free_score_table (&markov_chain->score_table);
+  size_t num_of_transitions = 0;
+  for (Node *node_ptr = markov_chain->database->first; node_ptr != NULL;
+       node_ptr = node_ptr->next)
+  {
+    num_of_transitions += (size_t) node_ptr->data->counter_list_size;
+  }
+  int num_of_states = markov_chain->database->size;
+  table = create_score_table (num_of_transitions, num_of_states);
+  if (table == NULL)
+  {
+    return false;
+  }
+  double smoothed_states = smoothing * num_of_states;
+  for (Node *node_ptr = markov_chain->database->first; node_ptr != NULL;
+       node_ptr = node_ptr->next)
+  {
+    MarkovNode *markov_node = node_ptr->data;
+    double total = markov_node->counter_list_full_size + smoothed_states;
+    table->unseen_log_probs[markov_node->id] =
+        smoothing > 0 ? log (smoothing / total) : -INFINITY;
+    for (int i = 0; i < markov_node->counter_list_size; i++)
+    {
+      NextNodeCounter *counter = &markov_node->counter_list[i];
+      score_table_insert (table, (uint32_t) markov_node->id,
+                          (uint32_t) counter->markov_node->id,
+                          log ((counter->frequency + smoothing) / total));
+    }
+  }
+  // the row of a state not in the chain
+  table->unseen_log_probs[num_of_states] =
+      smoothing > 0 && num_of_states > 0 ? -log (num_of_states) : -INFINITY;
+  table->smoothing = smoothing;
+  table->source_version = markov_chain->version;
+  markov_chain->score_table = table;
+  return true;
+}
+
+static void *score_range (void *arg)
+{
+  ScoreWorker *worker = arg;
+  MarkovChain *markov_chain = worker->markov_chain;
+  const ScoreTable *table = markov_chain->score_table;
+  for (int i = worker->first; i < worker->last; i++)
+  {
+    double log_prob = 0;
+    void **sequence = worker->sequences[i];
+    Node *from = NULL;
+    if (worker->lengths[i] > 0)
+    {
+      from = get_node_from_database (markov_chain, sequence[0]);
+    }
+    for (int j = 1; j < worker->lengths[i]; j++)
+    {
+      Node *to = get_node_from_database (markov_chain, sequence[j]);
+      if (markov_chain->is_last (sequence[j - 1]))
+      {
+        from = to; // a new sequence starts, it's first state isn't scored
+        continue;
+      }
+      if (from == NULL)
+      {
+        log_prob += table->unseen_log_probs[table->num_of_states];
+      }
+      else if (to == NULL)
+      {
+        log_prob += table->unseen_log_probs[from->data->id];
+      }
+      else
+      {
+        log_prob += score_table_find (table, (uint32_t) from->data->id,
+                                      (uint32_t) to->data->id);
+      }
+      from = to;
+    }
+    worker->log_probs[i] = log_prob;
+  }
+  return NULL;
+}
+
+bool score_sequences(MarkovChain *markov_chain, void **const sequences[],
+                     const int lengths[], int num_of_sequences,
+                     double smoothing, int num_of_threads, double log_probs[])
+{
+  // the lazy parts are built here, the threads only read the chain
+  if ((markov_chain->hash_func != NULL && !build_index (markov_chain))
+      || !update_score_table (markov_chain, smoothing))
+  {
+    return false;
+  }
+  if (num_of_threads <= 0 || num_of_threads > MAX_SCORE_THREADS)
+  {
+    long num_of_cpus = sysconf (_SC_NPROCESSORS_ONLN);
+    num_of_threads = num_of_cpus < 1 ? 1 : num_of_cpus < MAX_SCORE_THREADS
+                                           ? (int) num_of_cpus
+                                           : MAX_SCORE_THREADS;
+  }
+  if (num_of_threads > num_of_sequences)
+  {
+    num_of_threads = num_of_sequences > 0 ? num_of_sequences : 1;
+  }
+  ScoreWorker workers[MAX_SCORE_THREADS];
+  pthread_t threads[MAX_SCORE_THREADS];
+  bool started[MAX_SCORE_THREADS] = {false};
+  for (int i = 0; i < num_of_threads; i++)
+  {
+    workers[i] = (ScoreWorker) {
+        markov_chain, sequences, lengths,
+        (int) ((long) num_of_sequences * i / num_of_threads),
+        (int) ((long) num_of_sequences * (i + 1) / num_of_threads),
+        log_probs};
+  }
+  for (int i = 1; i < num_of_threads; i++)
+  {
+    started[i] = pthread_create (&threads[i], NULL, score_range,
+                                 &workers[i]) == 0;
+  }
+  score_range (&workers[0]);
+  for (int i = 1; i < num_of_threads; i++)
+  {
+    if (started[i])
+    {
+      pthread_join (threads[i], NULL);
+    }
+    else
+    {
+      score_range (&workers[i]); // scored here if it's thread didn't start
+    }
+  }
+  return true;
 }
\ No newline at end of file
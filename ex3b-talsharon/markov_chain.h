@@ -1,7 +1,14 @@
 #ifndef MARKOV_CHAIN_H
 #define MARKOV_CHAIN_H
 #include "linked_list.h"
-#include "linked_list.h"
+#include "hash_index.h"
+#include "alias_table.h"
+#include "arena.h"
+#include "compiled_chain.h"
+#include "rng.h"
+#include "count_min.h"
+#include "score_table.h"
+#include "string_pool.h"
 #include <stdio.h>  // For printf(), sscanf()
 #include <stdlib.h> // For exit(), malloc()
 #include <stdbool.h> // for bool
@@ -9,6 +16,8 @@
 #define ALLOCATION_ERROR_MASSAGE \
 "Allocation failure: Failed to allocate new memory\n"
 
+#define MAX_MIXED_CHAINS 64
+
 
 /***************************/
 /*   insert typedefs here  */
@@ -24,6 +33,10 @@ typedef void* (*GenericCopy)(const void *data);
 
 typedef bool (*GenericIsLast)(void *data);
 
+typedef size_t (*GenericHash)(const void *data);
+
+typedef size_t (*GenericSize)(const void *data);
+
 /***************************/
 
 
@@ -32,18 +45,38 @@ typedef bool (*GenericIsLast)(void *data);
 /*        STRUCTS          */
 /***************************/
 
+typedef struct NextNodeCounter {
+    struct MarkovNode *markov_node;
+    int frequency;
+} NextNodeCounter;
+
 typedef struct MarkovNode {
     void *data;
-    struct NextNodeCounter **counter_list;
+    NextNodeCounter *counter_list; // inline array, grown by doubling
     int counter_list_size; // num of NextNodeCounter in list
+    int counter_list_capacity; // num of NextNodeCounter allocated
     int counter_list_full_size; // size including frequencies
-
+    // hash index of counter_list by markov_node (indices, -1 for an empty
+    // slot), built once the list is long enough to make scanning it slow
+    int *counter_index;
+    int counter_index_capacity;
+    // alias table over counter_list frequencies, used in frozen mode while
+    // the chain's compiled image is stale
+    AliasTable *alias_table;
+    int occurrences; // num of times the state was added to the database
+    int id; // position of the state in the database
 } MarkovNode;
 
-typedef struct NextNodeCounter {
-    MarkovNode *markov_node;
-    int frequency;
-} NextNodeCounter;
+/**
+ * State of a chain's approximate training, see start_approximate_training.
+ */
+typedef struct ApproxTraining {
+    CountMinSketch *edges; // occurrences of all the transitions
+    int promote_threshold; // occurrences that make a transition a counter
+    long prune_every; // transitions in a lossy counting round
+    long transitions; // num of transitions trained
+    int rounds; // num of lossy counting rounds done
+} ApproxTraining;
 
 /* DO NOT ADD or CHANGE variable names in this struct */
 typedef struct MarkovChain {
@@ -75,22 +108,142 @@ typedef struct MarkovChain {
     //      - true if it's the last state.
     //      - false otherwise.
     GenericIsLast is_last;
+
+    // optional: a pointer to a function that gets a pointer of generic data
+    //    type and returns a hash value of it, equal data must have equal
+    //    hash values. When given, the database is indexed by it and states
+    //    are looked up in O(1) instead of scanning the whole list.
+    GenericHash hash_func;
+
+    // index of the database by hash_func, maintained by the chain.
+    HashIndex *index;
+
+    // optional: a pointer to a function that gets a pointer of generic data
+    //    type with no pointers in it and returns it's size in bytes.
+    //    When given and copy_func is NULL, the chain copies states into it's
+    //    arena by it, and free_data isn't used.
+    GenericSize size_func;
+
+    // optional: a pointer to a function that prints the first state of a
+    //    sequence, print_func is used if it's NULL. For states that print
+    //    more than their own part, like the words of an order-k state.
+    GenericPrint print_first_func;
+
+    // arena all of the chain's nodes, counter lists and state copies are
+    // allocated from, released at once by free_markov_chain.
+    Arena *arena;
+
+    // true after freeze_markov_chain: next states are sampled from alias
+    // tables in O(1).
+    bool frozen;
+
+    // set to true to have freeze_markov_chain number the compiled states by
+    // how often they occurred, so the hot ones are next to each other.
+    bool hot_order;
+
+    // num of changes made to the chain, a compiled image of an older
+    // version is stale and isn't used.
+    unsigned long version;
+
+    // dense array of the non terminal states in database order, a random
+    // first state is a single lookup in it. Maintained by the chain.
+    MarkovNode **start_nodes;
+    int start_nodes_size;
+    int start_nodes_capacity;
+    long start_occurrences; // sum of occurrences of start_nodes
+
+    // set to true to choose the first state by how often it occurred
+    // instead of uniformly.
+    bool weighted_start;
+    AliasTable *start_alias_table; // over start_nodes occurrences
+
+    // set by freeze_markov_chain and load_markov_chain: while it's up to
+    // date the chain is generated from this image. A loaded chain's
+    // database is left empty.
+    CompiledChain *compiled;
+
+    // the stream the chain's random choices are drawn from. Left zero it
+    // draws from rand(), the sequence srand seeds; set it to rng_seed (seed)
+    // for a faster, unbiased xoshiro256** stream.
+    Rng rng;
+
+    // set by start_approximate_training, NULL for exact training.
+    ApproxTraining *approximate;
+
+    // log-probabilities of the transitions, built by score_sequences for
+    // it's smoothing and rebuilt once the chain changes.
+    ScoreTable *score_table;
 } MarkovChain;
 
 /**
- * Get one random state from the given markov_chain's database.
+ * A weighted mixture of trained chains, generated from without merging
+ * them, see create_mixture_chain.
+ */
+typedef struct MixtureChain {
+    MarkovChain **chains;
+    double *weights;
+    int num_of_chains;
+} MixtureChain;
+
+/**
+ * Get one random non terminal state from the given markov_chain's database.
+ * The state is chosen uniformly, or by it's occurrences if the chain's
+ * weighted_start is set.
  * @param markov_chain
- * @return
+ * @return MarkovNode of the chosen state, NULL if there is no such state
  */
 MarkovNode* get_first_random_node(MarkovChain *markov_chain);
 
 /**
  * Choose randomly the next state, depend on it's occurrence frequency.
+ * The node doesn't know it's chain, so the choice is drawn from rand().
  * @param state_struct_ptr MarkovNode to choose from
  * @return MarkovNode of the chosen state
  */
 MarkovNode* get_next_random_node(MarkovNode *state_struct_ptr);
 
+/**
+ * Switch markov_chain to frozen sampling mode: compile the chain to
+ * contiguous arrays (see CompiledChain) with an alias table over the
+ * successors of every state, so a random walk reads a few adjacent arrays
+ * and choosing the next state costs one random draw and one comparison.
+ * If the chain changes after freezing, the image is stale and the chain is
+ * walked by it's nodes again, each state's alias table rebuilt on the next
+ * sample from it, until it's frozen again.
+ * @param markov_chain
+ * @return success/failure: true if the process was successful, false if in
+ * case of allocation error.
+ */
+bool freeze_markov_chain(MarkovChain *markov_chain);
+
+/**
+ * Save markov_chain to a file as a compiled, pointer-free image: the data
+ * of every state (copied by the chain's size_func, which must be set), the
+ * states and their successors with frequencies, and alias tables if the
+ * chain is frozen.
+ * @param markov_chain the chain to save
+ * @param path path of the file to write
+ * @return success/failure: true if the process was successful, false if in
+ * case of allocation or write error, or if the chain has no size_func.
+ */
+bool save_markov_chain(const MarkovChain *markov_chain, const char *path);
+
+/**
+ * Load a chain saved by save_markov_chain into markov_chain, which must be
+ * empty and have the callbacks of the saved chain. The file is mapped to
+ * memory, not read through, and the chain is generated from the mapping.
+ * It's offsets and ids are checked first, in one pass over the image (see
+ * load_compiled_chain): loading takes O(states + successors), with no
+ * allocation per state, which is still far less than training it.
+ * get_first_random_node doesn't work on a loaded chain,
+ * generate_random_sequence chooses it's own first state from the image.
+ * @param markov_chain the empty chain to load into
+ * @param path path of the saved file
+ * @return success/failure: true if the file was loaded, false if it can't
+ * be read or isn't a saved chain.
+ */
+bool load_markov_chain(MarkovChain *markov_chain, const char *path);
+
 /**
  * Receive markov_chain, generate and print random sentence out of it. The
  * sentence most have at least 2 words in it.
@@ -103,7 +256,40 @@ void generate_random_sequence(MarkovChain *markov_chain, MarkovNode *
 first_node, int max_length);
 
 /**
- * Free markov_chain and all of it's content from memory
+ * generate_random_sequence, drawing every choice from rng instead of the
+ * chain's own stream, so the sentence depends on rng's stream only. It
+ * only reads the chain when the chain is frozen and it's compiled image is
+ * current (see freeze_markov_chain), so then it can be called from many
+ * threads at once, each with it's own stream and printing to it's own
+ * output.
+ * @param rng the random stream, NULL for the chain's rng
+ */
+void generate_random_sequence_from(MarkovChain *markov_chain,
+                                   MarkovNode *first_node, int max_length,
+                                   Rng *rng);
+
+/**
+ * Generate a random sentence the way generate_random_sequence_from does,
+ * into a buffer instead of printing it: the data of each of it's states,
+ * the first state's included, in order. Data and not MarkovNodes, since a
+ * loaded chain has no nodes. The same rng gives the same sentence both
+ * ways, but for a dead end of the corpus, where the sentence just ends.
+ * @param markov_chain
+ * @param first_node markov_node to start with,
+ *                   if NULL- choose a random markov_node
+ * @param max_length maximum length of chain to generate
+ * @param rng the random stream, NULL for the chain's rng
+ * @param out buffer of at least max_length data pointers
+ * @param out_len set to the num of states written to out
+ * @return true if a sentence was generated, false if the chain has no
+ * first state
+ */
+bool generate_sequence_into(MarkovChain *markov_chain,
+                            MarkovNode *first_node, int max_length,
+                            Rng *rng, void **out, int *out_len);
+
+/**
+ * Free markov_chain and all of it's content from memory, if it isn't NULL
  * @param markov_chain markov_chain to free
  */
 void free_markov_chain(MarkovChain **markov_chain);
@@ -139,4 +325,163 @@ Node* get_node_from_database(MarkovChain *markov_chain, void *data_ptr);
  */
 Node* add_to_database(MarkovChain *markov_chain, void *data_ptr);
 
+/*
+ * The functions below are specialized for chains of InternedStr states
+ * hashed by their hash (like tweets_generator's order 1 chain): they do
+ * what the function of the same purpose above does, with the states
+ * compared, hashed and checked for being last inline rather than through
+ * the chain's functions.
+ */
+
+/**
+ * get_node_from_database of an InternedStr.
+ */
+Node *get_string_from_database(MarkovChain *markov_chain,
+                               const InternedStr *string);
+
+/**
+ * add_to_database of an InternedStr.
+ */
+Node *add_string_to_database(MarkovChain *markov_chain,
+                             const InternedStr *string);
+
+/**
+ * add_node_to_counter_list of InternedStr states.
+ */
+bool add_string_to_counter_list(MarkovNode *first_node,
+                                MarkovNode *second_node,
+                                MarkovChain *markov_chain);
+
+/**
+ * generate_sequence_into of InternedStr states.
+ */
+bool generate_strings_into(MarkovChain *markov_chain, MarkovNode *first_node,
+                           int max_length, Rng *rng, const InternedStr **out,
+                           int *out_len);
+
+/**
+ * Merge all states and transitions of src into dst, as if dst was also
+ * trained on src's input: states are unified by dst's comp_func (and
+ * hash_func), frequencies and occurrences of equal ones are summed, and
+ * states new to dst are added by dst's copy_func in src's database order.
+ * src is left unchanged. Both chains must hold the same type of data.
+ * @param dst the chain to merge into
+ * @param src the chain to merge
+ * @return success/failure: true if the process was successful, false if in
+ * case of allocation error or if either chain is in approximate training.
+ */
+bool merge_markov_chain_into(MarkovChain *dst, MarkovChain *src);
+
+/**
+ * Merge chains trained on different corpora into a new chain, each with
+ * it's counts scaled by it's weight: as if the new chain was trained on
+ * every corpus repeated weight times. States are unified the way
+ * merge_markov_chain_into unifies them, by the hash index when the chains
+ * have a hash_func, so each chain is merged in one pass over it's states
+ * and counters. A scaled count is rounded, to at least 1 if it wasn't 0,
+ * so no transition of a chain of positive weight is lost; a chain of
+ * weight 0 is left out.
+ * The new chain gets the functions and settings of the first chain, and
+ * holds copies of the states by it's copy_func (or the same pointers, if
+ * it's copy_func returns them, then the states must outlive it).
+ * @param chains the chains, of the same type of data
+ * @param weights non negative weight of each chain
+ * @return pointer to the merged MarkovChain: upon success, NULL: in case of
+ * allocation error, a negative weight or a chain in approximate training.
+ */
+MarkovChain *merge_markov_chains(MarkovChain *const chains[],
+                                 const double weights[], int num_of_chains);
+
+/**
+ * Create a view of a weighted mixture of trained chains, that generates
+ * sequences the way the chain merge_markov_chains would merge them into
+ * does, without materializing it (and without rounding the scaled
+ * counts). Each next state is drawn from the chains that have the current
+ * state, each by it's weight times the state's num of transitions in it;
+ * a first state is drawn uniformly from all of the chains' first states,
+ * or by their weighted occurrences if the first chain's weighted_start is
+ * set. States are looked up in each chain at every step, in O(1) by it's
+ * hash index, so it pays off for a few chains. The chains are prepared to
+ * be read only, so a view can be generated from by many threads at once,
+ * as long as the chains aren't changed: they must be frozen, done
+ * training, since a view of a chain that changes would draw from tables
+ * built for an older version of it.
+ * @param chains up to MAX_MIXED_CHAINS frozen chains (not loaded ones,
+ * which have no states to look up), of the same type of data
+ * @param weights non negative weight of each chain
+ * @return pointer to the new MixtureChain: upon success, NULL: in case of
+ * allocation error, bad weights, too many chains or a chain that isn't
+ * frozen.
+ */
+MixtureChain *create_mixture_chain(MarkovChain *const chains[],
+                                   const double weights[], int num_of_chains);
+
+/**
+ * Generate a random sentence from a mixture, the way
+ * generate_sequence_into does from a chain: the data of each of it's
+ * states in order, ending at a last state, a dead end or max_length.
+ * @param rng the random stream
+ * @param out buffer of at least max_length data pointers
+ * @param out_len set to the num of states written to out
+ * @return true if a sentence was generated, false if the mixture has no
+ * first state
+ */
+bool generate_mixture_into(const MixtureChain *mixture, int max_length,
+                           Rng *rng, void **out, int *out_len);
+
+/**
+ * Free the mixture (not it's chains) and set the pointer to NULL.
+ */
+void free_mixture_chain(MixtureChain **mixture);
+
+/**
+ * Switch markov_chain, before training it, to approximate training, for
+ * corpora whose exact chain doesn't fit in memory.
+ * Transitions are counted in a count-min sketch, and only become counters
+ * of their state once counted promote_threshold times, with the sketch's
+ * count. Every prune_every transitions a lossy counting round drops the
+ * counters whose frequency is at most the num of rounds so far, so only
+ * transitions with more than 1 / prune_every of all transitions are sure to
+ * be kept; a dropped one is promoted again if it keeps occurring.
+ * States are all kept, a state whose transitions are all dropped is a dead
+ * end. Chains trained this way can't be merged.
+ * Only the sketch is bounded by sketch_bytes: the counters are bounded by
+ * pruning, to about prune_every * log(transitions / prune_every), and
+ * without it grow with the corpus like an exact chain's.
+ * @param sketch_bytes bytes the sketch may take
+ * @param promote_threshold occurrences that make a transition a counter
+ * @param prune_every num of transitions between prunings, 0 for never
+ * @return success/failure: true if the process was successful, false if in
+ * case of allocation error.
+ */
+bool start_approximate_training(MarkovChain *markov_chain,
+                                size_t sketch_bytes, int promote_threshold,
+                                long prune_every);
+
+/**
+ * Score sequences of states by their log-probability under the chain:
+ * the sum of the natural log-probabilities of their transitions, given
+ * their first state. A transition from a last state isn't scored, the
+ * states after it start a new sequence, the way they are trained.
+ * With smoothing a, a transition from a state of n transitions (counted
+ * by frequency) among v states has probability (frequency + a) / (n + a*v),
+ * so unseen transitions, and ones from or to states not in the chain,
+ * get a / (n + a*v) (1 / v from unknown states). Without smoothing they
+ * have probability 0, and the sequence -INFINITY.
+ * The log-probabilities are computed once into a hash table of the
+ * transitions, and states are looked up by the chain's hash index (when it
+ * has a hash_func), so each transition is scored in O(1). The sequences
+ * are split among threads, which only read the chain.
+ * @param sequences data of the states of each sequence, in order
+ * @param lengths num of states of each sequence
+ * @param smoothing the additive smoothing a, 0 for none
+ * @param num_of_threads num of threads to score by, 0 for one per CPU
+ * @param log_probs set to the log-probability of each sequence
+ * @return success/failure: true if the process was successful, false if in
+ * case of allocation error.
+ */
+bool score_sequences(MarkovChain *markov_chain, void **const sequences[],
+                     const int lengths[], int num_of_sequences,
+                     double smoothing, int num_of_threads, double log_probs[]);
+
 #endif /* markovChain_h */
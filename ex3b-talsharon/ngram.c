@@ -0,0 +1,133 @@
+#include "ngram.h"
+#include <stdlib.h>
+
+#define INITIAL_CAPACITY 1024
+#define GROWTH_FACTOR 2
+// grow when more than MAX_LOAD_NUM / MAX_LOAD_DEN of the slots are taken
+#define MAX_LOAD_NUM 7
+#define MAX_LOAD_DEN 10
+#define KEY_MULTIPLIER 0x9E3779B97F4A7C15ULL
+#define KEY_SHIFT 29
+
+/**
+ * Packs the key of the tuple of context followed by word.
+ */
+static uint64_t ngram_key (const NGram *context, const InternedStr *word)
+{
+  uint64_t key = context == NULL ? 0 : context->key;
+  key = (key ^ ((uint64_t) word->id + 1)) * KEY_MULTIPLIER;
+  return key ^ (key >> KEY_SHIFT);
+}
+
+/**
+ * Doubles the capacity of the pool's hash set.
+ * @return 0 on success, 1 in case of allocation error
+ */
+static int grow (NGramPool *pool)
+{
+  size_t new_capacity = pool->capacity * GROWTH_FACTOR;
+  NGram **slots = calloc (new_capacity, sizeof (NGram *));
+  if (slots == NULL)
+  {
+    return 1;
+  }
+  size_t mask = new_capacity - 1;
+  for (size_t i = 0; i < pool->capacity; i++)
+  {
+    if (pool->slots[i] != NULL)
+    {
+      size_t slot = pool->slots[i]->key & mask;
+      while (slots[slot] != NULL)
+      {
+        slot = (slot + 1) & mask;
+      }
+      slots[slot] = pool->slots[i];
+    }
+  }
+  free (pool->slots);
+  pool->slots = slots;
+  pool->capacity = new_capacity;
+  return 0;
+}
+
+NGramPool *create_ngram_pool (uint32_t order)
+{
+  NGramPool *pool = malloc (sizeof (NGramPool));
+  Arena *arena = create_arena ();
+  NGram **slots = calloc (INITIAL_CAPACITY, sizeof (NGram *));
+  if (pool == NULL || arena == NULL || slots == NULL)
+  {
+    free (pool);
+    free_arena (&arena);
+    free (slots);
+    return NULL;
+  }
+  *pool = (NGramPool) {arena, slots, INITIAL_CAPACITY, 0, order};
+  return pool;
+}
+
+const NGram *intern_ngram (NGramPool *pool, const NGram *context,
+                           const InternedStr *word)
+{
+  uint64_t key = ngram_key (context, word);
+  size_t mask = pool->capacity - 1;
+  for (size_t slot = key & mask; pool->slots[slot] != NULL;
+       slot = (slot + 1) & mask)
+  {
+    const NGram *cur = pool->slots[slot];
+    if (cur->key == key && cur->context == context && cur->word == word)
+    {
+      return cur;
+    }
+  }
+  // the suffix is interned first, it may grow the set
+  const NGram *suffix = NULL;
+  if (context != NULL
+      && (suffix = intern_ngram (pool, context->suffix, word)) == NULL)
+  {
+    return NULL;
+  }
+  if ((pool->size + 1) * MAX_LOAD_DEN > pool->capacity * MAX_LOAD_NUM
+      && grow (pool) != 0)
+  {
+    return NULL;
+  }
+  NGram *ngram = arena_alloc (pool->arena, sizeof (NGram));
+  if (ngram == NULL)
+  {
+    return NULL;
+  }
+  *ngram = (NGram) {key, context, suffix, word,
+                    context == NULL ? 1 : context->order + 1};
+  mask = pool->capacity - 1;
+  size_t slot = key & mask;
+  while (pool->slots[slot] != NULL)
+  {
+    slot = (slot + 1) & mask;
+  }
+  pool->slots[slot] = ngram;
+  pool->size++;
+  return ngram;
+}
+
+const NGram *shift_ngram (NGramPool *pool, const NGram *prev,
+                          const InternedStr *word)
+{
+  if (prev != NULL && prev->order >= pool->order)
+  {
+    prev = prev->suffix;
+  }
+  return intern_ngram (pool, prev, word);
+}
+
+void free_ngram_pool (NGramPool **pool)
+{
+  if (*pool == NULL)
+  {
+    return;
+  }
+  free_arena (&(*pool)->arena);
+  free ((*pool)->slots);
+  free (*pool);
+  *pool = NULL;
+}
@@ -0,0 +1,72 @@
+#ifndef NGRAM_H
+#define NGRAM_H
+#include <stddef.h>
+#include <stdint.h>
+#include "arena.h"
+#include "string_pool.h"
+
+/**
+ * A tuple of consecutive words of one StringPool, the state of an order-k
+ * chain. A tuple is stored as it's last word and a link to the tuple of
+ * the words before it (it's context), so tuples that start the same share
+ * storage, and an NGram takes the same space for any k.
+ * Tuples are interned in an NGramPool: equal tuples are the same NGram,
+ * compared by pointer, and key is a hash of the word ids packed into one
+ * integer.
+ */
+typedef struct NGram {
+    uint64_t key;
+    const struct NGram *context; // all but the last word, NULL for 1 word
+    const struct NGram *suffix; // all but the first word, NULL for 1 word
+    const InternedStr *word; // the last word
+    uint32_t order; // num of words
+} NGram;
+
+/**
+ * An append-only pool of distinct tuples, kept in an arena and found by a
+ * hash set on (context, word).
+ */
+typedef struct NGramPool {
+    Arena *arena;
+    NGram **slots; // open-addressing hash set, NULL for empty
+    size_t capacity; // always a power of 2
+    size_t size; // num of distinct tuples, of any order
+    uint32_t order; // num of words in a full window, see shift_ngram
+} NGramPool;
+
+/**
+ * Creates an empty pool.
+ * @param order num of words in a full window, at least 1
+ * @return pointer to the new NGramPool: upon success, NULL: otherwise
+ */
+NGramPool *create_ngram_pool (uint32_t order);
+
+/**
+ * Gets the tuple of the words of context followed by word, storing it the
+ * first time it's seen.
+ * @param pool the pool to intern in
+ * @param context tuple of the words before word, NULL for none
+ * @param word the last word, of the same StringPool as context's words
+ * @return pointer to the NGram: upon success, NULL: otherwise
+ */
+const NGram *intern_ngram (NGramPool *pool, const NGram *context,
+                           const InternedStr *word);
+
+/**
+ * Slides a window of up to the pool's order words over a line: gets the
+ * tuple of prev followed by word, dropping prev's first word if prev is
+ * already full.
+ * @param pool the pool to intern in
+ * @param prev the previous window, NULL at the start of a line
+ * @param word the next word of the line
+ * @return pointer to the NGram: upon success, NULL: otherwise
+ */
+const NGram *shift_ngram (NGramPool *pool, const NGram *prev,
+                          const InternedStr *word);
+
+/**
+ * Frees the pool and all of it's tuples, sets the pointer to NULL.
+ */
+void free_ngram_pool (NGramPool **pool);
+
+#endif //NGRAM_H
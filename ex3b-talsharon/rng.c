@@ -0,0 +1,28 @@
+#include "rng.h"
+
+/**
+ * Fills an xoshiro256** state from a SplitMix64 sequence starting at
+ * start, which is never all zero.
+ */
+static Rng seed_state (uint64_t start)
+{
+  Rng rng = {RNG_XOSHIRO, {0}};
+  for (int i = 0; i < RNG_STATE_WORDS; i++)
+  {
+    start += RNG_GOLDEN_GAMMA;
+    rng.state[i] = rng_mix (start);
+  }
+  return rng;
+}
+
+Rng rng_seed (uint64_t seed)
+{
+  return seed_state (seed);
+}
+
+Rng rng_stream (uint64_t seed, uint64_t index)
+{
+  // mixed twice, so the streams of neighbouring seeds and indices start
+  // at unrelated points
+  return seed_state (rng_mix (rng_mix (seed + RNG_GOLDEN_GAMMA) ^ index));
+}
@@ -0,0 +1,120 @@
+#ifndef RNG_H
+#define RNG_H
+#include <stdint.h>
+#include <stdlib.h>
+
+#define RNG_GOLDEN_GAMMA 0x9E3779B97F4A7C15ULL
+#define RNG_MIX_MULTIPLIER_1 0xBF58476D1CE4E5B9ULL
+#define RNG_MIX_MULTIPLIER_2 0x94D049BB133111EBULL
+#define RNG_BITS_PER_DRAW 32
+#define RNG_STATE_WORDS 4
+#define RNG_DOUBLE_BITS 53 // bits of a double's mantissa
+#define RNG_WORD_BITS 64
+
+/**
+ * How an Rng draws its numbers.
+ */
+typedef enum RngKind {
+    // rand() % max_number, the sequence srand seeds. The kind of a zero
+    // initialized Rng, so a chain that doesn't set one draws as it always
+    // did.
+    RNG_RAND = 0,
+    // xoshiro256**: no hidden global state or locking, and bounded numbers
+    // with no modulo bias.
+    RNG_XOSHIRO
+} RngKind;
+
+/**
+ * A random stream. An xoshiro256** stream is seeded through SplitMix64
+ * from a seed, or from a (seed, index) pair: streams of different pairs
+ * are independent, so a sequence generated from it's own stream is the
+ * same whichever thread generates it.
+ */
+typedef struct Rng {
+    RngKind kind;
+    uint64_t state[RNG_STATE_WORDS];
+} Rng;
+
+/**
+ * Creates an xoshiro256** stream of the given seed.
+ */
+Rng rng_seed (uint64_t seed);
+
+/**
+ * Creates the xoshiro256** stream of the given index under the given seed.
+ */
+Rng rng_stream (uint64_t seed, uint64_t index);
+
+/**
+ * Scrambles a 64 bit value (the SplitMix64 output function).
+ */
+static inline uint64_t rng_mix (uint64_t value)
+{
+  value = (value ^ (value >> 30)) * RNG_MIX_MULTIPLIER_1;
+  value = (value ^ (value >> 27)) * RNG_MIX_MULTIPLIER_2;
+  return value ^ (value >> 31);
+}
+
+static inline uint64_t rng_rotate (uint64_t value, int shift)
+{
+  return (value << shift) | (value >> (64 - shift));
+}
+
+/**
+ * Gets the next 64 random bits of an xoshiro256** stream.
+ */
+static inline uint64_t rng_next (Rng *rng)
+{
+  uint64_t *state = rng->state;
+  uint64_t result = rng_rotate (state[1] * 5, 7) * 9;
+  uint64_t shifted = state[1] << 17;
+  state[2] ^= state[0];
+  state[3] ^= state[1];
+  state[1] ^= state[2];
+  state[0] ^= state[3];
+  state[2] ^= shifted;
+  state[3] = rng_rotate (state[3], 45);
+  return result;
+}
+
+/**
+ * Gets a random number in [0, max_number). An xoshiro256** stream scales
+ * 32 random bits by max_number (Lemire's multiply-shift), drawing again in
+ * the rare case the low half falls in the biased part, so it takes no
+ * division but that of the threshold.
+ * @param max_number positive bound
+ */
+static inline int rng_below (Rng *rng, int max_number)
+{
+  if (rng->kind == RNG_RAND)
+  {
+    return rand () % max_number;
+  }
+  uint32_t bound = (uint32_t) max_number;
+  uint64_t product = (rng_next (rng) >> RNG_BITS_PER_DRAW) * bound;
+  if ((uint32_t) product < bound)
+  {
+    uint32_t threshold = -bound % bound; // 2^32 mod bound
+    while ((uint32_t) product < threshold)
+    {
+      product = (rng_next (rng) >> RNG_BITS_PER_DRAW) * bound;
+    }
+  }
+  return (int) (product >> RNG_BITS_PER_DRAW);
+}
+
+/**
+ * Gets a random double in [0, 1): the top RNG_DOUBLE_BITS bits of an
+ * xoshiro256** draw, so every value is a multiple of 2^-53.
+ */
+static inline double rng_uniform (Rng *rng)
+{
+  if (rng->kind == RNG_RAND)
+  {
+    return rand () / ((double) RAND_MAX + 1);
+  }
+  return (double) (rng_next (rng) >> (RNG_WORD_BITS - RNG_DOUBLE_BITS))
+         / (double) (1ULL << RNG_DOUBLE_BITS);
+}
+
+#endif //RNG_H
@@ -0,0 +1,81 @@
+#include "score_table.h"
+#include "rng.h"
+#include <stdlib.h>
+
+#define MIN_CAPACITY 16
+#define LOAD_FACTOR 2 // capacity per transition, at least
+
+static uint64_t make_key (uint32_t from, uint32_t to)
+{
+  return ((uint64_t) from + 1) << 32 | to;
+}
+
+ScoreTable *create_score_table (size_t num_of_transitions, int num_of_states)
+{
+  size_t capacity = MIN_CAPACITY;
+  while (capacity < num_of_transitions * LOAD_FACTOR)
+  {
+    capacity *= 2;
+  }
+  ScoreTable *table = calloc (1, sizeof (ScoreTable));
+  if (table == NULL)
+  {
+    return NULL;
+  }
+  table->keys = calloc (capacity, sizeof (uint64_t));
+  table->log_probs = malloc (sizeof (double) * capacity);
+  table->unseen_log_probs = malloc (sizeof (double)
+                                    * ((size_t) num_of_states + 1));
+  if (table->keys == NULL || table->log_probs == NULL
+      || table->unseen_log_probs == NULL)
+  {
+    free_score_table (&table);
+    return NULL;
+  }
+  table->capacity = capacity;
+  table->num_of_states = num_of_states;
+  return table;
+}
+
+void score_table_insert (ScoreTable *table, uint32_t from, uint32_t to,
+                         double log_prob)
+{
+  uint64_t key = make_key (from, to);
+  size_t mask = table->capacity - 1;
+  size_t slot = (size_t) rng_mix (key) & mask;
+  while (table->keys[slot] != 0)
+  {
+    slot = (slot + 1) & mask;
+  }
+  table->keys[slot] = key;
+  table->log_probs[slot] = log_prob;
+}
+
+double score_table_find (const ScoreTable *table, uint32_t from,
+                         uint32_t to)
+{
+  uint64_t key = make_key (from, to);
+  size_t mask = table->capacity - 1;
+  for (size_t slot = (size_t) rng_mix (key) & mask; table->keys[slot] != 0;
+       slot = (slot + 1) & mask)
+  {
+    if (table->keys[slot] == key)
+    {
+      return table->log_probs[slot];
+    }
+  }
+  return table->unseen_log_probs[from];
+}
+
+void free_score_table (ScoreTable **table)
+{
+  if (*table == NULL)
+  {
+    return;
+  }
+  free ((*table)->keys);
+  free ((*table)->log_probs);
+  free ((*table)->unseen_log_probs);
+  free (*table);
+  *table = NULL;
+}
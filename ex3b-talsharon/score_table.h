@@ -0,0 +1,50 @@
+#ifndef SCORE_TABLE_H
+#define SCORE_TABLE_H
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Log-probabilities of a chain's transitions, for scoring sequences: an
+ * open-addressing (linear probing) hash table from a (state, next state)
+ * pair of ids to the log-probability of the transition, and the
+ * log-probability of a transition a state has no counter for.
+ * Built by the chain for a smoothing and a version of it, see
+ * score_sequences.
+ */
+typedef struct ScoreTable {
+    uint64_t *keys; // (from id + 1) << 32 | to id, 0 for an empty slot
+    double *log_probs; // of the transition in each slot
+    size_t capacity; // always a power of 2
+    double *unseen_log_probs; // by the id of the state it's from
+    int num_of_states;
+    double smoothing;
+    unsigned long source_version; // version of the chain it was built from
+} ScoreTable;
+
+/**
+ * Creates an empty table with room for the given num of transitions.
+ * @param num_of_states num of states, their ids are 0 .. num_of_states - 1
+ * @return pointer to the new ScoreTable: upon success, NULL: otherwise
+ */
+ScoreTable *create_score_table (size_t num_of_transitions, int num_of_states);
+
+/**
+ * Adds a transition to the table, it must not be in it yet, and the table
+ * must have room for it.
+ */
+void score_table_insert (ScoreTable *table, uint32_t from, uint32_t to,
+                         double log_prob);
+
+/**
+ * Gets the log-probability of a transition, the unseen one of it's state
+ * if it isn't in the table.
+ */
+double score_table_find (const ScoreTable *table, uint32_t from,
+                         uint32_t to);
+
+/**
+ * Frees the table and sets the pointer to NULL.
+ */
+void free_score_table (ScoreTable **table);
+
+#endif //SCORE_TABLE_H
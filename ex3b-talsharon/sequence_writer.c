@@ -0,0 +1,88 @@
+#include "sequence_writer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/uio.h>
+
+#define INITIAL_CAPACITY 65536
+#define GROWTH_FACTOR 2
+
+char *reserve_output (SequenceWriter *writer, size_t len)
+{
+  if (writer->capacity - writer->size < len)
+  {
+    size_t capacity = writer->capacity > 0 ? writer->capacity
+                                           : INITIAL_CAPACITY;
+    while (capacity - writer->size < len)
+    {
+      capacity *= GROWTH_FACTOR;
+    }
+    char *text = realloc (writer->text, capacity);
+    if (text == NULL)
+    {
+      return NULL;
+    }
+    writer->text = text;
+    writer->capacity = capacity;
+  }
+  return writer->text + writer->size;
+}
+
+bool write_output (SequenceWriter *writer, const char *bytes, size_t len)
+{
+  char *dst = reserve_output (writer, len);
+  if (dst == NULL)
+  {
+    return false;
+  }
+  memcpy (dst, bytes, len);
+  commit_output (writer, len);
+  return true;
+}
+
+bool flush_outputs (int fd, const SequenceWriter writers[],
+                    int num_of_writers)
+{
+  fflush (NULL);
+  struct iovec iov[MAX_FLUSHED_WRITERS];
+  int count = 0;
+  for (int i = 0; i < num_of_writers && count < MAX_FLUSHED_WRITERS; i++)
+  {
+    if (writers[i].size > 0)
+    {
+      iov[count++] = (struct iovec) {writers[i].text, writers[i].size};
+    }
+  }
+  struct iovec *cur = iov;
+  while (count > 0) // a partial write continues from where it stopped
+  {
+    ssize_t written = writev (fd, cur, count);
+    if (written < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      return false;
+    }
+    while (count > 0 && (size_t) written >= cur->iov_len)
+    {
+      written -= (ssize_t) cur->iov_len;
+      cur++;
+      count--;
+    }
+    if (count > 0)
+    {
+      cur->iov_base = (char *) cur->iov_base + written;
+      cur->iov_len -= (size_t) written;
+    }
+  }
+  return true;
+}
+
+void free_output (SequenceWriter *writer)
+{
+  free (writer->text);
+  *writer = (SequenceWriter) {NULL, 0, 0};
+}
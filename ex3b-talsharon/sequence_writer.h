@@ -0,0 +1,57 @@
+#ifndef SEQUENCE_WRITER_H
+#define SEQUENCE_WRITER_H
+#include <stddef.h>
+#include <stdbool.h>
+
+#define MAX_FLUSHED_WRITERS 64
+
+/**
+ * A growable output buffer: sequences are formatted into it with no stdio
+ * on the way, and written out with one write system call.
+ * A zero initialized writer is empty.
+ */
+typedef struct SequenceWriter {
+    char *text;
+    size_t size; // bytes written so far
+    size_t capacity;
+} SequenceWriter;
+
+/**
+ * Makes room for len more bytes at the end of the writer's text.
+ * @return pointer to the room: upon success, NULL: otherwise. The bytes
+ * become part of the text by commit_output.
+ */
+char *reserve_output (SequenceWriter *writer, size_t len);
+
+/**
+ * Adds len bytes, filled after reserve_output, to the writer's text.
+ */
+static inline void commit_output (SequenceWriter *writer, size_t len)
+{
+  writer->size += len;
+}
+
+/**
+ * Appends len bytes to the writer's text.
+ * @return true: upon success, false: in case of allocation error
+ */
+bool write_output (SequenceWriter *writer, const char *bytes, size_t len);
+
+/**
+ * Writes the texts of the writers, one after the other, to a file
+ * descriptor: with a single writev when the system takes it all at once.
+ * @param fd the file descriptor, stdio buffered output to it is flushed
+ * first
+ * @param writers the writers, in order
+ * @param num_of_writers num of writers, at most MAX_FLUSHED_WRITERS
+ * @return true: upon success, false: in case of write error
+ */
+bool flush_outputs (int fd, const SequenceWriter writers[],
+                    int num_of_writers);
+
+/**
+ * Frees the writer's text and empties it.
+ */
+void free_output (SequenceWriter *writer);
+
+#endif //SEQUENCE_WRITER_H
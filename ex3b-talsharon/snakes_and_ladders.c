@@ -1,26 +1,55 @@
 #include <string.h> // For strlen(), strcmp(), strcpy()
 #include "markov_chain.h"
+#include "board.h"
+#include "board_simulator.h"
+#include <time.h>
 
-#define MAX(X, Y) (((X) < (Y)) ? (Y) : (X))
-
-#define EMPTY -1
 #define BOARD_SIZE 100
 #define MAX_GENERATION_LENGTH 60
 
-#define DICE_MAX 6
 #define NUM_OF_TRANSITIONS 20
 
-#define ARG_NUM 3
+#define MIN_ARG_NUM 3
+#define MAX_ARG_NUM 6
 #define SEED_ARG 1
 #define MAX_PATHS_ARG 2
-#define INPUT_LEN_ERR_MSG "Usage: The program receives 2 arguments only\n"
+#define SOLVE_FROM_ARG 3
+#define SIMULATED_GAMES_ARG 4
+#define BOARD_ARG 5
+#define NANOS_PER_SECOND 1e9
+#define SOLVED_MASS 1e-9 // moves are listed until all but this is absorbed
+#define SOLVED_ROWS 1000 // the moves are listed in this many rows at most
+#define INPUT_LEN_ERR_MSG "Usage: The program receives 2 to 5 arguments \
+only\n"
+#define INVALID_CELL_ERR_MSG "Error: The cell to start from must be on the \
+board\n"
+#define INVALID_BOARD_ERR_MSG "Error: Invalid board file\n"
+#define UNREACHABLE_ERR_MSG "Error: The last cell can't be reached from \
+every cell\n"
+#define UNSOLVED_ERR_MSG "Error: The expected moves didn't converge\n"
+#define EXPECTED_HEADER_MSG "Cell\tExpected moves\n"
+#define EXPECTED_MSG "%d\t%.6f\n"
+#define EXPECTED_FROM_MSG "Expected moves from cell %d: %.6f\n"
+#define DISTRIBUTION_HEADER_MSG "Moves\tProbability\tCumulative\n"
+#define DISTRIBUTION_MSG "%d\t%.9f\t%.9f\n"
+#define DISTRIBUTION_RANGE_MSG "%d-%d\t%.9f\t%.9f\n"
+#define TAIL_MSG "More than %d moves: %.3g\n"
+#define SIM_HEADER_MSG "Moves\tGames\n"
+#define SIM_LENGTH_MSG "%d\t%ld\n"
+#define SIM_RANGE_MSG "%d-%d\t%ld\n"
+#define SIM_CUT_MSG "Cut at %d moves: %ld\n"
+#define SIM_MEAN_MSG "Mean moves from cell %d: %.6f\n"
+#define SIM_HITS_HEADER_MSG "Jump\tHits\n"
+#define SIM_SNAKE_MSG "snake %d to %d\t%ld\n"
+#define SIM_LADDER_MSG "ladder %d to %d\t%ld\n"
+#define SIM_SPEED_MSG "Simulated %ld games, %ld moves in %.3f seconds: \
+%.3g moves/sec\n"
 #define PRINT_MSG "Random Walk %d: "
 #define INT_BASE 10
 #define REG_PRINT_MSG "[%d] -> "
 #define SNAKE_PRINT_MSG "[%d]-snake to %d -> "
 #define LADDER_PRINT_MSG "[%d]-ladder to %d -> "
 #define LAST_PRINT_MSG "[%d]"
-#define LAST_CELL 100
 
 
 /**
@@ -48,18 +77,6 @@ const int transitions[][2] = {{13, 4},
                               {15, 47},
                               {61, 14}};
 
-/**
- * struct represents a Cell in the game board
- */
-typedef struct Cell {
-    int number; // Cell number 1-100
-    int ladder_to;  // ladder_to represents the jump of the ladder in case
-                    // there is one from this square
-    int snake_to;  // snake_to represents the jump of the snake in case
-                    // there is one from this square
-    //both ladder_to and snake_to should be -1 if the Cell doesn't have them
-} Cell;
-
 
 /**
  * Checks if given arguments from command line are valid
@@ -69,13 +86,30 @@ typedef struct Cell {
 int check_arg_validity (int argc);
 
 /**
- * Initiates the MarkovChain and it's database, allocates needed memory.
- * @return pointer to MarkovChain: upon success, NULL: otherwise
+ * Solves the game exactly and prints the expected num of moves to finish
+ * from every cell, and the distribution of the num of moves to finish from
+ * the given cell, in up to SOLVED_ROWS rows of as many moves as it takes.
+ * Moves are die rolls: a snake or a ladder is taken in the same move as the
+ * roll that landed on it's cell.
+ * @param board pointer to the Board
+ * @param start_cell number of the cell to start from
+ * @return EXIT_SUCCESS or EXIT_FAILURE
  */
-MarkovChain *initiate_database ();
+int solve_game (const Board *board, int start_cell);
 
 /**
- * Gets the number of paths to be created after the learning process
+ * Plays the given num of games from the given cell by the board simulator,
+ * and prints how many games took each num of moves, in up to SIM_BINS rows
+ * of as many moves as the longest game needs, and how many times each
+ * snake and ladder was taken. The speed goes to stderr.
+ * @param seed seed of the games' random streams
+ * @return EXIT_SUCCESS or EXIT_FAILURE
+ */
+int simulate (const Board *board, int seed, int start_cell,
+              long num_of_games);
+
+/**
+ * Gets the number of paths to be created
  * @param argv command line's arguments
  * @return int: the number of paths to be created
  */
@@ -84,9 +118,9 @@ int get_paths_num (char *const *argv);
 /**
  * Generates random paths by the given number in the command line
  * @param argv command line's arguments
- * @param markov_chain pointer to MarkovChain
+ * @param board pointer to the Board
  */
-void generate_paths (char *argv[], MarkovChain *markov_chain);
+void generate_paths (char *argv[], const Board *board);
 
 /**
  * Gets the random seed given in the command line
@@ -95,194 +129,214 @@ void generate_paths (char *argv[], MarkovChain *markov_chain);
  */
 int get_rand_seed (char *const *argv);
 
-bool is_last_snake (void *data)
+void print_cell (const Board *board, int cell)
 {
-  Cell *cell = (Cell *) data;
-  if (cell->number == LAST_CELL)
+  if (cell == board->num_of_cells)
   {
-    return true;
+    fprintf (stdout, LAST_PRINT_MSG, cell);
+    return;
+  }
+  int jump = board_jump (board, cell);
+  if (jump == NO_JUMP_TO)
+  {
+    fprintf (stdout, REG_PRINT_MSG, cell);
+  }
+  else if (jump < cell)
+  {
+    fprintf (stdout, SNAKE_PRINT_MSG, cell, jump);
+  }
+  else
+  {
+    fprintf (stdout, LADDER_PRINT_MSG, cell, jump);
   }
-  return false;
-}
-
-int comp_snake (const void *first, const void *second)
-{
-  Cell *cell1 = (Cell*) first;
-  Cell *cell2 = (Cell*) second;
-  return cell1->number - cell2->number;
 }
 
-void free_snake (void *data)
+/**
+ * Prints a random walk from the first cell, up to the last one or
+ * MAX_GENERATION_LENGTH cells. The moves are drawn the way a chain of the
+ * board's cells draws it's edges, a die face or the one edge of a snake or
+ * a ladder, so a seed walks the same on the board as on such a chain.
+ * @param rng the random stream
+ */
+static void walk_board (const Board *board, Rng *rng)
 {
-  Cell *cell = (Cell*) data;
-  free (cell);
-  cell = NULL;
+  int cell = 1;
+  print_cell (board, cell);
+  for (int i = 0; i < MAX_GENERATION_LENGTH - 1
+                  && cell != board->num_of_cells; i++)
+  {
+    int jump = board_jump (board, cell);
+    int face = rng_below (rng, jump == NO_JUMP_TO
+                               ? board_faces (board, cell) : 1);
+    cell = jump == NO_JUMP_TO ? cell + face + 1 : jump;
+    print_cell (board, cell);
+  }
 }
 
-void* copy_snake (const void *data)
+/**
+ * @param argc num of arguments
+ * @param argv 1) Seed
+ *             2) Number of sentences to generate
+ *             3) optional: cell to solve the game from exactly
+ *             4) optional: num of games to simulate from that cell instead
+ *                of solving, 0 to solve
+ *             5) optional: board file to play on, the num of cells and the
+ *                from and to cells of each snake or ladder (see load_board)
+ * @return EXIT_SUCCESS or EXIT_FAILURE
+ */
+int main(int argc, char *argv[])
 {
-  Cell *cell = (Cell*) data;
-  Cell *temp = malloc (sizeof (Cell));
-  if (temp == NULL)
+  srand (get_rand_seed (argv));
+  if (check_arg_validity (argc) != 0)
   {
-    return NULL;
+    return EXIT_FAILURE;
   }
-//  memcpy (temp, cell, sizeof (Cell));
-  temp->number = cell->number, temp->ladder_to = cell->ladder_to,
-  temp->snake_to = cell->snake_to;
-  void *ret = (void*) temp;
-  return ret;
-}
-
-void print_snake (void *data) {
-  if (is_last_snake (data))
+  Board *board = argc > BOARD_ARG ? load_board (argv[BOARD_ARG])
+                 : create_board (BOARD_SIZE, transitions, NUM_OF_TRANSITIONS);
+  if (board == NULL)
   {
-    Cell *cell = (Cell*) data;
-    fprintf (stdout, LAST_PRINT_MSG, cell->number);
-    return;
+    fprintf (stdout, argc > BOARD_ARG ? INVALID_BOARD_ERR_MSG
+                                      : ALLOCATION_ERROR_MASSAGE);
+    return EXIT_FAILURE;
   }
-  Cell *cell = (Cell*) data;
-  if (cell->ladder_to != EMPTY || cell->snake_to != EMPTY)
+  generate_paths (argv, board);
+  int status = EXIT_SUCCESS;
+  long num_of_games = argc > SIMULATED_GAMES_ARG
+                      ? strtol (argv[SIMULATED_GAMES_ARG], NULL, INT_BASE)
+                      : 0;
+  if (num_of_games > 0)
   {
-    if (cell->ladder_to < cell->snake_to)
-    {
-      fprintf (stdout, SNAKE_PRINT_MSG, cell->number, cell->snake_to);
-    }
-    else
-    {
-      fprintf (stdout, LADDER_PRINT_MSG, cell->number, cell->ladder_to);
-    }
+    status = simulate (board, get_rand_seed (argv),
+                       (int) strtol (argv[SOLVE_FROM_ARG], NULL, INT_BASE),
+                       num_of_games);
   }
-  else
+  else if (argc > SOLVE_FROM_ARG)
   {
-    fprintf ( stdout, REG_PRINT_MSG, cell->number);
+    status = solve_game (board, (int) strtol (argv[SOLVE_FROM_ARG], NULL,
+                                              INT_BASE));
   }
+  free_board (&board);
+  return status;
 }
 
-
-
-/** Error handler **/
-static int handle_error(char *error_msg, MarkovChain **database)
+int solve_game (const Board *board, int start_cell)
 {
-    printf("%s", error_msg);
-    if (database != NULL)
-    {
-        free_markov_chain(database);
-    }
+  if (start_cell < 1 || start_cell > board->num_of_cells)
+  {
+    fprintf (stdout, INVALID_CELL_ERR_MSG);
     return EXIT_FAILURE;
-}
-
-
-static int create_board(Cell *cells[BOARD_SIZE])
-{
-    for (int i = 0; i < BOARD_SIZE; i++)
-    {
-        cells[i] = malloc(sizeof(Cell));
-        if (cells[i] == NULL)
-        {
-            for (int j = 0; j < i; j++) {
-                free(cells[j]);
-            }
-            handle_error(ALLOCATION_ERROR_MASSAGE,NULL);
-            return EXIT_FAILURE;
-        }
-        *(cells[i]) = (Cell) {i + 1, EMPTY, EMPTY};
-    }
-
-    for (int i = 0; i < NUM_OF_TRANSITIONS; i++)
-    {
-        int from = transitions[i][0];
-        int to = transitions[i][1];
-        if (from < to)
-        {
-            cells[from - 1]->ladder_to = to;
-        }
-        else
-        {
-            cells[from - 1]->snake_to = to;
-        }
-    }
-    return EXIT_SUCCESS;
-}
-
-/**
- * fills database
- * @param markov_chain
- * @return EXIT_SUCCESS or EXIT_FAILURE
- */
-static int fill_database(MarkovChain *markov_chain)
-{
-    Cell* cells[BOARD_SIZE];
-    if(create_board(cells) == EXIT_FAILURE)
-    {
-        return EXIT_FAILURE;
-    }
-    MarkovNode *from_node = NULL, *to_node = NULL;
-    size_t index_to;
-    for (size_t i = 0; i < BOARD_SIZE; i++)
+  }
+  AbsorbingChain *chain = board_absorbing_chain (board);
+  int n = board->num_of_cells;
+  double *steps = malloc (sizeof (double) * n);
+  double *distribution = NULL;
+  int start = start_cell - 1, num_of_moves = 0;
+  double tail = -1;
+  int status = chain == NULL || steps == NULL ? 1
+               : expected_absorption_moves (chain, steps);
+  if (status != 0
+      || (tail = absorption_distribution (chain, start, SOLVED_MASS,
+                                          &distribution, &num_of_moves)) < 0)
+  {
+    free_absorbing_chain (&chain);
+    free (steps);
+    fprintf (stdout, status == UNREACHABLE_ABSORPTION ? UNREACHABLE_ERR_MSG
+                     : status == UNSOLVED_ABSORPTION ? UNSOLVED_ERR_MSG
+                     : ALLOCATION_ERROR_MASSAGE);
+    return EXIT_FAILURE;
+  }
+  fprintf (stdout, EXPECTED_HEADER_MSG);
+  for (int cell = 1; cell <= n; cell++)
+  {
+    fprintf (stdout, EXPECTED_MSG, cell, steps[cell - 1]);
+  }
+  fprintf (stdout, EXPECTED_FROM_MSG, start_cell, steps[start]);
+  fprintf (stdout, DISTRIBUTION_HEADER_MSG);
+  int width = num_of_moves / SOLVED_ROWS + 1; // moves of each row
+  double cumulative = 0;
+  for (int first = 0; first <= num_of_moves && cumulative < 1 - SOLVED_MASS;
+       first += width)
+  {
+    double probability = 0;
+    for (int k = first; k < first + width && k <= num_of_moves; k++)
     {
-        add_to_database(markov_chain, cells[i]);
+      probability += distribution[k];
     }
-
-    for (size_t i = 0; i < BOARD_SIZE; i++)
+    cumulative += probability;
+    if (probability > 0 && width == 1)
     {
-        from_node = get_node_from_database(markov_chain,cells[i])->data;
-
-        if (cells[i]->snake_to != EMPTY || cells[i]->ladder_to != EMPTY)
-        {
-            index_to = MAX(cells[i]->snake_to,cells[i]->ladder_to) - 1;
-            to_node = get_node_from_database(markov_chain, cells[index_to])
-                    ->data;
-            add_node_to_counter_list(from_node, to_node, markov_chain);
-        }
-        else
-        {
-            for (int j = 1; j <= DICE_MAX; j++)
-            {
-                index_to = ((Cell*) (from_node->data))->number + j - 1;
-                if (index_to >= BOARD_SIZE)
-                {
-                    break;
-                }
-                to_node = get_node_from_database(markov_chain, cells[index_to])
-                        ->data;
-                add_node_to_counter_list(from_node, to_node, markov_chain);
-            }
-        }
+      fprintf (stdout, DISTRIBUTION_MSG, first, probability, cumulative);
     }
-    // free temp arr
-    for (size_t i = 0; i < BOARD_SIZE; i++)
+    else if (probability > 0)
     {
-        free(cells[i]);
+      fprintf (stdout, DISTRIBUTION_RANGE_MSG, first, first + width - 1,
+               probability, cumulative);
     }
-    return EXIT_SUCCESS;
+  }
+  if (tail > SOLVED_MASS)
+  {
+    fprintf (stdout, TAIL_MSG, num_of_moves, tail);
+  }
+  free_absorbing_chain (&chain);
+  free (steps);
+  free (distribution);
+  return EXIT_SUCCESS;
 }
 
-/**
- * @param argc num of arguments
- * @param argv 1) Seed
- *             2) Number of sentences to generate
- * @return EXIT_SUCCESS or EXIT_FAILURE
- */
-int main(int argc, char *argv[])
+int simulate (const Board *board, int seed, int start_cell,
+              long num_of_games)
 {
-  srand (get_rand_seed (argv));
-  if (check_arg_validity (argc) != 0)
+  if (start_cell < 1 || start_cell > board->num_of_cells)
   {
+    fprintf (stdout, INVALID_CELL_ERR_MSG);
     return EXIT_FAILURE;
   }
-  MarkovChain *markov_chain = initiate_database ();
-  if (markov_chain == NULL)
+  FlatBoard *flat = create_flat_board (board);
+  SimResult result;
+  struct timespec begin, end;
+  clock_gettime (CLOCK_MONOTONIC, &begin);
+  if (flat == NULL
+      || !simulate_games (flat, start_cell, num_of_games, (uint64_t) seed, 0,
+                          &result))
   {
+    free_flat_board (&flat);
+    fprintf (stdout, ALLOCATION_ERROR_MASSAGE);
     return EXIT_FAILURE;
   }
-  if (fill_database (markov_chain) == EXIT_FAILURE)
+  clock_gettime (CLOCK_MONOTONIC, &end);
+  fprintf (stdout, SIM_HEADER_MSG);
+  for (int bin = 0; bin < SIM_BINS; bin++)
   {
-    handle_error (ALLOCATION_ERROR_MASSAGE, &markov_chain);
-    return EXIT_FAILURE;
+    int first = bin * result.bin_width;
+    if (result.lengths[bin] > 0 && result.bin_width == 1)
+    {
+      fprintf (stdout, SIM_LENGTH_MSG, first, result.lengths[bin]);
+    }
+    else if (result.lengths[bin] > 0)
+    {
+      fprintf (stdout, SIM_RANGE_MSG, first, first + result.bin_width - 1,
+               result.lengths[bin]);
+    }
+  }
+  if (result.cut > 0)
+  {
+    fprintf (stdout, SIM_CUT_MSG, SIM_CUT_MOVES, result.cut);
+  }
+  fprintf (stdout, SIM_MEAN_MSG, start_cell,
+           result.games > 0 ? (double) result.moves / result.games : 0);
+  fprintf (stdout, SIM_HITS_HEADER_MSG);
+  for (int i = 0; i < board->num_of_jumps; i++)
+  {
+    int from = board->jumps[i][0], to = board->jumps[i][1];
+    fprintf (stdout, from < to ? SIM_LADDER_MSG : SIM_SNAKE_MSG, from, to,
+             result.hits[i + 1]);
   }
-  generate_paths (argv, markov_chain);
-  free_markov_chain (&markov_chain);
+  double seconds = (double) (end.tv_sec - begin.tv_sec)
+                   + (double) (end.tv_nsec - begin.tv_nsec) / NANOS_PER_SECOND;
+  fprintf (stderr, SIM_SPEED_MSG, result.games, result.moves, seconds,
+           seconds > 0 ? (double) result.moves / seconds : 0);
+  free_sim_result (&result);
+  free_flat_board (&flat);
   return EXIT_SUCCESS;
 }
 
@@ -295,7 +349,7 @@ int get_rand_seed (char *const *argv)
 
 int check_arg_validity (int argc)
 {
-  if (argc != ARG_NUM)
+  if (argc < MIN_ARG_NUM || argc > MAX_ARG_NUM)
   {
     fprintf (stdout, INPUT_LEN_ERR_MSG);
     return 1;
@@ -303,26 +357,6 @@ int check_arg_validity (int argc)
   return 0;
 }
 
-MarkovChain *initiate_database ()
-{
-  LinkedList *database = malloc (sizeof (LinkedList));
-  MarkovChain *markov_chain = malloc (sizeof (MarkovChain));
-  if (database == NULL || markov_chain == NULL)
-  {
-    fprintf (stdout , ALLOCATION_ERROR_MASSAGE);
-    return NULL;
-  }
-  *database = (LinkedList) {NULL, NULL, 0};
-  *markov_chain = (MarkovChain) {database, print_snake, comp_snake,
-                                 free_snake, copy_snake, is_last_snake};
-//  markov_chain->print_func = print_snake;
-//  markov_chain->comp_func = comp_snake;
-//  markov_chain->free_data = free_snake;
-//  markov_chain->copy_func = copy_snake;
-//  markov_chain->is_last = is_last_snake;
-  return markov_chain;
-}
-
 int get_paths_num (char *const *argv)
 {
   char *ptr;
@@ -330,14 +364,13 @@ int get_paths_num (char *const *argv)
   return (int) paths_num;
 }
 
-void generate_paths (char *argv[], MarkovChain *markov_chain)
+void generate_paths (char *argv[], const Board *board)
 {
+  Rng rng = {RNG_RAND}; // the sequence srand seeded
   for (int n = 0; n < get_paths_num (argv); n++)
   {
     fprintf (stdout, PRINT_MSG, n+1);
-    generate_random_sequence (markov_chain,
-                              markov_chain->database->first->data,
-                              MAX_GENERATION_LENGTH);
+    walk_board (board, &rng);
     fprintf (stdout, "\n");
   }
-}
\ No newline at end of file
+}
@@ -0,0 +1,146 @@
+#include "string_pool.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define INITIAL_CAPACITY 1024
+#define GROWTH_FACTOR 2
+// grow when more than MAX_LOAD_NUM / MAX_LOAD_DEN of the slots are taken
+#define MAX_LOAD_NUM 7
+#define MAX_LOAD_DEN 10
+#define FNV_OFFSET_BASIS 14695981039346656037ULL
+#define FNV_PRIME 1099511628211ULL
+
+static uint32_t next_pool_id = 0;
+
+/**
+ * Doubles the capacity of the pool's hash set.
+ * @return 0 on success, 1 in case of allocation error
+ */
+static int grow (StringPool *pool)
+{
+  size_t new_capacity = pool->capacity * GROWTH_FACTOR;
+  InternedStr **slots = calloc (new_capacity, sizeof (InternedStr *));
+  if (slots == NULL)
+  {
+    return 1;
+  }
+  size_t mask = new_capacity - 1;
+  for (size_t i = 0; i < pool->capacity; i++)
+  {
+    if (pool->slots[i] != NULL)
+    {
+      size_t slot = pool->slots[i]->hash & mask;
+      while (slots[slot] != NULL)
+      {
+        slot = (slot + 1) & mask;
+      }
+      slots[slot] = pool->slots[i];
+    }
+  }
+  free (pool->slots);
+  pool->slots = slots;
+  pool->capacity = new_capacity;
+  return 0;
+}
+
+StringPool *create_string_pool (StrIsLast is_last)
+{
+  StringPool *pool = malloc (sizeof (StringPool));
+  Arena *arena = create_arena ();
+  InternedStr **slots = calloc (INITIAL_CAPACITY, sizeof (InternedStr *));
+  if (pool == NULL || arena == NULL || slots == NULL)
+  {
+    free (pool);
+    free_arena (&arena);
+    free (slots);
+    return NULL;
+  }
+  *pool = (StringPool) {arena, slots, INITIAL_CAPACITY, 0, next_pool_id++,
+                        is_last, NULL};
+  return pool;
+}
+
+uint64_t hash_chars (const char *str, size_t len)
+{
+  uint64_t hash = FNV_OFFSET_BASIS;
+  for (size_t i = 0; i < len; i++)
+  {
+    hash = (hash ^ (unsigned char) str[i]) * FNV_PRIME;
+  }
+  return hash;
+}
+
+const InternedStr *intern_str (StringPool *pool, const char *str, size_t len)
+{
+  uint64_t hash = hash_chars (str, len);
+  size_t mask = pool->capacity - 1;
+  size_t slot = hash & mask;
+  for (; pool->slots[slot] != NULL; slot = (slot + 1) & mask)
+  {
+    const InternedStr *cur = pool->slots[slot];
+    if (cur->hash == hash && cur->len == len
+        && memcmp (cur->str, str, len) == 0)
+    {
+      return cur;
+    }
+  }
+  if ((pool->size + 1) * MAX_LOAD_DEN > pool->capacity * MAX_LOAD_NUM)
+  {
+    if (grow (pool) != 0)
+    {
+      return NULL;
+    }
+    mask = pool->capacity - 1;
+    slot = hash & mask;
+    while (pool->slots[slot] != NULL)
+    {
+      slot = (slot + 1) & mask;
+    }
+  }
+  InternedStr *interned = arena_alloc (pool->arena,
+                                       sizeof (InternedStr) + len + 1);
+  if (interned == NULL)
+  {
+    return NULL;
+  }
+  interned->hash = hash;
+  interned->len = (uint32_t) len;
+  interned->id = (uint32_t) pool->size;
+  interned->pool_id = pool->pool_id;
+  interned->is_last = pool->is_last (str, len);
+  memcpy (interned->str, str, len);
+  interned->str[len] = '\0';
+  pool->slots[slot] = interned;
+  pool->size++;
+  return interned;
+}
+
+int comp_interned (const InternedStr *first, const InternedStr *second)
+{
+  if (first->pool_id == second->pool_id)
+  {
+    if (first->id == second->id)
+    {
+      return 0;
+    }
+    return first->id < second->id ? -1 : 1;
+  }
+  if (first->len != second->len)
+  {
+    return first->len < second->len ? -1 : 1;
+  }
+  return memcmp (first->str, second->str, first->len);
+}
+
+void free_string_pool (StringPool **pool)
+{
+  if (*pool == NULL)
+  {
+    return;
+  }
+  free_string_pool (&(*pool)->merged);
+  free_arena (&(*pool)->arena);
+  free ((*pool)->slots);
+  free (*pool);
+  *pool = NULL;
+}
@@ -0,0 +1,76 @@
+#ifndef STRING_POOL_H
+#define STRING_POOL_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "arena.h"
+
+/**
+ * A string stored once in a StringPool, with what is needed about it
+ * computed when it's interned. Equal strings of one pool are the same
+ * InternedStr, so they are compared by pointer (or id).
+ */
+typedef struct InternedStr {
+    uint64_t hash;
+    uint32_t len; // num of chars, not including the '\0'
+    uint32_t id; // num of strings interned in the pool before this one
+    uint32_t pool_id; // id of the pool holding the string
+    bool is_last; // result of the pool's is_last on the string
+    char str[]; // '\0' terminated
+} InternedStr;
+
+typedef bool (*StrIsLast)(const char *str, size_t len);
+
+/**
+ * An append-only pool of distinct strings: the strings are written back
+ * to back into the pool's arena, and a hash set finds the InternedStr of a
+ * string by it's contents.
+ */
+typedef struct StringPool {
+    Arena *arena;
+    InternedStr **slots; // open-addressing hash set, NULL for empty
+    size_t capacity; // always a power of 2
+    size_t size; // num of distinct strings
+    uint32_t pool_id;
+    StrIsLast is_last;
+    // pools whose strings are referenced along with this pool's, freed with
+    // it (e.g. pools of chains that were merged into one)
+    struct StringPool *merged;
+} StringPool;
+
+/**
+ * Creates an empty pool.
+ * @param is_last predicate stored with each string as it's is_last flag
+ * @return pointer to the new StringPool: upon success, NULL: otherwise
+ */
+StringPool *create_string_pool (StrIsLast is_last);
+
+/**
+ * Hashes len chars of str (FNV-1a), the hash InternedStr keeps.
+ */
+uint64_t hash_chars (const char *str, size_t len);
+
+/**
+ * Gets the InternedStr of the given chars, storing them in the pool the
+ * first time they are seen. str doesn't have to be '\0' terminated.
+ * @param pool the pool to intern in
+ * @param str the chars of the string
+ * @param len num of chars in str
+ * @return pointer to the InternedStr: upon success, NULL: otherwise
+ */
+const InternedStr *intern_str (StringPool *pool, const char *str, size_t len);
+
+/**
+ * Compares two interned strings, possibly of different pools.
+ * Strings of the same pool are compared by id only.
+ * @return 0 if equal, non zero otherwise (a consistent order)
+ */
+int comp_interned (const InternedStr *first, const InternedStr *second);
+
+/**
+ * Frees the pool, all of it's strings and all pools merged to it, sets the
+ * pointer to NULL.
+ */
+void free_string_pool (StringPool **pool);
+
+#endif //STRING_POOL_H
@@ -0,0 +1,258 @@
+#include "absorbing_chain.h"
+#include "board.h"
+#include <math.h>
+#include <stdio.h>
+
+#define NUM_OF_CELLS 40
+#define NUM_OF_JUMPS 6
+#define MAX_TAIL 1e-12 // of the distributions compared
+#define EPSILON 1e-9
+// more than DENSE_SOLVER_MAX_STATES, for the iterative solver
+#define LARGE_NUM_OF_CELLS 5000
+#define LARGE_FIRST_JUMP 70
+#define LARGE_JUMP_GAP 7
+#define LARGE_SNAKE 60
+#define LARGE_LADDER 45
+#define ERR_MSG "test_absorbing_chain: %s\n"
+#define OK_MSG "test_absorbing_chain: ok\n"
+
+/**
+ * The snakes and ladders of the test board, (from, to).
+ */
+static const int JUMPS[NUM_OF_JUMPS][2] = {{3, 22}, {8, 30}, {17, 4},
+                                          {27, 1}, {33, 12}, {36, 39}};
+
+/**
+ * Jumps back to the first cell from every cell the die may land on before
+ * the last one: the last cell of a board of NUM_OF_CELLS / 2 cells can't
+ * be reached.
+ */
+static const int TRAP_JUMPS[][2] = {{14, 1}, {15, 1}, {16, 1}, {17, 1},
+                                    {18, 1}, {19, 1}};
+
+/**
+ * A cell of the board, the state of a chain of the board's cells.
+ */
+typedef struct TestCell {
+    int number;
+    int jump_to; // NO_JUMP_TO if it has no snake nor ladder
+} TestCell;
+
+static bool is_last_cell (void *data)
+{
+  return ((const TestCell *) data)->number == NUM_OF_CELLS;
+}
+
+static bool is_jump_cell (void *data)
+{
+  return ((const TestCell *) data)->jump_to != NO_JUMP_TO;
+}
+
+static int comp_cell (const void *first, const void *second)
+{
+  return ((const TestCell *) first)->number
+         - ((const TestCell *) second)->number;
+}
+
+static size_t hash_cell (const void *data)
+{
+  return (size_t) ((const TestCell *) data)->number;
+}
+
+static size_t size_cell (const void *data)
+{
+  (void) data;
+  return sizeof (TestCell);
+}
+
+/**
+ * Builds the chain of the board's cells, with an edge for every die face
+ * that stays on the board and one for every snake or ladder, the way
+ * snakes_and_ladders first built it's board.
+ * @return pointer to the filled MarkovChain: upon success, NULL: otherwise
+ */
+static MarkovChain *create_cell_chain (const Board *board)
+{
+  LinkedList *database = calloc (1, sizeof (LinkedList));
+  MarkovChain *markov_chain = calloc (1, sizeof (MarkovChain));
+  if (database == NULL || markov_chain == NULL)
+  {
+    free (database);
+    free (markov_chain);
+    return NULL;
+  }
+  *markov_chain = (MarkovChain) {.database = database,
+                                 .comp_func = comp_cell,
+                                 .is_last = is_last_cell,
+                                 .hash_func = hash_cell,
+                                 .size_func = size_cell};
+  MarkovNode *nodes[NUM_OF_CELLS + 1];
+  for (int cell = 1; cell <= NUM_OF_CELLS; cell++)
+  {
+    TestCell data = {cell, board_jump (board, cell)};
+    Node *node = add_to_database (markov_chain, &data);
+    if (node == NULL)
+    {
+      free_markov_chain (&markov_chain);
+      return NULL;
+    }
+    nodes[cell] = node->data;
+  }
+  bool success = true;
+  for (int cell = 1; cell < NUM_OF_CELLS && success; cell++)
+  {
+    int jump = board_jump (board, cell);
+    if (jump != NO_JUMP_TO)
+    {
+      success = add_node_to_counter_list (nodes[cell], nodes[jump],
+                                          markov_chain);
+      continue;
+    }
+    for (int face = 1; face <= board_faces (board, cell) && success; face++)
+    {
+      success = add_node_to_counter_list (nodes[cell], nodes[cell + face],
+                                          markov_chain);
+    }
+  }
+  if (!success)
+  {
+    free_markov_chain (&markov_chain);
+  }
+  return markov_chain;
+}
+
+/**
+ * Checks that two chains have the same expected moves from every state
+ * and the same distribution of moves from the first one.
+ */
+static bool is_same_game (const AbsorbingChain *first,
+                          const AbsorbingChain *second)
+{
+  double steps[2][NUM_OF_CELLS];
+  double *distribution[2] = {NULL, NULL};
+  double tail[2] = {-1, -1};
+  int num_of_moves[2] = {0, 0};
+  const AbsorbingChain *chains[2] = {first, second};
+  bool success = true;
+  for (int i = 0; i < 2 && success; i++)
+  {
+    success = chains[i]->num_of_states == NUM_OF_CELLS
+              && expected_absorption_moves (chains[i], steps[i]) == 0
+              && (tail[i] = absorption_distribution (chains[i], 0, MAX_TAIL,
+                                                     &distribution[i],
+                                                     &num_of_moves[i])) >= 0;
+  }
+  success = success && num_of_moves[0] == num_of_moves[1]
+            && fabs (tail[0] - tail[1]) <= EPSILON;
+  for (int id = 0; id < NUM_OF_CELLS && success; id++)
+  {
+    success = fabs (steps[0][id] - steps[1][id]) <= EPSILON * steps[0][id];
+  }
+  for (int k = 0; k <= num_of_moves[0] && success; k++)
+  {
+    success = fabs (distribution[0][k] - distribution[1][k]) <= EPSILON;
+  }
+  free (distribution[0]);
+  free (distribution[1]);
+  return success;
+}
+
+/**
+ * Checks that a board whose last cell can't be reached is rejected, and
+ * that the solver tells a chain with a state that can't be absorbed from
+ * an allocation error.
+ */
+static bool test_unreachable (void)
+{
+  Board *board = create_board (NUM_OF_CELLS / 2, TRAP_JUMPS,
+                               sizeof (TRAP_JUMPS) / sizeof (TRAP_JUMPS[0]));
+  if (board != NULL)
+  {
+    free_board (&board);
+    return false;
+  }
+  // states 0 and 1 lead to each other, only 2 is absorbing
+  bool absorbing[] = {false, false, true}, is_free[] = {false, false, false};
+  int row_offsets[] = {0, 1, 2, 2}, columns[] = {1, 0};
+  double probabilities[] = {1, 1}, steps[3];
+  AbsorbingChain chain = {3, absorbing, is_free, row_offsets, columns,
+                          probabilities};
+  return expected_absorption_moves (&chain, steps) == UNREACHABLE_ABSORPTION;
+}
+
+/**
+ * Checks the iterative solver on a board crowded with overlapping snakes,
+ * more than it's preconditioner solves at once: the expected moves of every
+ * cell must be a move more than the average of it's successors'.
+ */
+static bool test_large_board (void)
+{
+  int jumps[LARGE_NUM_OF_CELLS][2], num_of_jumps = 0;
+  for (int from = LARGE_FIRST_JUMP;
+       from + LARGE_LADDER < LARGE_NUM_OF_CELLS; from += LARGE_JUMP_GAP)
+  {
+    jumps[num_of_jumps][0] = from;
+    jumps[num_of_jumps][1] = num_of_jumps % 2 == 0 ? from - LARGE_SNAKE
+                                                   : from + LARGE_LADDER;
+    num_of_jumps++;
+  }
+  Board *board = create_board (LARGE_NUM_OF_CELLS, jumps, num_of_jumps);
+  AbsorbingChain *chain = board != NULL ? board_absorbing_chain (board)
+                                        : NULL;
+  double *steps = malloc (sizeof (double) * LARGE_NUM_OF_CELLS);
+  bool success = chain != NULL && steps != NULL
+                 && expected_absorption_moves (chain, steps) == 0;
+  for (int i = 0; i < LARGE_NUM_OF_CELLS && success; i++)
+  {
+    double expected = chain->absorbing[i] || chain->free[i] ? 0 : 1;
+    for (int e = chain->row_offsets[i];
+         e < chain->row_offsets[i + 1] && !chain->absorbing[i]; e++)
+    {
+      expected += chain->probabilities[e] * steps[chain->columns[e]];
+    }
+    success = fabs (steps[i] - expected) <= EPSILON * (1 + steps[i]);
+  }
+  free (steps);
+  free_absorbing_chain (&chain);
+  free_board (&board);
+  return success;
+}
+
+/**
+ * Builds the game of a board from the chain of it's cells, and checks it
+ * against the one built from the board itself, then checks a large board
+ * and games that can't end.
+ */
+int main (void)
+{
+  Board *board = create_board (NUM_OF_CELLS, JUMPS, NUM_OF_JUMPS);
+  MarkovChain *markov_chain = board != NULL ? create_cell_chain (board)
+                                            : NULL;
+  AbsorbingChain *from_chain = markov_chain != NULL
+      ? build_absorbing_chain (markov_chain, is_jump_cell) : NULL;
+  AbsorbingChain *from_board = board != NULL ? board_absorbing_chain (board)
+                                             : NULL;
+  bool success = from_chain != NULL && from_board != NULL
+                 && is_same_game (from_chain, from_board);
+  free_absorbing_chain (&from_chain);
+  free_absorbing_chain (&from_board);
+  free_markov_chain (&markov_chain);
+  free_board (&board);
+  if (!success)
+  {
+    fprintf (stderr, ERR_MSG, "the chain's game differs from the board's");
+    return EXIT_FAILURE;
+  }
+  if (!test_large_board ())
+  {
+    fprintf (stderr, ERR_MSG, "a large board was solved wrong");
+    return EXIT_FAILURE;
+  }
+  if (!test_unreachable ())
+  {
+    fprintf (stderr, ERR_MSG, "a game that can't end was solved");
+    return EXIT_FAILURE;
+  }
+  fprintf (stdout, OK_MSG);
+  return EXIT_SUCCESS;
+}
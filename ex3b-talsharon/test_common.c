@@ -0,0 +1,59 @@
+#include "test_common.h"
+#include <string.h>
+
+bool is_last_word (void *data)
+{
+  const char *word = (const char *) data;
+  return word[strlen (word) - 1] == '.';
+}
+
+int comp_word (const void *first, const void *second)
+{
+  return strcmp ((const char *) first, (const char *) second);
+}
+
+size_t hash_word (const void *data)
+{
+  size_t hash = 0;
+  for (const char *ptr = (const char *) data; *ptr != '\0'; ptr++)
+  {
+    hash = hash * 31 + (unsigned char) *ptr;
+  }
+  return hash;
+}
+
+size_t size_word (const void *data)
+{
+  return strlen ((const char *) data) + 1;
+}
+
+int word_index (const char *word, const char *const words[],
+                int num_of_words)
+{
+  for (int i = 0; i < num_of_words; i++)
+  {
+    if (strcmp (word, words[i]) == 0)
+    {
+      return i;
+    }
+  }
+  return -1;
+}
+
+MarkovChain *create_word_chain (void)
+{
+  LinkedList *database = calloc (1, sizeof (LinkedList));
+  MarkovChain *markov_chain = calloc (1, sizeof (MarkovChain));
+  if (database == NULL || markov_chain == NULL)
+  {
+    free (database);
+    free (markov_chain);
+    return NULL;
+  }
+  *markov_chain = (MarkovChain) {.database = database,
+                                 .comp_func = comp_word,
+                                 .is_last = is_last_word,
+                                 .hash_func = hash_word,
+                                 .size_func = size_word};
+  return markov_chain;
+}
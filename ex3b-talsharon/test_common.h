@@ -0,0 +1,33 @@
+#ifndef TEST_COMMON_H
+#define TEST_COMMON_H
+#include "markov_chain.h"
+#include <stddef.h>
+#include <stdbool.h>
+
+/**
+ * The word functions of the tests' chains: states are plain strings, a
+ * word ending with a dot ends a sequence, and they're copied into the
+ * chain's arena by their size.
+ */
+bool is_last_word (void *data);
+
+int comp_word (const void *first, const void *second);
+
+size_t hash_word (const void *data);
+
+size_t size_word (const void *data);
+
+/**
+ * Finds a word among the given words.
+ * @return it's index, -1 if it isn't one of them
+ */
+int word_index (const char *word, const char *const words[],
+                int num_of_words);
+
+/**
+ * Creates an empty chain of words, copied into it's arena.
+ * @return pointer to the new MarkovChain: upon success, NULL: otherwise
+ */
+MarkovChain *create_word_chain (void);
+
+#endif //TEST_COMMON_H
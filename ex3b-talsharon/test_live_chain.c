@@ -0,0 +1,196 @@
+#include "live_chain.h"
+#include "test_common.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define NUM_OF_WRITERS 4
+#define NUM_OF_READERS 4
+#define SEQUENCES_PER_WRITER 5000
+#define MAX_SEQUENCE_LEN 12
+#define COMPACT_EVERY 512
+#define MAX_TWEET_LENGTH 20
+#define NUM_OF_WORDS 16
+#define LAST_WORD (NUM_OF_WORDS - 1)
+#define READER_SEED 7
+#define ERR_MSG "test_live_chain: %s\n"
+#define OK_MSG "test_live_chain: %ld states appended, %ld sequences " \
+"generated, ok\n"
+
+/**
+ * The words of the sequences: a sequence goes from a word to one of the
+ * next two, and ends with the last one.
+ */
+static const char *const WORDS[NUM_OF_WORDS] = {
+    "w0", "w1", "w2", "w3", "w4", "w5", "w6", "w7", "w8", "w9", "w10",
+    "w11", "w12", "w13", "w14", "end."};
+
+/**
+ * A training thread, appending it's own sequences.
+ */
+typedef struct Writer {
+    LiveChain *live;
+    int index;
+    long num_of_states; // appended
+    bool success;
+} Writer;
+
+/**
+ * A generating thread, checking every sequence it generates.
+ */
+typedef struct Reader {
+    LiveChain *live;
+    int index;
+    const atomic_bool *writing;
+    long num_of_sequences; // generated
+    bool success;
+} Reader;
+
+/**
+ * Checks that a generated sequence only takes transitions the writers
+ * append.
+ */
+static bool is_valid_sequence (void *const states[], int len)
+{
+  for (int i = 0; i < len; i++)
+  {
+    int word = word_index ((const char *) states[i], WORDS, NUM_OF_WORDS);
+    if (word < 0 || (i == 0 && word == LAST_WORD))
+    {
+      return false;
+    }
+    if (i > 0)
+    {
+      int prev = word_index ((const char *) states[i - 1], WORDS,
+                             NUM_OF_WORDS);
+      if (word != LAST_WORD && word != prev + 1 && word != prev + 2)
+      {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+static void *write_sequences (void *arg)
+{
+  Writer *writer = (Writer *) arg;
+  Rng rng = rng_stream (writer->index, 0);
+  void *states[MAX_SEQUENCE_LEN + 1];
+  writer->success = true;
+  for (int n = 0; n < SEQUENCES_PER_WRITER && writer->success; n++)
+  {
+    int len = 0;
+    int word = rng_below (&rng, NUM_OF_WORDS / 2);
+    int max_len = 1 + rng_below (&rng, MAX_SEQUENCE_LEN);
+    while (len < max_len && word < LAST_WORD)
+    {
+      states[len++] = (void *) WORDS[word];
+      word += 1 + rng_below (&rng, 2);
+    }
+    states[len++] = (void *) WORDS[LAST_WORD];
+    writer->success = append_live_sequence (writer->live, states, len);
+    writer->num_of_states += len;
+  }
+  return NULL;
+}
+
+static void *read_sequences (void *arg)
+{
+  Reader *reader = (Reader *) arg;
+  int slot = register_live_reader (reader->live);
+  Rng rng = rng_stream (READER_SEED, (uint64_t) reader->index);
+  void *states[MAX_TWEET_LENGTH];
+  reader->success = slot != NO_LIVE_READER;
+  while (reader->success && atomic_load (reader->writing))
+  {
+    MarkovChain *snapshot = acquire_live_snapshot (reader->live, slot);
+    int len = 0;
+    if (generate_sequence_into (snapshot, NULL, MAX_TWEET_LENGTH, &rng,
+                                states, &len))
+    {
+      reader->success = is_valid_sequence (states, len);
+      reader->num_of_sequences++;
+    }
+    release_live_snapshot (reader->live, slot);
+  }
+  if (slot != NO_LIVE_READER)
+  {
+    unregister_live_reader (reader->live, slot);
+  }
+  return NULL;
+}
+
+/**
+ * Checks that the base chain holds every appended state once: the
+ * occurrences of it's states sum to the num of appended states.
+ */
+static bool is_fully_trained (const LiveChain *live, long num_of_states)
+{
+  long occurrences = 0;
+  for (Node *node_ptr = live->base->database->first; node_ptr != NULL;
+       node_ptr = node_ptr->next)
+  {
+    occurrences += node_ptr->data->occurrences;
+  }
+  return occurrences == num_of_states && live->delta_size == 0
+         && live->taken == NULL;
+}
+
+/**
+ * Appends and generates from several threads at once, then checks that
+ * the generated sequences are valid and nothing appended was lost.
+ */
+int main (void)
+{
+  MarkovChain *markov_chain = create_word_chain ();
+  LiveChain *live = markov_chain != NULL
+      ? create_live_chain (markov_chain, COMPACT_EVERY) : NULL;
+  if (live == NULL)
+  {
+    free_markov_chain (&markov_chain);
+    fprintf (stderr, ERR_MSG, "allocation error");
+    return EXIT_FAILURE;
+  }
+  atomic_bool writing;
+  atomic_init (&writing, true);
+  Writer writers[NUM_OF_WRITERS];
+  Reader readers[NUM_OF_READERS];
+  pthread_t writer_threads[NUM_OF_WRITERS];
+  pthread_t reader_threads[NUM_OF_READERS];
+  for (int i = 0; i < NUM_OF_READERS; i++)
+  {
+    readers[i] = (Reader) {live, i, &writing, 0, false};
+    pthread_create (&reader_threads[i], NULL, read_sequences, &readers[i]);
+  }
+  for (int i = 0; i < NUM_OF_WRITERS; i++)
+  {
+    writers[i] = (Writer) {live, i, 0, false};
+    pthread_create (&writer_threads[i], NULL, write_sequences, &writers[i]);
+  }
+  long num_of_states = 0;
+  bool success = true;
+  for (int i = 0; i < NUM_OF_WRITERS; i++)
+  {
+    pthread_join (writer_threads[i], NULL);
+    num_of_states += writers[i].num_of_states;
+    success = success && writers[i].success;
+  }
+  atomic_store (&writing, false);
+  long num_of_sequences = 0;
+  for (int i = 0; i < NUM_OF_READERS; i++)
+  {
+    pthread_join (reader_threads[i], NULL);
+    num_of_sequences += readers[i].num_of_sequences;
+    success = success && readers[i].success;
+  }
+  success = success && compact_live_chain (live)
+            && is_fully_trained (live, num_of_states);
+  free_live_chain (&live);
+  if (!success)
+  {
+    fprintf (stderr, ERR_MSG, "failed");
+    return EXIT_FAILURE;
+  }
+  fprintf (stdout, OK_MSG, num_of_states, num_of_sequences);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,339 @@
+#include "test_common.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define NUM_OF_CHAINS 3
+#define SEQUENCES_PER_CHAIN 2000
+#define NUM_OF_SAMPLES 200000
+#define MAX_TWEET_LENGTH 20
+#define NUM_OF_WORDS 13
+#define LAST_WORD (NUM_OF_WORDS - 1)
+#define CHAIN_WORDS 6 // words of a chain, from it's first one
+#define END_EVERY 6 // a sequence ends after a word once in END_EVERY
+#define MIN_SAMPLES 2000 // samples from a state to check it's distribution
+#define MAX_DISTANCE 0.03 // of sampled frequencies from the merged chain
+#define MIXTURE_SEED 11
+#define EPSILON 1e-9
+#define IMAGE_PATH "test_markov_chain.img"
+#define BAD_ID 0xFFFFFFFFU
+#define BAD_END 'x' // over the zero byte that ends an image's data
+#define ERR_MSG "test_markov_chain: %s\n"
+#define OK_MSG "test_markov_chain: ok\n"
+
+/**
+ * The words of the sequences: the chains train on overlapping ranges of
+ * them, so they share some states with different transitions.
+ */
+static const char *const WORDS[NUM_OF_WORDS] = {
+    "w0", "w1", "w2", "w3", "w4", "w5", "w6", "w7", "w8", "w9", "w10",
+    "w11", "end."};
+
+static const int FIRST_WORDS[NUM_OF_CHAINS] = {0, 3, 6};
+
+static const double WEIGHTS[NUM_OF_CHAINS] = {1, 3, 2};
+
+/**
+ * Trains a chain on a sequence of words, the way tweets_generator does.
+ * @return success/failure: false in case of allocation error
+ */
+static bool train_words (MarkovChain *markov_chain, const char *const words[],
+                         int len)
+{
+  Node *prev = NULL;
+  for (int i = 0; i < len; i++)
+  {
+    Node *node = add_to_database (markov_chain, (void *) words[i]);
+    if (node == NULL || (prev != NULL && !add_node_to_counter_list
+        (prev->data, node->data, markov_chain)))
+    {
+      return false;
+    }
+    prev = is_last_word (node->data->data) ? NULL : node;
+  }
+  return true;
+}
+
+/**
+ * Trains a chain on random sequences of it's range of words: each goes
+ * from a word to one of the next three, or ends.
+ * @return success/failure: false in case of allocation error
+ */
+static bool train_range (MarkovChain *markov_chain, int index)
+{
+  Rng rng = rng_stream ((uint64_t) index, 0);
+  const char *words[MAX_TWEET_LENGTH];
+  int first = FIRST_WORDS[index];
+  for (int n = 0; n < SEQUENCES_PER_CHAIN; n++)
+  {
+    int len = 0;
+    int word = first + rng_below (&rng, CHAIN_WORDS / 2);
+    while (len < MAX_TWEET_LENGTH - 1 && word < first + CHAIN_WORDS
+           && (len == 0 || rng_below (&rng, END_EVERY) != 0))
+    {
+      words[len++] = WORDS[word];
+      word += 1 + rng_below (&rng, 3);
+    }
+    words[len++] = WORDS[LAST_WORD];
+    if (!train_words (markov_chain, words, len))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * Gets the probability of a transition in a chain, by it's frequency.
+ */
+static double transition_prob (MarkovChain *markov_chain, int from, int to)
+{
+  Node *node = get_node_from_database (markov_chain, (void *) WORDS[from]);
+  if (node == NULL || node->data->counter_list_full_size == 0)
+  {
+    return 0;
+  }
+  const MarkovNode *markov_node = node->data;
+  for (int i = 0; i < markov_node->counter_list_size; i++)
+  {
+    if (word_index (markov_node->counter_list[i].markov_node->data, WORDS,
+                    NUM_OF_WORDS) == to)
+    {
+      return (double) markov_node->counter_list[i].frequency
+             / markov_node->counter_list_full_size;
+    }
+  }
+  return 0;
+}
+
+/**
+ * Samples sequences from a mixture and checks that the frequencies of
+ * their transitions, from every state sampled often enough, are close in
+ * total variation distance to the probabilities of the merged chain, which
+ * are exact for integer weights. A transition the merged chain doesn't
+ * have must never be sampled.
+ */
+static bool is_mixture_merged (const MixtureChain *mixture,
+                               MarkovChain *merged)
+{
+  static long counts[NUM_OF_WORDS][NUM_OF_WORDS];
+  long totals[NUM_OF_WORDS] = {0};
+  Rng rng = rng_stream (MIXTURE_SEED, 0);
+  void *states[MAX_TWEET_LENGTH];
+  for (int n = 0; n < NUM_OF_SAMPLES; n++)
+  {
+    int len = 0;
+    if (!generate_mixture_into (mixture, MAX_TWEET_LENGTH, &rng, states,
+                                &len))
+    {
+      return false;
+    }
+    for (int i = 1; i < len; i++)
+    {
+      int from = word_index (states[i - 1], WORDS, NUM_OF_WORDS);
+      int to = word_index (states[i], WORDS, NUM_OF_WORDS);
+      if (from < 0 || to < 0 || transition_prob (merged, from, to) == 0)
+      {
+        return false;
+      }
+      counts[from][to]++;
+      totals[from]++;
+    }
+  }
+  for (int from = 0; from < NUM_OF_WORDS; from++)
+  {
+    if (totals[from] < MIN_SAMPLES)
+    {
+      continue;
+    }
+    double distance = 0;
+    for (int to = 0; to < NUM_OF_WORDS; to++)
+    {
+      distance += fabs ((double) counts[from][to] / totals[from]
+                        - transition_prob (merged, from, to));
+    }
+    if (distance / 2 > MAX_DISTANCE)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * Checks a mixture of frozen chains against the chain they merge into, and
+ * that a chain that isn't frozen can't be mixed.
+ */
+static bool test_mixture (void)
+{
+  MarkovChain *chains[NUM_OF_CHAINS] = {NULL};
+  bool success = true;
+  for (int i = 0; i < NUM_OF_CHAINS && success; i++)
+  {
+    success = (chains[i] = create_word_chain ()) != NULL
+              && train_range (chains[i], i);
+  }
+  MixtureChain *mixture = NULL;
+  MarkovChain *merged = NULL;
+  if (success)
+  {
+    // not frozen yet
+    success = create_mixture_chain (chains, WEIGHTS, NUM_OF_CHAINS) == NULL;
+    for (int i = 0; i < NUM_OF_CHAINS && success; i++)
+    {
+      success = freeze_markov_chain (chains[i]);
+    }
+  }
+  success = success
+            && (merged = merge_markov_chains (chains, WEIGHTS,
+                                              NUM_OF_CHAINS)) != NULL
+            && (mixture = create_mixture_chain (chains, WEIGHTS,
+                                                NUM_OF_CHAINS)) != NULL
+            && is_mixture_merged (mixture, merged);
+  free_mixture_chain (&mixture);
+  free_markov_chain (&merged);
+  for (int i = 0; i < NUM_OF_CHAINS; i++)
+  {
+    free_markov_chain (&chains[i]);
+  }
+  return success;
+}
+
+static bool is_close (double value, double expected)
+{
+  return value == expected || fabs (value - expected) < EPSILON;
+}
+
+/**
+ * Scores sequences of a tiny corpus by hand: a b c. / a b b c. / a c.,
+ * so a goes to b 2 of 3 times and to c. once, b to c. 2 of 3 times and to
+ * itself once, among 3 states.
+ */
+static bool test_scores (void)
+{
+  static const char *const CORPUS[] = {"a", "b", "c.", "a", "b", "b", "c.",
+                                       "a", "c."};
+  MarkovChain *markov_chain = create_word_chain ();
+  if (markov_chain == NULL
+      || !train_words (markov_chain, CORPUS,
+                       sizeof (CORPUS) / sizeof (CORPUS[0])))
+  {
+    free_markov_chain (&markov_chain);
+    return false;
+  }
+  void *seen[] = {"a", "b", "c."};
+  void *repeated[] = {"a", "b", "b", "c."};
+  void *unseen[] = {"b", "a"};
+  void *after_last[] = {"c.", "a", "b"}; // c. to a isn't scored
+  void *to_last[] = {"a", "c."};
+  void *from_unknown[] = {"z", "a"};
+  void *to_unknown[] = {"a", "z"};
+  void **const sequences[] = {seen, repeated, unseen, after_last, to_last,
+                              from_unknown, to_unknown};
+  const int lengths[] = {3, 4, 2, 3, 2, 2, 2};
+  int num_of_sequences = sizeof (lengths) / sizeof (lengths[0]);
+  const double expected[] = {
+      2 * log (2.0 / 3), 2 * log (2.0 / 3) + log (1.0 / 3), -INFINITY,
+      log (2.0 / 3), log (1.0 / 3), -INFINITY, -INFINITY};
+  // with smoothing 1, n + a*v is 3 + 3 for a and b
+  const double smoothed[] = {
+      2 * log (3.0 / 6), 2 * log (3.0 / 6) + log (2.0 / 6), log (1.0 / 6),
+      log (3.0 / 6), log (2.0 / 6), log (1.0 / 3), log (1.0 / 6)};
+  double log_probs[sizeof (lengths) / sizeof (lengths[0])];
+  bool success = score_sequences (markov_chain, sequences, lengths,
+                                  num_of_sequences, 0, 2, log_probs);
+  for (int i = 0; i < num_of_sequences && success; i++)
+  {
+    success = is_close (log_probs[i], expected[i]);
+  }
+  success = success && score_sequences (markov_chain, sequences, lengths,
+                                        num_of_sequences, 1, 2, log_probs);
+  for (int i = 0; i < num_of_sequences && success; i++)
+  {
+    success = is_close (log_probs[i], smoothed[i]);
+  }
+  free_markov_chain (&markov_chain);
+  return success;
+}
+
+/**
+ * Writes size bytes over the saved image at offset, then checks that it
+ * doesn't load.
+ */
+static bool is_rejected (long offset, const void *bytes, size_t size)
+{
+  FILE *fp = fopen (IMAGE_PATH, "r+b");
+  if (fp == NULL)
+  {
+    return false;
+  }
+  bool success = fseek (fp, offset, SEEK_SET) == 0
+                 && fwrite (bytes, size, 1, fp) == 1;
+  MarkovChain *loaded = NULL;
+  success = fclose (fp) == 0 && success
+            && (loaded = create_word_chain ()) != NULL
+            && !load_markov_chain (loaded, IMAGE_PATH);
+  free_markov_chain (&loaded);
+  return success;
+}
+
+/**
+ * Saves a frozen chain, loads it back, then checks that the image doesn't
+ * load once a successor id in it is out of range, or once it's data
+ * doesn't end in a zero byte.
+ */
+static bool test_load (void)
+{
+  MarkovChain *markov_chain = create_word_chain ();
+  MarkovChain *loaded = create_word_chain ();
+  bool success = markov_chain != NULL && loaded != NULL
+                 && train_range (markov_chain, 0)
+                 && freeze_markov_chain (markov_chain)
+                 && save_markov_chain (markov_chain, IMAGE_PATH)
+                 && load_markov_chain (loaded, IMAGE_PATH);
+  void *states[MAX_TWEET_LENGTH];
+  int len = 0;
+  success = success && generate_sequence_into (loaded, NULL, MAX_TWEET_LENGTH,
+                                               NULL, states, &len);
+  free_markov_chain (&loaded);
+  if (success)
+  {
+    const CompiledChain *compiled = markov_chain->compiled;
+    uint32_t bad_id = BAD_ID;
+    char bad_end = BAD_END;
+    success = is_rejected ((const char *) compiled->successors
+                           - (const char *) compiled->image,
+                           &bad_id, sizeof (bad_id))
+              && save_markov_chain (markov_chain, IMAGE_PATH)
+              && is_rejected ((long) compiled->image_size - 1, &bad_end,
+                              sizeof (bad_end));
+  }
+  remove (IMAGE_PATH);
+  free_markov_chain (&markov_chain);
+  return success;
+}
+
+/**
+ * Checks generating from a mixture, scoring sequences and loading images
+ * against what they are defined by.
+ */
+int main (void)
+{
+  if (!test_mixture ())
+  {
+    fprintf (stderr, ERR_MSG, "mixture doesn't match the merged chain");
+    return EXIT_FAILURE;
+  }
+  if (!test_scores ())
+  {
+    fprintf (stderr, ERR_MSG, "scores don't match the corpus");
+    return EXIT_FAILURE;
+  }
+  if (!test_load ())
+  {
+    fprintf (stderr, ERR_MSG, "a corrupt image was loaded");
+    return EXIT_FAILURE;
+  }
+  fprintf (stdout, OK_MSG);
+  return EXIT_SUCCESS;
+}
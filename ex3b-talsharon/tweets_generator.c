@@ -1,23 +1,45 @@
 #include "markov_chain.h"
+#include "string_pool.h"
+#include "corpus.h"
+#include "ngram.h"
+#include "sequence_writer.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <stdint.h>
 
 #define SEED_ARG 1
 #define TWEET_NUM_ARG 2
 #define INPUT_FILE_ARG 3
 #define MAX_FILE_WORDS_ARG 4
+#define MODEL_FILE_ARG 5
+#define MARKOV_ORDER_ARG 6
+#define SKETCH_BUDGET_ARG 7
+#define RAND_COMPAT_ARG 8
 #define MIN_ARG_LEN 4
-#define MAX_ARG_LEN 5
-#define MAX_LINE_LEN 1000
+#define MAX_ARG_LEN 9
 #define INT_BASE 10
 #define MAX_TWEET_LENGTH 20
-#define INPUT_LEN_ERR_MSG "Usage: The program receives 3 or 4 arguments \
-only\n"
+#define MAX_TRAIN_SHARDS 64
+#define MIN_TWEETS_PER_THREAD 1024
+#define TWEETS_PER_FLUSH 65536
+#define TWEET_MSG_MAX_LEN 32
+#define BYTES_PER_KB 1024
+#define APPROX_PROMOTE_THRESHOLD 2
+#define APPROX_PRUNE_EVERY 1000000
+#define INPUT_LEN_ERR_MSG "Usage: The program receives 3 to 8 arguments \
+only\n\
+tweets_generator seed tweets input [max words] [model file] [order] \
+[sketch KB] [rand compat]\n\
+A non zero rand compat draws every tweet from srand(seed) and rand() in \
+one stream, so a seed gives the same tweets as the first version did\n"
 #define OPEN_FILE_ERR_MSG "Error: Failed to read the given input file\n"
+#define SAVE_FILE_ERR_MSG "Error: Failed to write the given model file\n"
 #define TWEET_MSG "Tweet %d: "
-#define REG_PRINT "%s "
-#define LAST_PRINT_MSG "%s\n"
+#define REG_PRINT "%.*s "
+#define LAST_PRINT_MSG "%.*s\n"
 
 /**
  * Checks if given arguments from command line are valid
@@ -27,47 +49,148 @@ only\n"
 int is_arg_valid (int argc);
 
 /**
- * Opens the given input file from the command line given path
+ * Maps the given input file from the command line given path to memory
  * @param argv command line's arguments
- * @return pointer to the file: upon success, NULL: otherwise
+ * @return pointer to the Corpus: upon success, NULL: otherwise
  */
-FILE *get_file (char *const *argv);
+Corpus *get_corpus (char *const *argv);
+
+/**
+ * Trains the MarkovChain on the input file given in the command line,
+ * freezes it unless it draws from rand(), and saves it if a model file is
+ * given.
+ * @param argc number of arguments given from command line
+ * @param argv command line's arguments
+ * @param markov_chain pointer to MarkovChain
+ * @param pool pointer to StringPool the words are interned in
+ * @param ngrams pointer to NGramPool the states are interned in, NULL for
+ *               a first order chain, whose states are the words
+ * @return 0: upon success, 1: otherwise
+ */
+int learn (int argc, char *argv[], MarkovChain *markov_chain,
+           StringPool *pool, NGramPool *ngrams);
 
 /**
  * Initiates the MarkovChain and it's database, allocates needed memory.
+ * @param order num of words in a state: 1 for InternedStr states, more
+ *              for NGram states
  * @return pointer to MarkovChain: upon success, NULL: otherwise
  */
-MarkovChain *initiate_tweets_database ();
+MarkovChain *initiate_tweets_database (int order);
 
 /**
  * Processes a line in the learning stage of the program
  * @param markov_chain pointer to MarkovChain
- * @param tweet pointer to char: a tweet - a line.
+ * @param pool pointer to StringPool the words are interned in
+ * @param ngrams pointer to NGramPool for an order-k chain, NULL otherwise.
+ *               A state is a window of the last k words, windows don't
+ *               cross the end of a sentence.
+ * @param tweet pointer to char: a tweet - a line, not '\0' terminated.
+ * @param len length of the tweet
  * @param words_to_read int: max number of words to be read from th input
+ * @param rand_compat true to read the words as the first version did, by
+ *                    next_strtok_token, with len past the line's '\n'
  * @return pointer to the MarkovChain: upon success, NULL: otherwise
  */
-MarkovChain *process_single_tweet (MarkovChain *markov_chain, char tweet[],
-                                   int words_to_read);
+MarkovChain *process_single_tweet (MarkovChain *markov_chain,
+                                   StringPool *pool, NGramPool *ngrams,
+                                   const char *tweet, size_t len,
+                                   int words_to_read, bool rand_compat);
 
 /**
  * Processes a word in the learning stage of the program
- * If the word is not in the given MarkovChain, adds it to the chain's database
- * Adds the word's node to the previous node's counter list
+ * If the word's state is not in the given MarkovChain, adds it to the
+ * chain's database
+ * Adds the state's node to the previous node's counter list
  * @param markov_chain pointer to MarkovChain
- * @param data pointer to char, the data/word to be processed
+ * @param state pointer to InternedStr or NGram, the state ending at the
+ *              word
  * @param prev pointer to Node, the previous node is the MarkovChain
  * @return pointer to the new Node: upon success, NULL: otherwise
  */
-Node *process_word (MarkovChain *markov_chain, char data[], Node *prev);
+Node *process_word (MarkovChain *markov_chain, const void *state,
+                    Node *prev);
+
+/**
+ * process_word of a single word state, by the chain's functions
+ * specialized for InternedStr states.
+ */
+Node *process_string (MarkovChain *markov_chain, const InternedStr *word,
+                      Node *prev);
 
 /**
  * Fills the MarkovChain's database - The learning stage of the program.
- * @param fp pointer to FILE: the input file
+ * Words are read right out of the text, there is no line length limit.
+ * @param text pointer to char: the input text
+ * @param size size of the input text
  * @param words_to_read int: max number of words to be read from the input
  * @param markov_chain pointer to MarkovChain
+ * @param pool pointer to StringPool the words are interned in
+ * @param ngrams pointer to NGramPool for an order-k chain, NULL otherwise
+ * @param rand_compat true to read the words as the first version did, so
+ *                    it's database has the same states in the same order
  * @return 0: upon success, 1: otherwise
  */
-int fill_database (FILE *fp, int words_to_read, MarkovChain *markov_chain);
+int fill_database (const char *text, size_t size, int words_to_read,
+                   MarkovChain *markov_chain, StringPool *pool,
+                   NGramPool *ngrams, bool rand_compat);
+
+/**
+ * A line-aligned part of the input, trained into it's own chain and pool
+ * by one thread.
+ */
+typedef struct TrainShard {
+    const char *text;
+    size_t size;
+    MarkovChain *markov_chain;
+    StringPool *pool;
+    int status; // fill_database result
+} TrainShard;
+
+/**
+ * A merge of one shard's chain into another shard's chain.
+ */
+typedef struct MergeTask {
+    MarkovChain *dst;
+    MarkovChain *src;
+    bool success;
+} MergeTask;
+
+/**
+ * A contiguous range of tweets generated by one thread into a buffer of
+ * it's own.
+ */
+typedef struct GenerateTask {
+    MarkovChain *markov_chain;
+    int first; // index of the range's first tweet
+    int count;
+    int order; // num of words in a state
+    uint64_t seed;
+    bool rand_compat; // draw from the chain's rand() stream, in order
+    SequenceWriter output; // the range's tweets, kept between rounds
+    int status; // 0 on success, 1 if the buffer couldn't be written
+} GenerateTask;
+
+/**
+ * Fills the MarkovChain's database from all of the input in parallel.
+ * The input is split into line-aligned shards, each trained by it's own
+ * thread into a chain and pool of it's own with no locking, and the shard
+ * chains are then merged pairwise in parallel rounds. The result equals a
+ * sequential fill_database of the whole input, up to database order.
+ * @param corpus pointer to Corpus: the input
+ * @param markov_chain pointer to MarkovChain, gets the first shard
+ * @param pool pointer to StringPool, keeps the other shards' pools alive
+ * @param num_of_shards int: num of threads to train with
+ * @return 0: upon success, 1: otherwise
+ */
+int fill_database_parallel (const Corpus *corpus, MarkovChain *markov_chain,
+                            StringPool *pool, int num_of_shards);
+
+/**
+ * Gets the num of threads to train with: one per online processor.
+ * @return int: the num of shards
+ */
+int get_num_of_shards ();
 
 /**
  * Gets the random seed given in the command line
@@ -93,58 +216,134 @@ int get_words_to_read (int argc, char *const *argv);
 int get_tweet_num (char *const *argv);
 
 /**
- * Generates random tweets by the given number in the command line
+ * Gets the order of the chain given in the command line: the num of words
+ * each state holds
+ * @param argc number of arguments given from command line
  * @param argv command line's arguments
- * @param markov_chain pointer to MarkovChain
+ * @return int: the order, 1 if not given
+ */
+int get_order (int argc, char *const *argv);
+
+/**
+ * Gets the sketch budget of approximate training given in the command line
+ * @param argc number of arguments given from command line
+ * @param argv command line's arguments
+ * @return size_t: the budget in bytes, 0 if not given: exact training
  */
-void generate (char *argv[], MarkovChain *markov_chain);
+size_t get_sketch_budget (int argc, char *const *argv);
+
+/**
+ * Checks if the rand compat flag is given in the command line: training
+ * and generating in order, drawing from srand(seed) and rand() the way the
+ * first version did, instead of from xoshiro256** streams of the seed.
+ * @param argc number of arguments given from command line
+ * @param argv command line's arguments
+ * @return true: if it's given and non zero, false: otherwise
+ */
+bool is_rand_compat (int argc, char *const *argv);
+
+/**
+ * Generates random tweets by the given number in the command line.
+ * Tweet n is drawn from it's own random stream of the seed, so the output
+ * is the same for any num of threads: in rounds of TWEETS_PER_FLUSH,
+ * contiguous ranges of tweets are generated in parallel into buffers,
+ * which are then written in order by a single write. In rand compat all
+ * tweets are drawn in order from rand(), by one thread.
+ * @param argc number of arguments given from command line
+ * @param argv command line's arguments
+ * @param markov_chain pointer to MarkovChain, frozen unless rand compat
+ * @param order num of words in a state of the chain
+ * @return 0: upon success, 1: otherwise
+ */
+int generate (int argc, char *argv[], MarkovChain *markov_chain, int order);
+
+/**
+ * Gets the num of threads to generate num_of_tweets with: one per online
+ * processor, but no more than one per MIN_TWEETS_PER_THREAD tweets.
+ */
+int get_num_of_generators (int num_of_tweets);
+
+bool ends_with_dot (const char *str, size_t len)
+{
+  return len > 0 && str[len - 1] == '.';
+}
 
 bool is_last_str (void *data)
 {
-  char *string = (char*) data;
-  if (string[strlen (string) - 1] == '.')
-  {
-    return true;
-  }
-  return false;
+  const InternedStr *string = (const InternedStr*) data;
+  return string->is_last;
 }
 
 int comp_str (const void *first, const void *second)
 {
-  char *str1 = (char*) first;
-  char *str2 = (char*) second;
-  return strcmp (str1, str2);
+  return comp_interned ((const InternedStr*) first,
+                        (const InternedStr*) second);
+}
+
+size_t size_str (const void *data)
+{
+  const InternedStr *string = (const InternedStr*) data;
+  return sizeof (InternedStr) + string->len + 1;
 }
 
-void free_str (void *data)
+size_t hash_str (const void *data)
 {
-  char *string = (char*) data;
-  free (string);
-  string = NULL;
+  const InternedStr *string = (const InternedStr*) data;
+  return (size_t) string->hash;
 }
 
 void* copy_str (const void *data)
 {
-  char *string = (char*) data;
-  char *temp = malloc (sizeof (char)* (strlen (string) +1));
-  if (temp == NULL)
-  {
-    return NULL;
-  }
-  memcpy (temp, string, sizeof (char)* (strlen (string) +1));
-  void *ret = (void*) temp;
-  return ret;
+  return (void*) data; // the pool owns the words, states point to them
 }
 
 void print_str (void *data) {
-  if (is_last_str (data))
+  const InternedStr *string = (const InternedStr*) data;
+  if (string->is_last)
   {
-    char *string = (char*) data;
-    fprintf (stdout, LAST_PRINT_MSG, string);
+    fprintf (stdout, LAST_PRINT_MSG, (int) string->len, string->str);
     return;
   }
-  char *string = (char*) data;
-  fprintf ( stdout, REG_PRINT, string);
+  fprintf (stdout, REG_PRINT, (int) string->len, string->str);
+}
+
+bool is_last_ngram (void *data)
+{
+  const NGram *ngram = (const NGram*) data;
+  return ngram->word->is_last;
+}
+
+int comp_ngram (const void *first, const void *second)
+{
+  // one pool interns all of the chain's tuples: equal means same pointer
+  return (first > second) - (first < second);
+}
+
+size_t hash_ngram (const void *data)
+{
+  const NGram *ngram = (const NGram*) data;
+  return (size_t) ngram->key;
+}
+
+void* copy_ngram (const void *data)
+{
+  return (void*) data; // the pool owns the tuples, states point to them
+}
+
+void print_ngram (void *data)
+{
+  const NGram *ngram = (const NGram*) data;
+  print_str ((void*) ngram->word);
+}
+
+void print_first_ngram (void *data)
+{
+  const NGram *ngram = (const NGram*) data;
+  if (ngram->context != NULL)
+  {
+    print_first_ngram ((void*) ngram->context);
+  }
+  print_str ((void*) ngram->word);
 }
 
 /**
@@ -154,55 +353,121 @@ void print_str (void *data) {
  * @param argv command line's arguments
                 1) seed for rand function
                 2) number of tweets to be generated
-                3) input file directory
+                3) input file directory, a corpus or a model file saved
+                   by a previous run
                 4) optional: max words to take from input file,
-                   if not given: reads until EOF
+                   if not given or 0: reads until EOF
+                5) optional: model file to save the trained chain to,
+                   if empty: not saved. Only first order chains are saved.
+                6) optional: order of the chain, the num of words the
+                   next word depends on, if not given: 1
+                7) optional: sketch budget in KB of approximate
+                   training, which keeps only transitions seen at least
+                   twice. If not given or 0: exact training
+                8) optional: rand compat, if non zero: the tweets are
+                   drawn from srand(seed) and rand() in order, the ones
+                   the first version generates for the seed
  * @return 0: upon success, 1: otherwise
  */
 int main (int argc, char *argv[])
 {
-  srand (get_seed (argv));
   if (is_arg_valid (argc) != 0)
   {
     return EXIT_FAILURE;
   }
-  FILE *input_file = get_file (argv);
-  if (input_file == NULL)
+  int order = get_order (argc, argv);
+  MarkovChain *markov_chain = initiate_tweets_database (order);
+  StringPool *pool = create_string_pool (ends_with_dot);
+  NGramPool *ngrams = order > 1 ? create_ngram_pool ((uint32_t) order) : NULL;
+  if (markov_chain == NULL || pool == NULL || (order > 1 && ngrams == NULL))
   {
+    if (markov_chain != NULL)
+    {
+      free_markov_chain (&markov_chain);
+    }
+    free_string_pool (&pool);
+    free_ngram_pool (&ngrams);
     return EXIT_FAILURE;
   }
-  MarkovChain *markov_chain = initiate_tweets_database ();
-  if (markov_chain == NULL)
+  if (is_rand_compat (argc, argv))
   {
-    fclose (input_file);
-    return EXIT_FAILURE;
+    srand ((unsigned int) get_seed (argv));
+    markov_chain->rng = (Rng) {.kind = RNG_RAND};
   }
-  int words_to_read = get_words_to_read (argc, argv);
-  if (fill_database(input_file, words_to_read, markov_chain) == 1)
+  else
+  {
+    markov_chain->rng = rng_seed ((uint64_t) (unsigned int) get_seed (argv));
+  }
+  // a saved model is generated from as is, any other file is a corpus
+  if ((order > 1 || !load_markov_chain (markov_chain, argv[INPUT_FILE_ARG]))
+      && learn (argc, argv, markov_chain, pool, ngrams) != 0)
   {
     free_markov_chain (&markov_chain);
-    fclose (input_file);
-    fprintf (stdout , ALLOCATION_ERROR_MASSAGE);
+    free_string_pool (&pool);
+    free_ngram_pool (&ngrams);
     return EXIT_FAILURE;
   }
-  generate (argv, markov_chain);
+  int status = generate (argc, argv, markov_chain, order);
   free_markov_chain (&markov_chain);
-  fclose (input_file);
-  return EXIT_SUCCESS;
+  free_string_pool (&pool);
+  free_ngram_pool (&ngrams);
+  return status == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
-void generate (char *argv[], MarkovChain *markov_chain)
+int learn (int argc, char *argv[], MarkovChain *markov_chain,
+           StringPool *pool, NGramPool *ngrams)
 {
-  for (int n = 0; n < get_tweet_num (argv); n++)
+  Corpus *corpus = get_corpus (argv);
+  if (corpus == NULL)
+  {
+    return 1;
+  }
+  int words_to_read = get_words_to_read (argc, argv);
+  int num_of_shards = get_num_of_shards ();
+  size_t sketch_budget = get_sketch_budget (argc, argv);
+  if (sketch_budget > 0
+      && !start_approximate_training (markov_chain, sketch_budget,
+                                      APPROX_PROMOTE_THRESHOLD,
+                                      APPROX_PRUNE_EVERY))
+  {
+    close_corpus (&corpus);
+    fprintf (stdout , ALLOCATION_ERROR_MASSAGE);
+    return 1;
+  }
+  bool rand_compat = is_rand_compat (argc, argv);
+  // a words limit depends on the order words are read, train it in order.
+  // order-k states are interned in one pool, and sketches can't be merged:
+  // they are trained in order too, and so is a rand compat chain, whose
+  // draws pick states by their database order
+  int fill_status = (words_to_read == 0 && num_of_shards > 1 && ngrams == NULL
+                     && sketch_budget == 0 && !rand_compat)
+                    ? fill_database_parallel (corpus, markov_chain, pool,
+                                              num_of_shards)
+                    : fill_database (corpus->text, corpus->size,
+                                     words_to_read, markov_chain, pool,
+                                     ngrams, rand_compat);
+  close_corpus (&corpus);
+  // generate from the compiled chain, and save it as compiled. A rand
+  // compat chain draws from it's counter lists, the way the first version
+  // did
+  if (fill_status == 1
+      || (!rand_compat && !freeze_markov_chain (markov_chain)))
+  {
+    fprintf (stdout , ALLOCATION_ERROR_MASSAGE);
+    return 1;
+  }
+  if (argc > MODEL_FILE_ARG && argv[MODEL_FILE_ARG][0] != '\0'
+      && !save_markov_chain (markov_chain, argv[MODEL_FILE_ARG]))
   {
-    fprintf (stdout, TWEET_MSG, n+1);
-    generate_random_sequence (markov_chain, NULL, MAX_TWEET_LENGTH);
+    fprintf (stdout, SAVE_FILE_ERR_MSG);
+    return 1;
   }
+  return 0;
 }
 
 int get_words_to_read (int argc, char *const *argv)
 {
-  if (argc == MAX_ARG_LEN)
+  if (argc > MAX_FILE_WORDS_ARG)
   {
     char *ptr;
     long words_to_read = strtol (argv[MAX_FILE_WORDS_ARG], &ptr,
@@ -213,6 +478,44 @@ int get_words_to_read (int argc, char *const *argv)
   return 0;
 }
 
+int get_order (int argc, char *const *argv)
+{
+  if (argc > MARKOV_ORDER_ARG)
+  {
+    char *ptr;
+    long order = strtol (argv[MARKOV_ORDER_ARG], &ptr, INT_BASE);
+    if (order > 1 && order < MAX_TWEET_LENGTH)
+    {
+      return (int) order;
+    }
+  }
+  return 1;
+}
+
+size_t get_sketch_budget (int argc, char *const *argv)
+{
+  if (argc > SKETCH_BUDGET_ARG)
+  {
+    char *ptr;
+    long budget = strtol (argv[SKETCH_BUDGET_ARG], &ptr, INT_BASE);
+    if (budget > 0)
+    {
+      return (size_t) budget * BYTES_PER_KB;
+    }
+  }
+  return 0;
+}
+
+bool is_rand_compat (int argc, char *const *argv)
+{
+  if (argc > RAND_COMPAT_ARG)
+  {
+    char *ptr;
+    return strtol (argv[RAND_COMPAT_ARG], &ptr, INT_BASE) != 0;
+  }
+  return false;
+}
+
 int get_seed (char *const *argv)
 {
   char *ptr;
@@ -227,9 +530,10 @@ int get_tweet_num (char *const *argv)
   return (int) tweet_num;
 }
 
-Node *process_word (MarkovChain *markov_chain, char data[], Node *prev)
+Node *process_word (MarkovChain *markov_chain, const void *state,
+                    Node *prev)
 {
-  Node *node = add_to_database(markov_chain, data);
+  Node *node = add_to_database(markov_chain, (void*) state);
   if (node == NULL)
   {
     return NULL;
@@ -244,43 +548,94 @@ Node *process_word (MarkovChain *markov_chain, char data[], Node *prev)
   return node;
 }
 
-MarkovChain *process_single_tweet (MarkovChain *markov_chain, char tweet[],
-                                   int words_to_read)
+Node *process_string (MarkovChain *markov_chain, const InternedStr *word,
+                      Node *prev)
+{
+  Node *node = add_string_to_database (markov_chain, word);
+  if (node == NULL)
+  {
+    return NULL;
+  }
+  if (prev != NULL
+      && !add_string_to_counter_list (prev->data, node->data, markov_chain))
+  {
+    return NULL;
+  }
+  return node;
+}
+
+MarkovChain *process_single_tweet (MarkovChain *markov_chain,
+                                   StringPool *pool, NGramPool *ngrams,
+                                   const char *tweet, size_t len,
+                                   int words_to_read, bool rand_compat)
 {
-  const char space[2] = " ";
-  char *data = strtok(tweet, space);
-  data[strcspn(data, "\n")] = '\0';
-  data[strcspn(data, "\r\n")] = '\0';
+  const char *cur = tweet;
+  const char *end = tweet + len;
+  size_t word_len = 0;
+  const char *data = rand_compat ? next_strtok_token (&cur, end, &word_len)
+                                 : next_token (&cur, end, &word_len);
   Node *prev_node = NULL;
+  const NGram *window = NULL;
   while (data != NULL &&
   (markov_chain->database->size < words_to_read || words_to_read == 0))
   {
-    Node *new_node = process_word (markov_chain, data, prev_node);
-    if (new_node == NULL)
+    const InternedStr *word = intern_str (pool, data, word_len);
+    if (word == NULL)
     {
       return NULL;
     }
-    data = strtok(NULL, space);
-    if (data != NULL)
+    data = rand_compat ? next_strtok_token (&cur, end, &word_len)
+                       : next_token (&cur, end, &word_len);
+    if (ngrams != NULL)
     {
-      data[strcspn(data, "\n")] = '\0';
-      data[strcspn(data, "\r\n")] = '\0';
+      window = shift_ngram (ngrams, window, word);
+      if (window == NULL)
+      {
+        return NULL;
+      }
+      if (window->order < ngrams->order) // not a full state yet
+      {
+        window = word->is_last ? NULL : window; // too short a sentence
+        continue;
+      }
+    }
+    Node *new_node = ngrams != NULL
+                     ? process_word (markov_chain, window, prev_node)
+                     : process_string (markov_chain, word, prev_node);
+    if (new_node == NULL)
+    {
+      return NULL;
     }
     prev_node = new_node;
+    if (ngrams != NULL && word->is_last) // the next sentence starts afresh
+    {
+      window = NULL;
+      prev_node = NULL;
+    }
   }
   return markov_chain;
 }
 
-int fill_database (FILE *fp, int words_to_read, MarkovChain *markov_chain)
+int fill_database (const char *text, size_t size, int words_to_read,
+                   MarkovChain *markov_chain, StringPool *pool,
+                   NGramPool *ngrams, bool rand_compat)
 {
+  const char *cur = text;
+  const char *end = text + size;
   while (words_to_read == 0 || markov_chain->database->size < words_to_read)
   {
-    char tweet[MAX_LINE_LEN];
-    if (fgets (tweet, MAX_LINE_LEN, fp) == NULL)
+    size_t len = 0;
+    const char *tweet = next_line (&cur, end, &len);
+    if (tweet == NULL)
     {
       break;
     }
-    if (process_single_tweet (markov_chain, tweet, words_to_read) == NULL)
+    if (rand_compat && cur > tweet + len) // it's '\n' makes a token too
+    {
+      len++;
+    }
+    if (process_single_tweet (markov_chain, pool, ngrams, tweet, len,
+                              words_to_read, rand_compat) == NULL)
     {
       return 1;
     }
@@ -288,7 +643,151 @@ int fill_database (FILE *fp, int words_to_read, MarkovChain *markov_chain)
   return 0;
 }
 
-MarkovChain *initiate_tweets_database ()
+int get_num_of_shards ()
+{
+  long num_of_cpus = sysconf (_SC_NPROCESSORS_ONLN);
+  if (num_of_cpus < 1)
+  {
+    return 1;
+  }
+  return num_of_cpus < MAX_TRAIN_SHARDS ? (int) num_of_cpus : MAX_TRAIN_SHARDS;
+}
+
+/**
+ * Trains a shard, the thread routine of fill_database_parallel.
+ * @param arg pointer to TrainShard
+ */
+static void *train_shard (void *arg)
+{
+  TrainShard *shard = (TrainShard*) arg;
+  shard->status = fill_database (shard->text, shard->size, 0,
+                                 shard->markov_chain, shard->pool, NULL,
+                                 false);
+  return NULL;
+}
+
+/**
+ * Merges a shard chain into another, the thread routine of
+ * fill_database_parallel.
+ * @param arg pointer to MergeTask
+ */
+static void *merge_shards (void *arg)
+{
+  MergeTask *task = (MergeTask*) arg;
+  task->success = merge_markov_chain_into (task->dst, task->src);
+  return NULL;
+}
+
+/**
+ * Runs routine on each of num_of_args args, each in a thread of it's own
+ * (the first one in the calling thread), and waits for all of them.
+ */
+static void run_threads (void *(*routine) (void *), void *args,
+                         size_t arg_size, int num_of_args)
+{
+  pthread_t threads[MAX_TRAIN_SHARDS];
+  bool started[MAX_TRAIN_SHARDS] = {false};
+  for (int i = 1; i < num_of_args; i++)
+  {
+    started[i] = pthread_create (&threads[i], NULL, routine,
+                                 (char*) args + i * arg_size) == 0;
+  }
+  for (int i = 0; i < num_of_args; i++)
+  {
+    if (i == 0 || !started[i]) // no thread for it: run it here
+    {
+      routine ((char*) args + i * arg_size);
+    }
+  }
+  for (int i = 1; i < num_of_args; i++)
+  {
+    if (started[i])
+    {
+      pthread_join (threads[i], NULL);
+    }
+  }
+}
+
+/**
+ * Frees the chains and pools of all shards but the first, which are the
+ * caller's.
+ */
+static void free_shards (TrainShard shards[], int num_of_shards)
+{
+  for (int i = 1; i < num_of_shards; i++)
+  {
+    if (shards[i].markov_chain != NULL)
+    {
+      free_markov_chain (&shards[i].markov_chain);
+    }
+    free_string_pool (&shards[i].pool);
+  }
+}
+
+int fill_database_parallel (const Corpus *corpus, MarkovChain *markov_chain,
+                            StringPool *pool, int num_of_shards)
+{
+  const char *text = corpus->text;
+  size_t size = corpus->size;
+  TrainShard shards[MAX_TRAIN_SHARDS] = {{0}};
+  size_t start = 0;
+  for (int i = 0; i < num_of_shards; i++)
+  {
+    size_t end = start + (size - start) / (num_of_shards - i);
+    const char *newline = end < size ? memchr (text + end, '\n', size - end)
+                                     : NULL;
+    end = (newline == NULL || i == num_of_shards - 1)
+          ? size : (size_t) (newline - text) + 1;
+    shards[i] = (TrainShard) {text + start, end - start, markov_chain, pool,
+                              0};
+    if (i > 0)
+    {
+      shards[i].markov_chain = initiate_tweets_database (1);
+      shards[i].pool = create_string_pool (ends_with_dot);
+      if (shards[i].markov_chain == NULL || shards[i].pool == NULL)
+      {
+        free_shards (shards, i + 1);
+        return 1;
+      }
+    }
+    start = end;
+  }
+  run_threads (train_shard, shards, sizeof (TrainShard), num_of_shards);
+  int status = 0;
+  for (int i = 0; i < num_of_shards; i++)
+  {
+    status |= shards[i].status;
+  }
+  // parallel reduction: in each round merge every other remaining chain
+  // into it's neighbour
+  for (int step = 1; step < num_of_shards && status == 0; step *= 2)
+  {
+    MergeTask tasks[MAX_TRAIN_SHARDS];
+    int num_of_tasks = 0;
+    for (int i = 0; i + step < num_of_shards; i += 2 * step)
+    {
+      tasks[num_of_tasks++] = (MergeTask) {shards[i].markov_chain,
+                                           shards[i + step].markov_chain,
+                                           false};
+    }
+    run_threads (merge_shards, tasks, sizeof (MergeTask), num_of_tasks);
+    for (int i = 0; i < num_of_tasks; i++)
+    {
+      status |= !tasks[i].success;
+    }
+  }
+  // the merged chain points to words of all the shards' pools
+  for (int i = 1; i < num_of_shards; i++)
+  {
+    free_markov_chain (&shards[i].markov_chain);
+    shards[i].pool->merged = pool->merged;
+    pool->merged = shards[i].pool;
+    shards[i].pool = NULL;
+  }
+  return status;
+}
+
+MarkovChain *initiate_tweets_database (int order)
 {
   LinkedList *database = malloc (sizeof (LinkedList));
   MarkovChain *markov_chain = malloc (sizeof (MarkovChain));
@@ -298,8 +797,24 @@ MarkovChain *initiate_tweets_database ()
     return NULL;
   }
   *database = (LinkedList) {NULL, NULL, 0};
-  *markov_chain = (MarkovChain) {database, print_str, comp_str, free_str,
-                                 copy_str, is_last_str};
+  *markov_chain = (MarkovChain) {.database = database,
+                                 .print_func = print_str,
+                                 .comp_func = comp_str,
+                                 .copy_func = copy_str,
+                                 .is_last = is_last_str,
+                                 .hash_func = hash_str,
+                                 // for saving, states are pool words
+                                 .size_func = size_str};
+  if (order > 1) // NGram states link to their words, they can't be saved
+  {
+    *markov_chain = (MarkovChain) {.database = database,
+                                   .print_func = print_ngram,
+                                   .comp_func = comp_ngram,
+                                   .copy_func = copy_ngram,
+                                   .is_last = is_last_ngram,
+                                   .hash_func = hash_ngram,
+                                   .print_first_func = print_first_ngram};
+  }
 //  markov_chain->print_func = print_str;
 //  markov_chain->comp_func = comp_str;
 //  markov_chain->free_data = free_str;
@@ -308,22 +823,189 @@ MarkovChain *initiate_tweets_database ()
   return markov_chain;
 }
 
-FILE *get_file (char *const *argv)
+Corpus *get_corpus (char *const *argv)
 {
-  FILE *input_file = fopen (argv[INPUT_FILE_ARG], "r");
-  if (input_file == NULL)
+  Corpus *corpus = open_corpus (argv[INPUT_FILE_ARG]);
+  if (corpus == NULL)
   {
     fprintf (stdout, OPEN_FILE_ERR_MSG);
   }
-  return input_file;
+  return corpus;
 }
 
 int is_arg_valid (int argc)
 {
-  if (argc != MAX_ARG_LEN && argc != MIN_ARG_LEN)
+  if (argc < MIN_ARG_LEN || argc > MAX_ARG_LEN)
   {
     fprintf (stdout, INPUT_LEN_ERR_MSG);
     return 1;
   }
   return 0;
 }
+
+/**
+ * Writes a word the way print_str prints it.
+ * @return true: upon success, false: in case of allocation error
+ */
+static bool write_word (SequenceWriter *output, const InternedStr *word)
+{
+  char *dst = reserve_output (output, word->len + 1);
+  if (dst == NULL)
+  {
+    return false;
+  }
+  memcpy (dst, word->str, word->len);
+  dst[word->len] = word->is_last ? '\n' : ' ';
+  commit_output (output, word->len + 1);
+  return true;
+}
+
+/**
+ * Ends a tweet that stopped at a dead end of the corpus, a word with no
+ * next words that print_str wouldn't end the line after.
+ * @return true: upon success, false: in case of allocation error
+ */
+static bool write_line_end (SequenceWriter *output)
+{
+  char *dst = reserve_output (output, 1);
+  if (dst == NULL)
+  {
+    return false;
+  }
+  *dst = '\n';
+  commit_output (output, 1);
+  return true;
+}
+
+/**
+ * Writes all the words of an order-k state, the way print_first_ngram
+ * prints them.
+ */
+static bool write_ngram (SequenceWriter *output, const NGram *ngram)
+{
+  return (ngram->context == NULL || write_ngram (output, ngram->context))
+         && write_word (output, ngram->word);
+}
+
+/**
+ * Generates a range of tweets into the task's output, each from it's own
+ * stream.
+ */
+static void generate_tweets (GenerateTask *task)
+{
+  // the first state holds order words, each next one adds one
+  int max_length = MAX_TWEET_LENGTH - (task->order - 1);
+  void *states[MAX_TWEET_LENGTH];
+  const InternedStr *words[MAX_TWEET_LENGTH];
+  for (int n = task->first; n < task->first + task->count; n++)
+  {
+    char *header = reserve_output (&task->output, TWEET_MSG_MAX_LEN);
+    if (header == NULL)
+    {
+      task->status = 1;
+      return;
+    }
+    commit_output (&task->output, (size_t) snprintf
+        (header, TWEET_MSG_MAX_LEN, TWEET_MSG, n+1));
+    Rng stream = rng_stream (task->seed, (uint64_t) n);
+    Rng *rng = task->rand_compat ? NULL : &stream; // NULL: the chain's rng
+    int len = 0;
+    if (task->order > 1)
+    {
+      generate_sequence_into (task->markov_chain, NULL, max_length, rng,
+                              states, &len);
+    }
+    else
+    {
+      generate_strings_into (task->markov_chain, NULL, max_length, rng,
+                             words, &len);
+    }
+    for (int i = 0; i < len; i++)
+    {
+      bool written = task->order > 1
+          ? (i == 0 ? write_ngram (&task->output, states[i])
+                    : write_word (&task->output,
+                                  ((const NGram*) states[i])->word))
+          : write_word (&task->output, words[i]);
+      if (!written)
+      {
+        task->status = 1;
+        return;
+      }
+    }
+    const InternedStr *last = len == 0 ? NULL : task->order > 1
+        ? ((const NGram*) states[len - 1])->word : words[len - 1];
+    if (len < max_length && last != NULL && !last->is_last
+        && !write_line_end (&task->output))
+    {
+      task->status = 1;
+      return;
+    }
+  }
+}
+
+/**
+ * Generates a task's range of tweets, the thread routine of generate.
+ * @param arg pointer to GenerateTask
+ */
+static void *generate_range (void *arg)
+{
+  generate_tweets ((GenerateTask*) arg);
+  return NULL;
+}
+
+int get_num_of_generators (int num_of_tweets)
+{
+  int num_of_ranges = (num_of_tweets + MIN_TWEETS_PER_THREAD - 1)
+                      / MIN_TWEETS_PER_THREAD;
+  int num_of_cpus = get_num_of_shards ();
+  int num = num_of_ranges < num_of_cpus ? num_of_ranges : num_of_cpus;
+  return num > 1 ? num : 1;
+}
+
+int generate (int argc, char *argv[], MarkovChain *markov_chain, int order)
+{
+  int num_of_tweets = get_tweet_num (argv);
+  uint64_t seed = (uint64_t) (unsigned int) get_seed (argv);
+  bool rand_compat = is_rand_compat (argc, argv);
+  GenerateTask tasks[MAX_TRAIN_SHARDS] = {{0}};
+  int status = 0;
+  for (int round = 0; round < num_of_tweets && status == 0;
+       round += TWEETS_PER_FLUSH)
+  {
+    int round_size = num_of_tweets - round < TWEETS_PER_FLUSH
+                     ? num_of_tweets - round : TWEETS_PER_FLUSH;
+    // rand() is one stream: it's tweets are generated in order
+    int num_of_tasks = rand_compat ? 1 : get_num_of_generators (round_size);
+    int first = round;
+    for (int i = 0; i < num_of_tasks; i++)
+    {
+      int count = (round + round_size - first) / (num_of_tasks - i);
+      tasks[i] = (GenerateTask) {markov_chain, first, count, order, seed,
+                                 rand_compat, tasks[i].output, 0};
+      tasks[i].output.size = 0;
+      first += count;
+    }
+    run_threads (generate_range, tasks, sizeof (GenerateTask),
+                 num_of_tasks);
+    SequenceWriter outputs[MAX_TRAIN_SHARDS];
+    for (int i = 0; i < num_of_tasks; i++)
+    {
+      status |= tasks[i].status;
+      outputs[i] = tasks[i].output;
+    }
+    if (status == 0 && !flush_outputs (STDOUT_FILENO, outputs, num_of_tasks))
+    {
+      status = 1;
+    }
+  }
+  for (int i = 0; i < MAX_TRAIN_SHARDS; i++)
+  {
+    free_output (&tasks[i].output);
+  }
+  if (status != 0)
+  {
+    fprintf (stdout, ALLOCATION_ERROR_MASSAGE);
+  }
+  return status;
+}